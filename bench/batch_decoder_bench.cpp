@@ -0,0 +1,120 @@
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include "../include/instruction.h"
+
+/**
+ * decode_batch (AVX2 when built with RISCVSIM_NATIVE) vs decode_batch_scalar vs one decode_instruction per word
+ *
+ * Every word is first checked field by field against the get_* helpers and decode_instruction,
+ * so the batch paths must agree bit for bit before any timing is printed.
+ *
+ * Usage: batch_decoder_bench [num_words]
+ */
+
+static bool check_word(const DecodedBatch& batch, std::size_t i) {
+
+    Dword word = batch.value[i];
+    Instruction expected = decode_instruction(word);
+    INST_FORMAT format = get_instruction_format(expected.instruction);
+
+    // Unknown encodings of a known opcode still get that opcode's fields
+    if (expected.instruction == ERROR_EXACT_INSTRUCTION) {
+        Instruction known = decode_instruction(word & 0x7F);
+        format = get_instruction_format(known.instruction);
+    }
+
+    bool has_rd = format == R_FORMAT || format == I_FORMAT || format == J_FORMAT || format == U_FORMAT;
+    bool has_rs1 = format != NO_FORMAT && format != J_FORMAT && format != U_FORMAT;
+    bool has_rs2 = format == R_FORMAT || format == S_FORMAT || format == B_FORMAT;
+
+    int32_t imm = 0;
+    switch (format) {
+        case I_FORMAT: imm = get_i_type_imm(word); break;
+        case S_FORMAT: imm = get_s_type_imm(word); break;
+        case B_FORMAT: imm = get_b_type_imm(word); break;
+        case J_FORMAT: imm = get_jal_imm(word); break;
+        case U_FORMAT: imm = get_u_type_imm(word); break;
+        default: break;
+    }
+
+    return batch.opcode[i] == get_opcode(word) &&
+           batch.rd[i] == (has_rd ? get_rd(word) : 0) &&
+           batch.rs1[i] == (has_rs1 ? get_rs1(word) : 0) &&
+           batch.rs2[i] == (has_rs2 ? get_rs2(word) : 0) &&
+           batch.imm[i] == imm && batch.imm[i] == expected.imm &&
+           batch.exact[i] == expected.instruction;
+}
+
+static bool check_batch(const char* name, const DecodedBatch& batch, const std::vector<Dword>& words) {
+
+    if (batch.size() != words.size()) {
+        std::cerr << name << ": decoded " << batch.size() << " of " << words.size() << " words" << std::endl;
+        return false;
+    }
+
+    for (std::size_t i = 0; i < words.size(); i++) {
+        if (batch.value[i] != words[i] || !check_word(batch, i)) {
+            std::cerr << name << ": wrong decode of " << std::bitset<32>(words[i]) << " at " << i << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+template <typename Decode>
+static double time_batch(const std::vector<Dword>& words, Decode decode, DecodedBatch& batch) {
+    decode(words.data(), words.size(), batch); // Warm up, so page faults on the arrays aren't timed
+    auto start = std::chrono::steady_clock::now();
+    decode(words.data(), words.size(), batch);
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char* argv[]) {
+
+    std::size_t count = (argc > 1) ? std::stoull(argv[1]) : 10000000;
+
+    // Mostly known opcodes, some fully random words, and an odd count so the scalar tail runs too
+    const Dword opcodes[] = {0x6F, 0x67, 0x33, 0x23, 0x03, 0x13, 0x63, 0x37, 0x17, 0x0F, 0x73};
+    const std::size_t num_opcodes = sizeof(opcodes) / sizeof(opcodes[0]);
+    std::mt19937 rng(7);
+    std::vector<Dword> words(count | 1);
+    for (Dword& word : words) {
+        word = (rng() % 8 == 0) ? rng() : (rng() & ~0x7Fu) | opcodes[rng() % num_opcodes];
+    }
+
+    // Aliases and blanks
+    const Dword fixed[] = {0x0, 0xFFFFFFFF, 0x13, 0x8067, 0x0000006F, 0x40000033, 0x00000033, 0x00100073, 0x00000073};
+    for (std::size_t i = 0; i < sizeof(fixed) / sizeof(fixed[0]) && i < words.size(); i++) { words[i * 3] = fixed[i]; }
+
+    DecodedBatch batch;
+    DecodedBatch scalar_batch;
+
+    double batch_time = time_batch(words, decode_batch, batch);
+    double scalar_time = time_batch(words, decode_batch_scalar, scalar_batch);
+
+    if (!check_batch("decode_batch", batch, words)) { return 1; }
+    if (!check_batch("decode_batch_scalar", scalar_batch, words)) { return 1; }
+
+    // Baseline: the array of Instruction structs the loader used to build
+    auto start = std::chrono::steady_clock::now();
+    std::vector<Instruction> instructions;
+    instructions.reserve(words.size());
+    for (Dword word : words) { instructions.push_back(decode_instruction(word)); }
+    double single_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+#if defined(__AVX2__)
+    const char* kernel = "AVX2";
+#else
+    const char* kernel = "scalar";
+#endif
+
+    std::cout << "Words              : " << words.size() << " (all fields match)\n";
+    std::cout << "decode_instruction : " << single_time << " s, " << (words.size() / single_time) << " words/s\n";
+    std::cout << "decode_batch_scalar: " << scalar_time << " s, " << (words.size() / scalar_time) << " words/s\n";
+    std::cout << "decode_batch (" << kernel << "): " << batch_time << " s, " << (words.size() / batch_time) << " words/s\n";
+
+    return 0;
+}
@@ -0,0 +1,172 @@
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../include/pipeline.h"
+
+/**
+ * Forwarding: the CPI cost of each bypass path
+ *
+ * A straight-line program of dependent ALU ops, loads and stores over a few registers and words of
+ * data memory. It runs with every path on, with each path off in turn, and with none at all. Every
+ * run must leave the same registers and memory as a plain interpreter, the table shows the cycles
+ * each missing path costs and how many forwards are left.
+ *
+ * Usage: bypass_bench [instructions] [seed]
+ */
+
+static Dword r_type(uint32_t funct7, uint32_t rs2, uint32_t rs1, uint32_t funct3, uint32_t rd) {
+    return (funct7 << 25) | (rs2 << 20) | (rs1 << 15) | (funct3 << 12) | (rd << 7) | 0x33;
+}
+
+static Dword i_type(uint32_t opcode, uint32_t funct3, uint32_t rd, uint32_t rs1, int32_t imm) {
+    return ((static_cast<uint32_t>(imm) & 0xFFF) << 20) | (rs1 << 15) | (funct3 << 12) | (rd << 7) | opcode;
+}
+
+static Dword sw(uint32_t rs2, uint32_t rs1, int32_t imm) {
+    uint32_t bits = static_cast<uint32_t>(imm) & 0xFFF;
+    return ((bits >> 5) << 25) | (rs2 << 20) | (rs1 << 15) | (2 << 12) | ((bits & 0x1F) << 7) | 0x23;
+}
+
+const uint32_t BASE_REGISTER = 16; // Holds the start of data memory, never overwritten
+const uint32_t DATA_BASE = 600;
+const uint32_t DATA_WORDS = 100;
+
+struct Expected {
+    std::array<uint32_t, 32> registers = {};
+    std::array<uint32_t, DATA_WORDS> memory = {};
+};
+
+// Program and what it must leave behind
+static std::vector<Dword> build_program(std::size_t count, unsigned seed, Expected& expected) {
+
+    std::vector<Dword> words;
+    std::mt19937 rng(seed);
+
+    words.push_back(i_type(0x13, 0, BASE_REGISTER, 0, DATA_BASE)); // ADDI
+    expected.registers[BASE_REGISTER] = DATA_BASE;
+
+    for (std::size_t i = 0; i < count; i++) {
+
+        uint32_t rd = 1 + rng() % 7;
+        uint32_t rs1 = rng() % 8;
+        uint32_t rs2 = rng() % 8;
+        uint32_t word = rng() % 8; // A few words, so loads find what was just stored
+        uint32_t kind = rng() % 8;
+
+        std::array<uint32_t, 32>& regs = expected.registers;
+
+        if (kind < 2) {
+            words.push_back(r_type(0, rs2, rs1, 0, rd)); // ADD
+            regs[rd] = regs[rs1] + regs[rs2];
+        } else if (kind < 3) {
+            words.push_back(r_type(0x20, rs2, rs1, 0, rd)); // SUB
+            regs[rd] = regs[rs1] - regs[rs2];
+        } else if (kind < 5) {
+            int32_t imm = static_cast<int32_t>(rng() % 201) - 100;
+            words.push_back(i_type(0x13, 0, rd, rs1, imm)); // ADDI
+            regs[rd] = regs[rs1] + static_cast<uint32_t>(imm);
+        } else if (kind < 7) {
+            words.push_back(i_type(0x03, 2, rd, BASE_REGISTER, static_cast<int32_t>(word * 4))); // LW
+            regs[rd] = expected.memory[word];
+        } else {
+            words.push_back(sw(rs2, BASE_REGISTER, static_cast<int32_t>(word * 4)));
+            expected.memory[word] = regs[rs2];
+        }
+    }
+
+    return words;
+}
+
+struct Config {
+    std::string name;
+    StageType from = NONE; // Path turned off, NONE for every path on
+    StageType to = NONE;
+    bool none = false; // Every path off
+};
+
+int main(int argc, char* argv[]) {
+
+    std::size_t count = (argc > 1) ? std::stoull(argv[1]) : 20000;
+    unsigned seed = (argc > 2) ? static_cast<unsigned>(std::stoul(argv[2])) : 1;
+
+    Expected expected;
+    std::vector<Dword> words = build_program(count, seed, expected);
+
+    // Every path on, each one off, then all of them off
+    std::vector<Config> configs;
+    configs.push_back({"all paths", NONE, NONE, false});
+    for (int from = DF; from <= WB; from++) {
+        for (int to = from - 1; to >= EX; to--) {
+            if (!forward_path_exists(StageType(from), StageType(to))) { continue; }
+            configs.push_back({"no " + forward_path_name(StageType(from), StageType(to)), StageType(from), StageType(to), false});
+        }
+    }
+    configs.push_back({"no forwarding", NONE, NONE, true});
+
+    // Paths the pipeline has no room for are refused
+    Pipeline rejected;
+    if (rejected.setForwardingPath(EX, DF, false) || rejected.setForwardingPath(WB, RF, true) ||
+        !rejected.getBypassNetwork().allows(DF, EX)) {
+        std::cerr << "A path that does not exist was accepted" << std::endl;
+        return 1;
+    }
+
+    std::cout << "Instructions      : " << words.size() << " (seed " << seed << ")\n\n";
+    std::cout << "bypass network              cycles     CPI   +cycles   no bypass     loads   forwards   cycles/s\n";
+
+    uint64_t full_cycles = 0;
+
+    for (const Config& config : configs) {
+
+        Pipeline pipeline;
+        for (int from = DF; from <= WB; from++) {
+            for (int to = EX; to < from; to++) {
+                bool off = config.none || (StageType(from) == config.from && StageType(to) == config.to);
+                if (off && forward_path_exists(StageType(from), StageType(to))) { pipeline.setForwardingPath(StageType(from), StageType(to), false); }
+            }
+        }
+        for (Dword word : words) { pipeline.addInstruction(decode_instruction(word)); }
+
+        auto start = std::chrono::steady_clock::now();
+        RunResult result = pipeline.run();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        if (result.status != FINISHED) {
+            std::cerr << config.name << ": the run ended with " << run_status_to_string(result.status) << std::endl;
+            return 1;
+        }
+
+        for (uint32_t reg = 0; reg < 32; reg++) {
+            if (static_cast<uint32_t>(pipeline.getIntegerRegister(reg)) != expected.registers[reg]) {
+                std::cerr << config.name << ": x" << reg << " is " << pipeline.getIntegerRegister(reg) << ", expected "
+                          << static_cast<int32_t>(expected.registers[reg]) << std::endl;
+                return 1;
+            }
+        }
+        for (uint32_t word = 0; word < DATA_WORDS; word++) {
+            if (static_cast<uint32_t>(pipeline.getDataMemory(DATA_BASE + word * 4)) != expected.memory[word]) {
+                std::cerr << config.name << ": the word at " << (DATA_BASE + word * 4) << " is wrong" << std::endl;
+                return 1;
+            }
+        }
+
+        if (config.from == NONE && !config.none) { full_cycles = result.cycles; }
+
+        int forwards = 0;
+        for (int used : result.stats.forwards) { forwards += used; }
+
+        char line[200];
+        std::snprintf(line, sizeof(line), "%-24s %10llu %7.3f %9lld %11d %9d %10d %10.3g\n", config.name.c_str(),
+                      static_cast<unsigned long long>(result.cycles), double(result.cycles) / result.instructions_retired,
+                      static_cast<long long>(result.cycles) - static_cast<long long>(full_cycles),
+                      result.stats.bypass, result.stats.total_loads, forwards, result.cycles / seconds);
+        std::cout << line;
+    }
+
+    std::cout << "\nRegisters and memory match the reference for every network\n";
+
+    return 0;
+}
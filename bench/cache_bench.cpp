@@ -0,0 +1,292 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../include/pipeline.h"
+
+/**
+ * Caches: the tag arrays on their own, and what misses cost the pipeline
+ *
+ * First every replacement policy is fed synthetic address streams (a sequential sweep, a loop that
+ * fits, random addresses over twice the cache and a stride that maps ways + 1 lines to one set)
+ * directly, which shows hit rates and accesses per second. LRU must count exactly the hits, misses
+ * and evictions of a plain list-per-set model. Then a loop that loads, bumps and stores every
+ * stride-th word of an array runs under several hierarchies. Every run must leave the same
+ * registers and memory as the loop computes, the table shows CPI, stall cycles and hit rates.
+ *
+ * Usage: cache_bench [words] [stride in words] [passes]
+ */
+
+static Dword r_type(uint32_t funct7, uint32_t rs2, uint32_t rs1, uint32_t funct3, uint32_t rd) {
+    return (funct7 << 25) | (rs2 << 20) | (rs1 << 15) | (funct3 << 12) | (rd << 7) | 0x33;
+}
+
+static Dword i_type(uint32_t opcode, uint32_t funct3, uint32_t rd, uint32_t rs1, int32_t imm) {
+    return ((static_cast<uint32_t>(imm) & 0xFFF) << 20) | (rs1 << 15) | (funct3 << 12) | (rd << 7) | opcode;
+}
+
+static Dword sw(uint32_t rs2, uint32_t rs1, int32_t imm) {
+    uint32_t bits = static_cast<uint32_t>(imm) & 0xFFF;
+    return ((bits >> 5) << 25) | (rs2 << 20) | (rs1 << 15) | (2 << 12) | ((bits & 0x1F) << 7) | 0x23;
+}
+
+// A taken branch at B goes to B + 16 + offset
+static Dword bne(uint32_t rs1, uint32_t rs2, int32_t offset) {
+    uint32_t bits = static_cast<uint32_t>(offset) & 0xFFF;
+    return ((bits >> 5) << 25) | (rs2 << 20) | (rs1 << 15) | (1 << 12) | ((bits & 0x1F) << 7) | 0x63;
+}
+
+static Dword lui(uint32_t rd, uint32_t upper) { return (upper << 12) | (rd << 7) | 0x37; }
+
+const uint32_t ARRAY_BASE = 0x10000;
+
+
+
+// SYNTHETIC STREAMS
+enum StreamKind { SEQUENTIAL, FITTING_LOOP, RANDOM_ADDRESSES, SET_CONFLICT, NUM_STREAMS };
+
+static const char* const STREAM_NAMES[NUM_STREAMS] = {"sequential", "fitting loop", "random", "set conflict"};
+
+static std::vector<uint32_t> build_stream(StreamKind kind, const CacheConfig& config, std::size_t count) {
+
+    std::vector<uint32_t> addresses;
+    addresses.reserve(count);
+    std::mt19937 rng(7);
+
+    uint32_t sets = config.size / config.line_size / config.ways;
+
+    for (std::size_t i = 0; i < count; i++) {
+        switch (kind) {
+            case SEQUENTIAL: addresses.push_back(static_cast<uint32_t>(4 * i)); break;
+            case FITTING_LOOP: addresses.push_back(static_cast<uint32_t>((4 * i) % (config.size / 2))); break;
+            case RANDOM_ADDRESSES: addresses.push_back(static_cast<uint32_t>(rng() % (2 * config.size)) & ~3u); break;
+            default: addresses.push_back(static_cast<uint32_t>(i % (config.ways + 1)) * sets * config.line_size); break;
+        }
+    }
+
+    return addresses;
+}
+
+// Least recently used by the book, most recent first in each set
+static CacheStats reference_lru(const CacheConfig& config, const std::vector<uint32_t>& addresses) {
+
+    uint32_t sets = config.size / config.line_size / config.ways;
+    std::vector<std::vector<uint32_t>> recency(sets);
+    CacheStats counts;
+
+    for (uint32_t address : addresses) {
+
+        uint32_t line = address / config.line_size;
+        std::vector<uint32_t>& set = recency[line % sets];
+        auto found = std::find(set.begin(), set.end(), line);
+
+        if (found != set.end()) {
+            counts.hits++;
+            set.erase(found);
+        } else {
+            counts.misses++;
+            if (set.size() == config.ways) {
+                counts.evictions++;
+                set.pop_back();
+            }
+        }
+        set.insert(set.begin(), line);
+    }
+
+    return counts;
+}
+
+static bool run_streams(std::size_t count) {
+
+    std::vector<CacheConfig> configs = {
+        CacheConfig(8 * 1024, 4, 64, LRU), CacheConfig(8 * 1024, 4, 64, PLRU), CacheConfig(8 * 1024, 4, 64, RANDOM),
+        CacheConfig(32 * 1024, 8, 64, LRU), CacheConfig(32 * 1024, 8, 64, PLRU), CacheConfig(32 * 1024, 8, 64, RANDOM)};
+
+    std::cout << "Accesses per stream: " << count << "\n\n";
+    std::cout << "cache                      stream          hit rate   accesses/s\n";
+
+    for (const CacheConfig& config : configs) {
+
+        for (int kind = 0; kind < NUM_STREAMS; kind++) {
+
+            std::vector<uint32_t> addresses = build_stream(StreamKind(kind), config, count);
+
+            Cache cache;
+            if (!cache.configure(config)) { return false; }
+
+            auto start = std::chrono::steady_clock::now();
+            for (uint32_t address : addresses) {
+                uint32_t victim;
+                if (!cache.access(address, false)) { cache.fill(address, false, victim); }
+            }
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            const CacheStats& counts = cache.getStats();
+
+            if (config.replacement == LRU) {
+                CacheStats expected = reference_lru(config, addresses);
+                if (counts.hits != expected.hits || counts.misses != expected.misses || counts.evictions != expected.evictions) {
+                    std::cerr << cache.getName() << " on " << STREAM_NAMES[kind] << ": " << counts.hits << " hits, " << counts.misses
+                              << " misses, " << counts.evictions << " evictions, expected " << expected.hits << ", "
+                              << expected.misses << ", " << expected.evictions << std::endl;
+                    return false;
+                }
+            }
+
+            std::string name = std::to_string(config.size / 1024) + " KiB " + std::to_string(config.ways) + "-way " +
+                               replacement_policy_to_string(config.replacement);
+
+            char line[160];
+            std::snprintf(line, sizeof(line), "%-26s %-14s %8.2f%% %12.3g\n", name.c_str(), STREAM_NAMES[kind],
+                          100.0 * counts.hitRate(), count / seconds);
+            std::cout << line;
+        }
+    }
+
+    return true;
+}
+
+
+
+// PIPELINE
+struct Program {
+    std::vector<Dword> words;
+    std::array<uint32_t, 32> registers = {}; // What the loop leaves
+};
+
+static Program build_program(uint32_t count, uint32_t stride, uint32_t passes) {
+    /**
+     * For each pass, every stride-th word of the array is loaded, added to x8, bumped and stored back
+     */
+
+    Program program;
+    std::vector<Dword>& words = program.words;
+
+    words.push_back(lui(5, ARRAY_BASE >> 12));
+    words.push_back(i_type(0x13, 0, 6, 0, static_cast<int32_t>(passes)));
+
+    std::size_t outer = words.size();
+    words.push_back(i_type(0x13, 0, 7, 5, 0)); // ADDI x7, x5, 0
+    words.push_back(i_type(0x13, 0, 10, 0, static_cast<int32_t>(count)));
+
+    std::size_t inner = words.size();
+    words.push_back(i_type(0x03, 2, 9, 7, 0)); // LW x9, 0(x7)
+    words.push_back(r_type(0, 9, 8, 0, 8)); // ADD x8, x8, x9
+    words.push_back(i_type(0x13, 0, 9, 9, 1));
+    words.push_back(sw(9, 7, 0));
+    words.push_back(i_type(0x13, 0, 7, 7, static_cast<int32_t>(4 * stride)));
+    words.push_back(i_type(0x13, 0, 10, 10, -1));
+    words.push_back(bne(10, 0, static_cast<int32_t>(4 * inner) - static_cast<int32_t>(4 * words.size()) - 16));
+    words.push_back(i_type(0x13, 0, 6, 6, -1));
+    words.push_back(bne(6, 0, static_cast<int32_t>(4 * outer) - static_cast<int32_t>(4 * words.size()) - 16));
+
+    program.registers[5] = ARRAY_BASE;
+    program.registers[7] = ARRAY_BASE + 4 * stride * count;
+    program.registers[8] = count * (passes * (passes - 1) / 2); // Pass p adds p from every word
+    program.registers[9] = passes;
+
+    return program;
+}
+
+struct Hierarchy {
+    std::string name;
+    MemoryHierarchyConfig config;
+};
+
+static MemoryHierarchyConfig hierarchy(CacheConfig l1i, CacheConfig l1d, CacheConfig l2 = CacheConfig()) {
+    MemoryHierarchyConfig config;
+    config.levels[L1I] = l1i;
+    config.levels[L1D] = l1d;
+    config.levels[L2] = l2;
+    return config;
+}
+
+int main(int argc, char* argv[]) {
+
+    uint32_t count = (argc > 1) ? static_cast<uint32_t>(std::stoul(argv[1])) : 1024;
+    uint32_t stride = (argc > 2) ? static_cast<uint32_t>(std::stoul(argv[2])) : 4;
+    uint32_t passes = (argc > 3) ? static_cast<uint32_t>(std::stoul(argv[3])) : 4;
+
+    if (count == 0 || count > 2047 || stride == 0 || 4 * stride > 2047 || passes == 0 || passes > 2047) {
+        std::cerr << "Words and passes go in an ADDI immediate (1..2047), and so does the stride in bytes" << std::endl;
+        return 1;
+    }
+
+    if (!run_streams(1000000)) { return 1; }
+
+    // Bad shapes are refused
+    Cache rejected;
+    if (rejected.configure(CacheConfig(3000, 2, 64)) || rejected.configure(CacheConfig(64, 4, 32)) ||
+        rejected.configure(CacheConfig(1024, 2, 2)) || rejected.enabled()) {
+        std::cerr << "A cache that can't be built was accepted" << std::endl;
+        return 1;
+    }
+
+    Program program = build_program(count, stride, passes);
+    uint32_t array_bytes = 4 * stride * count;
+
+    CacheConfig write_through(4 * 1024, 2, 32);
+    write_through.write_back = false;
+    write_through.write_allocate = false;
+
+    std::vector<Hierarchy> hierarchies = {
+        {"no caches", MemoryHierarchyConfig()},
+        {"L1D 4K 2-way", hierarchy(CacheConfig(), CacheConfig(4 * 1024, 2, 32))},
+        {"L1D 4K wt, no alloc", hierarchy(CacheConfig(), write_through)},
+        {"L1D 4K 2-way plru", hierarchy(CacheConfig(), CacheConfig(4 * 1024, 2, 32, PLRU))},
+        {"L1D 4K 2-way random", hierarchy(CacheConfig(), CacheConfig(4 * 1024, 2, 32, RANDOM))},
+        {"L1D 32K 4-way 64B", hierarchy(CacheConfig(), CacheConfig(32 * 1024, 4, 64))},
+        {"L1D 4K + L2 64K", hierarchy(CacheConfig(), CacheConfig(4 * 1024, 2, 32), CacheConfig(64 * 1024, 8, 64))},
+        {"L1I 256 + L1D 4K + L2", hierarchy(CacheConfig(256, 1, 16), CacheConfig(4 * 1024, 2, 32), CacheConfig(64 * 1024, 8, 64))}};
+
+    std::cout << "\nProgram           : " << program.words.size() << " instructions, " << count << " words " << 4 * stride
+              << " bytes apart, " << passes << " passes\n\n";
+    std::cout << "hierarchy                   cycles     CPI   I-stalls   D-stalls   L1D hits    L2 hits   cycles/s\n";
+
+    for (const Hierarchy& entry : hierarchies) {
+
+        Pipeline pipeline;
+        if (!pipeline.getMemory().addRegion("array", ARRAY_BASE, array_bytes) || !pipeline.setMemoryHierarchy(entry.config)) { return 1; }
+        for (Dword word : program.words) { pipeline.addInstruction(decode_instruction(word)); }
+
+        auto start = std::chrono::steady_clock::now();
+        RunResult result = pipeline.run();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        if (result.status != FINISHED) {
+            std::cerr << entry.name << ": the run ended with " << run_status_to_string(result.status) << std::endl;
+            return 1;
+        }
+
+        for (uint32_t reg = 0; reg < 32; reg++) {
+            if (static_cast<uint32_t>(pipeline.getIntegerRegister(reg)) != program.registers[reg]) {
+                std::cerr << entry.name << ": x" << reg << " is " << pipeline.getIntegerRegister(reg) << ", expected "
+                          << static_cast<int32_t>(program.registers[reg]) << std::endl;
+                return 1;
+            }
+        }
+        for (uint32_t word = 0; word < count; word++) {
+            uint32_t address = ARRAY_BASE + 4 * stride * word;
+            if (static_cast<uint32_t>(pipeline.getDataMemory(address)) != passes) {
+                std::cerr << entry.name << ": the word at " << address << " is wrong" << std::endl;
+                return 1;
+            }
+        }
+
+        std::string l1d = entry.config.levels[L1D].size ? std::to_string(100.0 * result.stats.caches[L1D].hitRate()).substr(0, 5) + "%" : "-";
+        std::string l2 = entry.config.levels[L2].size ? std::to_string(100.0 * result.stats.caches[L2].hitRate()).substr(0, 5) + "%" : "-";
+
+        char line[200];
+        std::snprintf(line, sizeof(line), "%-24s %10llu %7.3f %10d %10d %10s %10s %10.3g\n", entry.name.c_str(),
+                      static_cast<unsigned long long>(result.cycles), double(result.cycles) / result.instructions_retired,
+                      result.stats.instruction_cache, result.stats.data_cache, l1d.c_str(), l2.c_str(), result.cycles / seconds);
+        std::cout << line;
+    }
+
+    std::cout << "\nRegisters and memory match the loop under every hierarchy\n";
+
+    return 0;
+}
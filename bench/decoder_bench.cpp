@@ -0,0 +1,154 @@
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include "../include/instruction.h"
+
+/**
+ * Table-driven decode_instruction vs the old read_opcode -> decompose_* -> get_populated_instruction chain
+ *
+ * The old chain is kept here (only here) as the reference. It only knew part of RV32I, so the
+ * intended differences are SUB (the old chain matched funct7 == 8 instead of 0x20), SRA (decoded
+ * as SRL), load/store widths (every load was LW and every store SW), the M extension (it ignored
+ * funct7 for most R-Type funct3 values) and the encodings it rejected.
+ *
+ * Usage: decoder_bench [num_words]
+ */
+
+namespace legacy {
+
+EXACT_INSTRUCTION decompose_IRR(Dword instruction) {
+    switch (get_funct3(instruction)) {
+        case 0: break;
+        case 1: return SLL;
+        case 2: return SLT;
+        case 4: return XOR;
+        case 5: return SRL;
+        case 6: return OR;
+        case 7: return AND;
+        default: return ERROR_EXACT_INSTRUCTION;
+    }
+    switch (get_funct7(instruction)) {
+        case 0: return ADD;
+        case 8: return SUB;
+        default: return ERROR_EXACT_INSTRUCTION;
+    }
+}
+
+EXACT_INSTRUCTION decompose_JALR(Dword instruction) {
+    Byte immediate = get_jalr_imm(instruction);
+    if (get_rd(instruction) == 0 && get_rs1(instruction) == 1 && immediate == 0) { return RET; }
+    return JALR_E;
+}
+
+EXACT_INSTRUCTION decompose_I_TYPE(Dword instruction) {
+    switch (get_funct3(instruction)) {
+        case 0: break;
+        case 2: return SLTI;
+        default: return ERROR_EXACT_INSTRUCTION;
+    }
+    Dword immediate = get_i_type_imm(instruction);
+    if (get_rd(instruction) == 0 && get_rs1(instruction) == 0 && immediate == 0) { return NOP; }
+    return ADDI;
+}
+
+EXACT_INSTRUCTION decompose_BRANCH(Dword instruction) {
+    switch (get_funct3(instruction)) {
+        case 0: return BEQ;
+        case 1: return BNE;
+        case 4: return BLT;
+        case 5: return BGE;
+        default: return ERROR_EXACT_INSTRUCTION;
+    }
+}
+
+EXACT_INSTRUCTION decompose_types(Dword instruction, INST_TYPE type) {
+    switch (type) {
+        case IRR: return decompose_IRR(instruction);
+        case JALR: return decompose_JALR(instruction);
+        case JAL: return (get_rd(instruction) == 0) ? J : JAL_E;
+        case STORE: return SW;
+        case LOAD: return LW;
+        case I_TYPE: return decompose_I_TYPE(instruction);
+        case BRANCH: return decompose_BRANCH(instruction);
+        default: return ERROR_EXACT_INSTRUCTION;
+    }
+}
+
+Instruction decode(Dword value) {
+    Instruction decoded;
+    decoded.value = value;
+    decoded.type = read_opcode(value);
+    decoded.rs1 = 0;
+    decoded.rs2 = 0;
+    decoded.rd = 0;
+    decoded.imm = 0;
+    switch (decoded.type) {
+        case JAL: decoded.rd = get_rd(value); decoded.imm = get_jal_imm(value); break;
+        case JALR:
+        case LOAD:
+        case I_TYPE: decoded.rd = get_rd(value); decoded.rs1 = get_rs1(value); decoded.imm = get_i_type_imm(value); break;
+        case IRR: decoded.rd = get_rd(value); decoded.rs1 = get_rs1(value); decoded.rs2 = get_rs2(value); break;
+        case STORE: decoded.rs1 = get_rs1(value); decoded.rs2 = get_rs2(value); decoded.imm = get_s_type_imm(value); break;
+        case BRANCH: decoded.rs1 = get_rs1(value); decoded.rs2 = get_rs2(value); decoded.imm = get_b_type_imm(value); break;
+        default: break;
+    }
+    decoded.instruction = (decoded.type == BLANK) ? ERROR_EXACT_INSTRUCTION : decompose_types(value, decoded.type);
+    return decoded;
+}
+
+} // namespace legacy
+
+template <typename Decode>
+static double time_decode(const std::vector<Dword>& words, Decode decode, uint64_t& checksum) {
+    auto start = std::chrono::steady_clock::now();
+    for (Dword word : words) {
+        Instruction decoded = decode(word);
+        checksum += decoded.instruction + decoded.rd + decoded.rs1 + decoded.rs2 + static_cast<uint32_t>(decoded.imm);
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char* argv[]) {
+
+    std::size_t count = (argc > 1) ? std::stoull(argv[1]) : 10000000;
+
+    // Random words with a known opcode, so the decoders do real work
+    const Dword opcodes[] = {0x6F, 0x67, 0x33, 0x23, 0x03, 0x13, 0x63};
+    std::mt19937 rng(7);
+    std::vector<Dword> words(count);
+    for (Dword& word : words) { word = (rng() & ~0x7Fu) | opcodes[rng() % 7]; }
+
+    // Agreement check
+    for (Dword word : words) {
+
+        Instruction expected = legacy::decode(word);
+        Instruction actual = decode_instruction(word);
+
+        bool sub_fix = get_opcode(word) == 0x33 && get_funct3(word) == 0 && (get_funct7(word) == 8 || get_funct7(word) == 0x20);
+        bool sra = actual.instruction == SRA;
+        bool width = (get_opcode(word) == 0x03 || get_opcode(word) == 0x23) && get_funct3(word) != 2;
+        bool m_extension = get_opcode(word) == 0x33 && get_funct7(word) == 0x01;
+        bool added = expected.instruction == ERROR_EXACT_INSTRUCTION && actual.instruction != ERROR_EXACT_INSTRUCTION;
+        if (sub_fix || sra || width || m_extension || added) { continue; }
+
+        if (expected.instruction != actual.instruction || expected.type != actual.type || expected.rd != actual.rd ||
+            expected.rs1 != actual.rs1 || expected.rs2 != actual.rs2 || expected.imm != actual.imm) {
+            std::cerr << "Decoders disagree on " << std::bitset<32>(word) << std::endl;
+            return 1;
+        }
+    }
+
+    uint64_t legacy_checksum = 0;
+    uint64_t table_checksum = 0;
+    double legacy_time = time_decode(words, legacy::decode, legacy_checksum);
+    double table_time = time_decode(words, decode_instruction, table_checksum);
+
+    std::cout << "Words        : " << count << "\n";
+    std::cout << "decompose_*  : " << legacy_time << " s, " << (count / legacy_time) << " words/s\n";
+    std::cout << "Table        : " << table_time << " s, " << (count / table_time) << " words/s\n";
+    std::cout << "Speedup      : " << (legacy_time / table_time) << "x (checksums " << legacy_checksum % 1000 
+              << "/" << table_checksum % 1000 << ")\n";
+
+    return 0;
+}
@@ -0,0 +1,106 @@
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "../include/disassembler.h"
+#include "../include/lexer.h"
+
+/**
+ * Serial Lexer "dis" vs parallel chunked disassembly, 1 thread up to every core
+ *
+ * Usage: disassembler_bench [num_instructions] [scratch_prefix]
+ */
+
+static const char* PROGRAM[] = {
+    "00000010110000000000010000010011", "00000000000100000000001100010011", "00100100011000000010110000100011",
+    "00000000010000000000001110010011", "00100100011000111010110000100011", "00000000100000000000010100010011",
+    "11111111100001010000101110010011", "00100101100010111010101010000011", "11111111110001010000110000010011",
+    "00100101100011000010101100000011", "00000001011010101000001010110011", "00100100010101010010110000100011",
+    "00000000010001010000010100010011", "00000000100001010000010001100011", "11111110000111111111000001101111",
+    "00000000000000000000000000010011", "00000000000000001000000001100111"
+};
+
+static std::string read_all(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    std::ostringstream contents;
+    contents << in.rdbuf();
+    return contents.str();
+}
+
+template <typename F>
+static double time_it(F f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char* argv[]) {
+
+    std::size_t count = (argc > 1) ? std::stoull(argv[1]) : 1000000;
+    std::string prefix = (argc > 2) ? argv[2] : "disassembler_bench";
+
+    std::string input = prefix + "_input.txt";
+    std::string serial_output = prefix + "_serial.txt";
+    std::string parallel_output = prefix + "_parallel.txt";
+
+    {
+        std::ofstream out(input, std::ios::out | std::ios::trunc);
+        for (std::size_t i = 0; i < count; i++) { out << PROGRAM[i % 17] << "\n"; }
+    }
+
+    std::cerr.setstate(std::ios::failbit); // EOF diagnostic
+
+    double serial_time = time_it([&]() {
+        Lexer lexer;
+        lexer.set_input_file(input.c_str(), MAPPED);
+        lexer.set_output_file(serial_output.c_str());
+        while (!lexer.isEOF()) { lexer.read_next_instruction(); }
+        lexer.close_output();
+    });
+
+    std::cerr.clear();
+
+    std::string expected = read_all(serial_output);
+    std::cout << "Instructions : " << count << "\n";
+    std::cout << "Serial       : " << serial_time << " s, " << (count / serial_time) << " lines/s\n";
+
+    // Tiny chunks to exercise the boundary handling
+    {
+        ThreadPool pool(2);
+        disassemble_file_parallel(input, parallel_output, pool, 496, 4096 + 7);
+        if (read_all(parallel_output) != expected) {
+            std::cerr << "Small-chunk parallel output differs from serial output" << std::endl;
+            return 1;
+        }
+    }
+
+    unsigned cores = std::thread::hardware_concurrency();
+    if (cores == 0) { cores = 1; }
+
+    for (unsigned threads = 1; threads <= cores; threads *= 2) {
+
+        double parallel_time = time_it([&]() {
+            ThreadPool pool(threads);
+            disassemble_file_parallel(input, parallel_output, pool);
+        });
+
+        if (read_all(parallel_output) != expected) {
+            std::cerr << "Parallel output differs from serial output" << std::endl;
+            return 1;
+        }
+
+        std::cout << "Parallel x" << threads << "  : " << parallel_time << " s, " << (count / parallel_time)
+                  << " lines/s, " << (serial_time / parallel_time) << "x\n";
+
+        if (threads < cores && threads * 2 > cores) { threads = cores / 2; } // Always finish on every core
+    }
+
+    std::remove(input.c_str());
+    std::remove(serial_output.c_str());
+    std::remove(parallel_output.c_str());
+
+    return 0;
+}
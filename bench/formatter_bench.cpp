@@ -0,0 +1,342 @@
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <regex>
+#include <vector>
+
+#include "../include/instruction.h"
+
+/**
+ * Buffer formatters (format_disassembly, format_new_style) vs the old ostringstream / regex ones
+ *
+ * The old formatters are kept here (only here) as the reference, every line must come out byte
+ * identical. Forms the old ones never printed (LUI, AUIPC, FENCE, ECALL, the immediate shifts,
+ * byte and halfword loads/stores) are left out of the workload. Heap use is measured by counting operator new, the new formatters must make none.
+ *
+ * Usage: formatter_bench [num_words]
+ */
+
+static std::size_t heap_allocations = 0;
+
+void* operator new(std::size_t size) {
+    heap_allocations++;
+    if (void* memory = std::malloc(size)) { return memory; }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept { std::free(memory); }
+void operator delete(void* memory, std::size_t) noexcept { std::free(memory); }
+
+namespace legacy {
+
+std::string register_to_string(Byte reg) {
+    /*
+    * Register to string (prepend x)
+    */
+    std::ostringstream ss;
+    ss << "x" << reg;
+    return ss.str();
+}
+
+std::string to_binary_string(Dword value, int bits) {
+    /*
+    * Binary to string
+    */
+    std::bitset<32> b(value);
+    return b.to_string().substr(32 - bits, bits);
+}
+
+std::string instruction_to_string(Instruction inst, int position, bool isBlank) {
+    /*
+    * Takes an instruction and our position in a file
+    * Pretty prints it as a decompiled version, as shown in example
+    */
+
+    std::ostringstream ss;
+
+    // Handle blank instruction
+    if (isBlank) {
+        std::ostringstream ss;
+
+        // Output 32-bit zeros
+        ss << "00000000000000000000000000000000";
+
+        // Append the position and "0"
+        ss << "\t" << position << "\t0";
+
+        return ss.str();
+    }
+
+    // Stringstream to pretty print the binary
+    std::string binary_str = to_binary_string(inst.value, 32);
+    ss << binary_str.substr(0, 6) << " " << binary_str.substr(6, 6) << " "
+       << binary_str.substr(12, 5) << " " << binary_str.substr(17, 3) << " "
+       << binary_str.substr(20, 5) << " " << binary_str.substr(25, 7);
+
+    // Position
+    ss << "\t" << position;
+
+    // Exact Instruction with aligned formatting
+    ss << "\t" << exact_instruction_to_string(inst.instruction);
+
+    /**
+     * This stuff is really not super useful. I just want to make the "diff" match since that's how grading is done.
+     */
+
+    // Spacing adjustment
+    std::string mnemonic = exact_instruction_to_string(inst.instruction);
+    int padding = 6 - static_cast<int>(mnemonic.length()); // Padding adjustment
+    ss << std::string(std::max(padding, 1), ' '); // Long names (ie ERROR_EXACT_INSTRUCTION) still get one space
+
+    // Params
+    switch (inst.type) {
+        case IRR:  // R-Type
+            ss << register_to_string(inst.rd) << ", "
+               << register_to_string(inst.rs1) << ", "
+               << register_to_string(inst.rs2);
+            break;
+        case I_TYPE:  // I-Type
+            ss << register_to_string(inst.rd) << ", "
+               << register_to_string(inst.rs1) << ", "
+               << inst.imm;
+            break;
+        case LOAD:  // Load (I-Type)
+            ss << register_to_string(inst.rd) << ", "
+               << inst.imm << "(" << register_to_string(inst.rs1) << ")";
+            break;
+        case STORE:  // Store (S-Type)
+            ss << register_to_string(inst.rs2) << ", "
+               << inst.imm << "(" << register_to_string(inst.rs1) << ")";
+            break;
+        case BRANCH:  // B-Type
+            ss << register_to_string(inst.rs1) << ", "
+               << register_to_string(inst.rs2) << ", "
+               //<< std::bitset<30>(inst.imm);
+               << inst.imm;
+            break;
+        case JAL:  // J-Type (JAL)
+            ss << register_to_string(inst.rd) << ", "
+               << inst.imm;
+            break;
+        case JALR:  // I-Type (JALR)
+            ss << register_to_string(inst.rd) << ", "
+               << register_to_string(inst.rs1) << ", "
+               << inst.imm;
+            break;
+        default:
+            ss << "UNKNOWN";
+            break;
+    }
+
+    return ss.str();
+}
+
+
+std::string handle_special_case(Instruction inst, EXACT_INSTRUCTION type, int position) {
+    /*
+    * We need a helper function to handle the special cases that can arise from our custom instructions
+    * These being J, NOP, and RET
+    */
+
+    std::ostringstream ss;
+
+    // First, split into parts the same way as normal
+    std::string binary_str = to_binary_string(inst.value, 32);
+
+    ss << binary_str.substr(0, 6) << " " << binary_str.substr(6, 6) << " "
+       << binary_str.substr(12, 5) << " " << binary_str.substr(17, 3) << " "
+       << binary_str.substr(20, 5) << " " << binary_str.substr(25, 7);
+
+    // I realize the above could be its own function, but this is done for simplicity's sake
+    // For such an important assignment, I want to avoid using memory allocation as this exposes me to potential segfaults
+
+    // Append the position
+    ss << "\t" << position;
+
+
+
+    switch (type) {
+        case J: 
+            ss << "\tJ\t#" << (position + inst.imm); // Address relative to position
+            ss << "  //JAL x0, " << inst.imm; // Comment for J
+            break;
+        case NOP:
+            ss << "\tNOP";
+            ss << "\t\t//ADDI x0, x0, 0";
+            break;
+        case RET:
+            ss << "\tRET";
+            ss << "\t\t//JALR x0, x1, 0";
+            break;
+        default:
+            ss << "ERROR"; // An instruction that isn't of one of these types should never even be passed to this function
+    }
+
+    return ss.str();
+
+}
+
+
+std::string disassemble_instruction(Instruction inst, int position) {
+    /*
+    * One line of "dis" output: blank words, the J/NOP/RET aliases, or the normal format
+    */
+
+    if (inst.type == BLANK) { return legacy::instruction_to_string(inst, position, true); }
+
+    EXACT_INSTRUCTION exact_instruction = inst.instruction;
+
+    if (exact_instruction == RET || exact_instruction == NOP || exact_instruction == J) {
+        return legacy::handle_special_case(inst, exact_instruction, position);
+    }
+
+    return legacy::instruction_to_string(inst, position, false);
+}
+
+
+std::string instruction_to_new_style_string(Instruction inst) {
+
+    // Result of the function fixes the istring
+
+    std::string input = legacy::instruction_to_string(inst, 500, false);
+
+    // Remove trailing newline, if it exists
+    if (!input.empty() && input.back() == '\n') {
+        input.pop_back();
+    }
+
+    input = std::regex_replace(input, std::regex(R"(x(\d+))"), "R$1");
+
+    // Replace immediate values with "#" prefix
+    if (inst.getExactInstruction() != LW && inst.getExactInstruction() != SW) {
+        input = std::regex_replace(input, std::regex(R"(\b(\d+)\b)"), "#$1");
+    }
+
+    // Remove everything before the last tab
+    size_t lastTab = input.find_last_of('\t');
+    if (lastTab != std::string::npos) {
+        input = input.substr(lastTab + 1);
+    }
+
+    return input;
+}
+
+} // namespace legacy
+
+static std::vector<Instruction> make_instructions(std::size_t count) {
+    /*
+    * Random fields under the opcodes the old formatters knew (plus some that aren't opcodes), and the aliases
+    */
+
+    const Dword opcodes[] = {0x33, 0x13, 0x03, 0x23, 0x63, 0x6F, 0x67, 0x7F};
+    const Dword fixed[] = {0x00000000, 0x00000013, 0x00008067, 0x0080006F, 0xFF9FF06F, 0x8000015B};
+
+    std::mt19937 rng(42);
+    std::vector<Instruction> instructions;
+    instructions.reserve(count);
+
+    for (Dword word : fixed) { instructions.push_back(decode_instruction(word)); }
+
+    while (instructions.size() < count) {
+        Dword word = (rng() & ~0x7Fu) | opcodes[rng() % 8];
+        Instruction decoded = decode_instruction(word);
+        if (is_shift_immediate(decoded.instruction)) { continue; } // Printed as the shift amount now
+        if ((decoded.type == LOAD || decoded.type == STORE) && decoded.instruction != LW && decoded.instruction != SW) { continue; } // Were all LW/SW
+        instructions.push_back(decoded);
+    }
+
+    return instructions;
+}
+
+static volatile std::size_t sink; // Keeps the timed loops from being optimized away
+
+static double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char* argv[]) {
+
+    std::size_t count = (argc > 1) ? std::stoull(argv[1]) : 1000000;
+    std::size_t regex_count = std::min<std::size_t>(count, 50000); // The regex reference is far slower
+
+    std::vector<Instruction> instructions = make_instructions(count);
+    char line[MAX_FORMATTED_LENGTH];
+
+    // Byte identical to the old output
+    for (std::size_t i = 0; i < count; i++) {
+
+        int position = 496 + static_cast<int>(i * 4);
+        std::string expected = legacy::disassemble_instruction(instructions[i], position);
+
+        if (std::string_view(line, format_disassembly(instructions[i], position, line)) != expected) {
+            std::cerr << "dis mismatch for " << instructions[i].value << ": expected [" << expected << "]" << std::endl;
+            return 1;
+        }
+
+        if (i < regex_count) {
+            std::string expected_style = legacy::instruction_to_new_style_string(instructions[i]);
+            if (std::string_view(line, format_new_style(instructions[i], line)) != expected_style) {
+                std::cerr << "new style mismatch for " << instructions[i].value << ": expected [" << expected_style << "]" << std::endl;
+                return 1;
+            }
+        }
+    }
+
+    // Old: a std::string per line, appended to the output
+    std::string legacy_text;
+    std::size_t allocations_before = heap_allocations;
+    auto start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < count; i++) {
+        legacy_text += legacy::disassemble_instruction(instructions[i], 496 + static_cast<int>(i * 4));
+        legacy_text += '\n';
+    }
+    double legacy_time = seconds_since(start);
+    std::size_t legacy_allocations = heap_allocations - allocations_before;
+
+    // New: straight into the output buffer, reserved up front so only the formatter is counted
+    std::string text;
+    text.reserve(legacy_text.size());
+    allocations_before = heap_allocations;
+    start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < count; i++) {
+        std::size_t length = format_disassembly(instructions[i], 496 + static_cast<int>(i * 4), line);
+        line[length++] = '\n';
+        text.append(line, length);
+    }
+    double new_time = seconds_since(start);
+    std::size_t new_allocations = heap_allocations - allocations_before;
+
+    // Trace strings
+    allocations_before = heap_allocations;
+    start = std::chrono::steady_clock::now();
+    std::size_t style_bytes = 0;
+    for (std::size_t i = 0; i < count; i++) { style_bytes += format_new_style(instructions[i], line); }
+    double style_time = seconds_since(start);
+    std::size_t style_allocations = heap_allocations - allocations_before;
+
+    start = std::chrono::steady_clock::now();
+    std::size_t legacy_style_bytes = 0;
+    for (std::size_t i = 0; i < regex_count; i++) { legacy_style_bytes += legacy::instruction_to_new_style_string(instructions[i]).size(); }
+    double legacy_style_time = seconds_since(start);
+
+    sink = style_bytes + legacy_style_bytes;
+
+    if (text != legacy_text) {
+        std::cerr << "dis output differs" << std::endl;
+        return 1;
+    }
+
+    std::cout << "Lines             : " << count << " (" << regex_count << " through the regex reference), all identical\n";
+    std::cout << "dis, old          : " << (count / legacy_time) << " lines/s, " << legacy_allocations << " allocations\n";
+    std::cout << "dis, new          : " << (count / new_time) << " lines/s, " << new_allocations << " allocations\n";
+    std::cout << "new style, regex  : " << (regex_count / legacy_style_time) << " strings/s\n";
+    std::cout << "new style, buffer : " << (count / style_time) << " strings/s, " << style_allocations << " allocations\n";
+
+    if (new_allocations != 0 || style_allocations != 0) {
+        std::cerr << "The buffer formatters allocated" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,159 @@
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#include <unordered_map>
+#include <vector>
+
+#include "../include/decodedprogram.h"
+#include "../include/instruction.h"
+
+/**
+ * Memory and copy cost of Instruction vs the old layout with two unordered_maps
+ *
+ * Stored instructions (instruction_map, the lexer's vector) have never been through RF/ID,
+ * in-flight ones have had both register values and both forwarding distances set.
+ * Heap use is measured by counting operator new in this program.
+ *
+ * Also compares the pipeline's program store: the old vector plus unordered_map<int, Instruction>
+ * (every instruction held twice) against DecodedProgram.
+ *
+ * Usage: instruction_layout_bench [num_copies]
+ */
+
+static std::size_t heap_bytes = 0;
+static std::size_t heap_allocations = 0;
+
+void* operator new(std::size_t size) {
+    heap_bytes += size;
+    heap_allocations++;
+    if (void* memory = std::malloc(size)) { return memory; }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept { std::free(memory); }
+void operator delete(void* memory, std::size_t) noexcept { std::free(memory); }
+
+namespace legacy {
+
+// Instruction as it was before the fixed arrays
+struct Instruction {
+    Dword value;
+    int type; // Both enums were int sized then
+    int instruction;
+    Dword rs1;
+    Dword rs2;
+    Dword rd;
+    int32_t imm;
+    int32_t result;
+    int32_t mem_address_store;
+    std::unordered_map<DEPENDENCY_TYPE, int32_t> registerValues;
+    bool needsForward = false;
+    bool needsToForward = false;
+    std::unordered_map<DEPENDENCY_TYPE, int> forward_from;
+
+    std::unordered_map<DEPENDENCY_TYPE, uint32_t> getDependencies() const {
+        std::unordered_map<DEPENDENCY_TYPE, uint32_t> dependencies;
+        dependencies[RS1] = rs1;
+        dependencies[RS2] = rs2;
+        return dependencies;
+    }
+};
+
+} // namespace legacy
+
+template <typename Make>
+static std::size_t heap_of(Make make) {
+    std::size_t before = heap_bytes;
+    auto made = make();
+    (void)made;
+    return heap_bytes - before;
+}
+
+template <typename T>
+static double time_copies(const T& original, std::size_t count, std::size_t& allocations) {
+    // Like filling Forwarding::pending_forwards or the instruction map
+    std::vector<T> copies;
+    copies.reserve(count);
+    std::size_t allocations_before = heap_allocations;
+    auto start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < count; i++) { copies.push_back(original); }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    allocations = heap_allocations - allocations_before;
+    return elapsed;
+}
+
+int main(int argc, char* argv[]) {
+
+    std::size_t count = (argc > 1) ? std::stoull(argv[1]) : 1000000;
+
+    Instruction stored = decode_instruction(0x00c58533); // ADD x10, x11, x12
+    legacy::Instruction legacy_stored{};
+    legacy_stored.value = stored.value;
+    legacy_stored.rs1 = stored.rs1;
+    legacy_stored.rs2 = stored.rs2;
+    legacy_stored.rd = stored.rd;
+
+    Instruction in_flight = stored;
+    in_flight.setRegisterValue(RS1, 1);
+    in_flight.setRegisterValue(RS2, 2);
+    in_flight.setNumCyclesAhead(RS1, 1);
+    in_flight.setNumCyclesAhead(RS2, 2);
+
+    legacy::Instruction legacy_in_flight = legacy_stored;
+    legacy_in_flight.registerValues[RS1] = 1;
+    legacy_in_flight.registerValues[RS2] = 2;
+    legacy_in_flight.forward_from[RS1] = 1;
+    legacy_in_flight.forward_from[RS2] = 2;
+
+    std::size_t legacy_stored_heap = heap_of([&]() { return legacy_stored; });
+    std::size_t legacy_in_flight_heap = heap_of([&]() { return legacy_in_flight; });
+    std::size_t legacy_dependencies_heap = heap_of([&]() { return legacy_in_flight.getDependencies(); });
+    std::size_t stored_heap = heap_of([&]() { return stored; });
+    std::size_t in_flight_heap = heap_of([&]() { return in_flight; });
+    std::size_t dependencies_heap = heap_of([&]() { return in_flight.getDependencies(); });
+
+    std::size_t legacy_stored_total = sizeof(legacy::Instruction) + legacy_stored_heap;
+    std::size_t legacy_in_flight_total = sizeof(legacy::Instruction) + legacy_in_flight_heap;
+    std::size_t stored_total = sizeof(Instruction) + stored_heap;
+    std::size_t in_flight_total = sizeof(Instruction) + in_flight_heap;
+
+    std::cout << "                   old         new\n";
+    std::cout << "sizeof             " << sizeof(legacy::Instruction) << " B       " << sizeof(Instruction) << " B\n";
+    std::cout << "Stored             " << legacy_stored_total << " B       " << stored_total << " B  (saves "
+              << (legacy_stored_total - stored_total) << " B per instruction)\n";
+    std::cout << "In flight          " << legacy_in_flight_total << " B       " << in_flight_total << " B  (saves "
+              << (legacy_in_flight_total - in_flight_total) << " B per copy)\n";
+    std::cout << "getDependencies()  " << legacy_dependencies_heap << " B heap  " << dependencies_heap << " B heap\n";
+
+    std::size_t legacy_allocations = 0;
+    std::size_t new_allocations = 0;
+    double legacy_time = time_copies(legacy_in_flight, count, legacy_allocations);
+    double new_time = time_copies(in_flight, count, new_allocations);
+
+    std::cout << "\n" << count << " in-flight copies:\n";
+    std::cout << "Old : " << legacy_time << " s, " << legacy_allocations << " allocations\n";
+    std::cout << "New : " << new_time << " s, " << new_allocations << " allocations\n";
+
+    // Program store, num_copies instructions loaded back to back
+    std::size_t old_store_bytes = 0;
+    {
+        std::vector<Instruction> instructions;
+        std::unordered_map<int, Instruction> instruction_map;
+        std::size_t map_before = heap_bytes;
+        for (std::size_t i = 0; i < count; i++) { instruction_map[496 + static_cast<int>(i * 4)] = stored; }
+        std::size_t map_bytes = heap_bytes - map_before; // Nodes plus every bucket array it grew through
+        for (std::size_t i = 0; i < count; i++) { instructions.push_back(stored); }
+        old_store_bytes = map_bytes + instructions.capacity() * sizeof(Instruction);
+    }
+    double map_per_instruction = static_cast<double>(old_store_bytes) / count;
+
+    DecodedProgram program;
+    for (std::size_t i = 0; i < count; i++) { program.add(stored, 496 + static_cast<uint32_t>(i * 4)); }
+    double image_per_instruction = static_cast<double>(program.getMemoryUsage()) / count;
+
+    std::cout << "\nPer loaded instruction:\n";
+    std::cout << "vector + unordered_map : " << map_per_instruction << " B\n";
+    std::cout << "DecodedProgram         : " << image_per_instruction << " B\n";
+
+    return 0;
+}
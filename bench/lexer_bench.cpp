@@ -0,0 +1,78 @@
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../include/lexer.h"
+
+/**
+ * Lexer input throughput: STREAMED (ifstream) vs MAPPED (mmap + SIMD kernel)
+ *
+ * Usage: lexer_bench [num_instructions] [scratch_file]
+ */
+
+static void write_input(const std::string& path, std::size_t count) {
+
+    std::mt19937 rng(42);
+    std::ofstream out(path, std::ios::out | std::ios::trunc);
+
+    for (std::size_t i = 0; i < count; i++) {
+        out << std::bitset<32>(rng()).to_string() << "\n";
+    }
+}
+
+static double time_lexer(const std::string& path, InputMode mode, std::vector<Dword>& words) {
+
+    Lexer lexer;
+    lexer.set_input_file(path.c_str(), mode);
+
+    auto start = std::chrono::steady_clock::now();
+    while (!lexer.isEOF()) {
+        words.push_back(lexer.consume_instruction());
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double>(end - start).count();
+}
+
+int main(int argc, char* argv[]) {
+
+    std::size_t count = (argc > 1) ? std::stoull(argv[1]) : 2000000;
+    std::string path = (argc > 2) ? argv[2] : "lexer_bench_input.txt";
+
+    write_input(path, count);
+
+    std::vector<Dword> streamed;
+    std::vector<Dword> mapped;
+    streamed.reserve(count + 1);
+    mapped.reserve(count + 1);
+
+    // The "No bytes left" diagnostic at EOF is expected, keep it out of the way
+    std::cerr.setstate(std::ios::failbit);
+    double streamed_time = time_lexer(path, STREAMED, streamed);
+    double mapped_time = time_lexer(path, MAPPED, mapped);
+    std::cerr.clear();
+
+    std::remove(path.c_str());
+
+    // The final read is the one that hits EOF, its value is not meaningful on the stream path
+    streamed.pop_back();
+    mapped.pop_back();
+
+    if (streamed != mapped) {
+        std::cerr << "MAPPED output differs from STREAMED output" << std::endl;
+        return 1;
+    }
+
+    double megabytes = (count * 33) / (1024.0 * 1024.0);
+
+    std::cout << "Instructions : " << count << "\n";
+    std::cout << "STREAMED     : " << streamed_time << " s, " << (megabytes / streamed_time) << " MB/s, "
+              << (count / streamed_time) << " instr/s\n";
+    std::cout << "MAPPED       : " << mapped_time << " s, " << (megabytes / mapped_time) << " MB/s, "
+              << (count / mapped_time) << " instr/s\n";
+    std::cout << "Speedup      : " << (streamed_time / mapped_time) << "x\n";
+
+    return 0;
+}
@@ -0,0 +1,138 @@
+#include <chrono>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../include/guestmemory.h"
+#include "../include/pipeline.h"
+
+/**
+ * Guest memory: the old unordered_map of words vs GuestMemory's page table
+ *
+ * Random word stores then loads over a working set, both must read back the same values.
+ * GuestMemory runs again with huge pages, then touches one word every 64 KiB across the whole
+ * 4 GiB address space to show the sparse cost.
+ *
+ * Usage: memory_bench [working_set_mib] [operations]
+ */
+
+namespace legacy {
+
+// As Pipeline kept data memory before, one hash map entry per word
+struct WordMap {
+
+    std::unordered_map<uint32_t, int32_t> words;
+
+    bool write32(uint32_t address, uint32_t value) {
+        words[address] = static_cast<int32_t>(value);
+        return true;
+    }
+
+    bool read32(uint32_t address, uint32_t& value) const {
+        auto it = words.find(address);
+        if (it == words.end()) { return false; }
+        value = static_cast<uint32_t>(it->second);
+        return true;
+    }
+};
+
+} // namespace legacy
+
+static std::vector<uint32_t> random_addresses(std::size_t count, uint64_t working_set) {
+
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<uint32_t> word(0, static_cast<uint32_t>(working_set / 4 - 1));
+
+    std::vector<uint32_t> addresses(count);
+    for (uint32_t& address : addresses) { address = 0x10000000u + word(rng) * 4; }
+
+    return addresses;
+}
+
+// Stores every address, then loads them back, returns the seconds for both passes (0 if a value is wrong)
+template <typename Memory>
+static double store_then_load(Memory& memory, const std::vector<uint32_t>& addresses, uint64_t& checksum) {
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (uint32_t address : addresses) { memory.write32(address, address ^ 0x5A5A5A5Au); }
+
+    checksum = 0;
+    for (uint32_t address : addresses) {
+        uint32_t value = 0;
+        if (!memory.read32(address, value) || value != (address ^ 0x5A5A5A5Au)) { return 0; }
+        checksum += value;
+    }
+
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char* argv[]) {
+
+    uint64_t working_set = ((argc > 1) ? std::stoull(argv[1]) : 64) << 20;
+    std::size_t operations = (argc > 2) ? std::stoull(argv[2]) : 4000000;
+
+    std::vector<uint32_t> addresses = random_addresses(operations, working_set);
+
+    uint64_t old_sum = 0;
+    uint64_t new_sum = 0;
+    uint64_t huge_sum = 0;
+
+    legacy::WordMap old_memory;
+    double old_time = store_then_load(old_memory, addresses, old_sum);
+
+    GuestMemory new_memory;
+    new_memory.addRegion("data", 0x10000000u, working_set);
+    double new_time = store_then_load(new_memory, addresses, new_sum);
+
+    GuestMemory huge_memory;
+    huge_memory.setHugePages(true);
+    huge_memory.addRegion("data", 0x10000000u, working_set);
+    double huge_time = store_then_load(huge_memory, addresses, huge_sum);
+
+    if (old_time == 0 || new_time == 0 || huge_time == 0 || old_sum != new_sum || new_sum != huge_sum) {
+        std::cerr << "A load did not return what was stored" << std::endl;
+        return 1;
+    }
+
+    // One word every 64 KiB over the whole address space
+    GuestMemory sparse;
+    sparse.addRegion("all", 0, uint64_t(1) << 32);
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t address = 0; address < (uint64_t(1) << 32); address += 64 * 1024) {
+        sparse.write32(static_cast<uint32_t>(address), static_cast<uint32_t>(address >> 16));
+    }
+    double sparse_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    for (uint64_t address = 0; address < (uint64_t(1) << 32); address += 64 * 1024) {
+        uint32_t value = 0;
+        if (!sparse.read32(static_cast<uint32_t>(address), value) || value != (address >> 16)) {
+            std::cerr << "Sparse read back failed at " << address << std::endl;
+            return 1;
+        }
+    }
+
+    // Loads outside the map must fail, not allocate
+    Pipeline pipeline;
+    pipeline.getMemory().addRegion("extra", 0x80000000u, 4096);
+    bool map_ok = pipeline.setDataMemory(0x80000000u, 7) && pipeline.getDataMemory(0x80000000u) == 7 &&
+                  !pipeline.getMemory().isMapped(0x80001000u, 4);
+    if (!map_ok) {
+        std::cerr << "The memory map was not honoured" << std::endl;
+        return 1;
+    }
+
+    double accesses = 2.0 * operations;
+
+    std::cout << "Working set       : " << (working_set >> 20) << " MiB, " << operations << " stores then loads\n";
+    std::cout << "Word map          : " << (accesses / old_time) << " accesses/s, " << old_memory.words.size() << " entries\n";
+    std::cout << "Page table        : " << (accesses / new_time) << " accesses/s, " << new_memory.getPagesAllocated() << " pages\n";
+    std::cout << "Huge pages        : " << (accesses / huge_time) << " accesses/s\n";
+    std::cout << "Speedup           : " << (old_time / new_time) << "x\n";
+    std::cout << "\nWhole 4 GiB       : " << sparse.getPagesAllocated() << " pages touched in " << sparse_time << " s, "
+              << (sparse.getBytesReserved() >> 20) << " MiB reserved\n";
+
+    return 0;
+}
@@ -0,0 +1,153 @@
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../include/pipeline.h"
+
+/**
+ * RV32M: multiply/divide results and the cost of multiplier and divider timings
+ *
+ * A straight-line program of back-to-back multiplies, divides (including by zero and INT32_MIN / -1)
+ * and ALU ops on a few registers, so most instructions depend on the one before. Every timing must
+ * leave the same registers as a plain interpreter; the table shows what each one costs in CPI and
+ * in the two kinds of stall.
+ *
+ * Usage: muldiv_bench [instructions] [seed]
+ */
+
+static Dword r_type(uint32_t funct7, uint32_t rs2, uint32_t rs1, uint32_t funct3, uint32_t rd) {
+    return (funct7 << 25) | (rs2 << 20) | (rs1 << 15) | (funct3 << 12) | (rd << 7) | 0x33;
+}
+
+static Dword addi(uint32_t rd, uint32_t rs1, int32_t imm) {
+    return ((static_cast<uint32_t>(imm) & 0xFFF) << 20) | (rs1 << 15) | (rd << 7) | 0x13;
+}
+
+static Dword lui(uint32_t rd, uint32_t upper) { return (upper << 12) | (rd << 7) | 0x37; }
+
+// What the M extension defines, written out independently of the pipeline
+static uint32_t reference_m(uint32_t funct3, uint32_t a, uint32_t b) {
+
+    int32_t sa = static_cast<int32_t>(a);
+    int32_t sb = static_cast<int32_t>(b);
+
+    switch (funct3) {
+        case 0: return a * b;
+        case 1: return static_cast<uint32_t>(static_cast<uint64_t>(int64_t(sa) * int64_t(sb)) >> 32);
+        case 2: return static_cast<uint32_t>(static_cast<uint64_t>(int64_t(sa) * int64_t(b)) >> 32);
+        case 3: return static_cast<uint32_t>((uint64_t(a) * uint64_t(b)) >> 32);
+        case 4: return b == 0 ? 0xFFFFFFFFu : (a == 0x80000000u && b == 0xFFFFFFFFu) ? a : static_cast<uint32_t>(sa / sb);
+        case 5: return b == 0 ? 0xFFFFFFFFu : a / b;
+        case 6: return b == 0 ? a : (a == 0x80000000u && b == 0xFFFFFFFFu) ? 0 : static_cast<uint32_t>(sa % sb);
+        default: return b == 0 ? a : a % b;
+    }
+}
+
+// Program and the registers it must end with
+static std::vector<Dword> build_program(std::size_t count, unsigned seed, std::array<uint32_t, 32>& expected) {
+
+    std::vector<Dword> words;
+    expected.fill(0);
+
+    // Edge values to start from, LUI + ADDI each
+    const uint32_t initial[] = {0x80000000u, 0xFFFFFFFFu, 0, 7, static_cast<uint32_t>(-13), 0x12345678u, 0xFFFF0000u, 3};
+    for (uint32_t reg = 1; reg <= 8; reg++) {
+        uint32_t value = initial[reg - 1];
+        uint32_t upper = (value + 0x800) >> 12;
+        words.push_back(lui(reg, upper & 0xFFFFF));
+        words.push_back(addi(reg, reg, static_cast<int32_t>(value - (upper << 12))));
+        expected[reg] = value;
+    }
+
+    std::mt19937 rng(seed);
+
+    for (std::size_t i = 0; i < count; i++) {
+
+        uint32_t rd = 1 + rng() % 15;
+        uint32_t rs1 = rng() % 16;
+        uint32_t rs2 = rng() % 16;
+        uint32_t kind = rng() % 10;
+
+        if (kind < 6) {
+            uint32_t funct3 = rng() % 8;
+            words.push_back(r_type(0x01, rs2, rs1, funct3, rd));
+            expected[rd] = reference_m(funct3, expected[rs1], expected[rs2]);
+        } else if (kind < 8) {
+            words.push_back(r_type(0, rs2, rs1, 0, rd)); // ADD
+            expected[rd] = expected[rs1] + expected[rs2];
+        } else {
+            int32_t imm = static_cast<int32_t>(rng() % 101) - 50;
+            words.push_back(addi(rd, rs1, imm));
+            expected[rd] = expected[rs1] + static_cast<uint32_t>(imm);
+        }
+    }
+
+    return words;
+}
+
+int main(int argc, char* argv[]) {
+
+    std::size_t count = (argc > 1) ? std::stoull(argv[1]) : 20000;
+    unsigned seed = (argc > 2) ? static_cast<unsigned>(std::stoul(argv[2])) : 1;
+
+    std::array<uint32_t, 32> expected;
+    std::vector<Dword> words = build_program(count, seed, expected);
+
+    // Timings to compare: {multiplier, divider}
+    const std::pair<FunctionalUnitTiming, FunctionalUnitTiming> timings[] = {
+        {FunctionalUnitTiming(1, 1), FunctionalUnitTiming(1, 1)}, // Everything single cycle
+        {FunctionalUnitTiming(3, 1), FunctionalUnitTiming(20, 20)}, // Default
+        {FunctionalUnitTiming(3, 3), FunctionalUnitTiming(20, 20)}, // Unpipelined multiplier
+        {FunctionalUnitTiming(5, 1), FunctionalUnitTiming(34, 34)},
+        {FunctionalUnitTiming(3, 1), FunctionalUnitTiming(20, 4)}, // Partly pipelined divider
+    };
+
+    // An interval longer than the latency makes no sense
+    Pipeline rejected;
+    if (rejected.setFunctionalUnitTiming(DIVIDER, FunctionalUnitTiming(4, 5)) ||
+        rejected.getFunctionalUnitTiming(DIVIDER).latency != 20) {
+        std::cerr << "An invalid timing was accepted" << std::endl;
+        return 1;
+    }
+
+    std::cout << "Instructions      : " << words.size() << " (seed " << seed << ")\n\n";
+    std::cout << "mul lat:int  div lat:int       cycles     CPI   structural   RAW (mul/div)   cycles/s\n";
+
+    for (const auto& timing : timings) {
+
+        Pipeline pipeline;
+        pipeline.setFunctionalUnitTiming(MULTIPLIER, timing.first);
+        pipeline.setFunctionalUnitTiming(DIVIDER, timing.second);
+        for (Dword word : words) { pipeline.addInstruction(decode_instruction(word)); }
+
+        auto start = std::chrono::steady_clock::now();
+        RunResult result = pipeline.run();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        if (result.status != FINISHED) {
+            std::cerr << "The run ended with " << run_status_to_string(result.status) << std::endl;
+            return 1;
+        }
+
+        for (uint32_t reg = 0; reg < 32; reg++) {
+            if (static_cast<uint32_t>(pipeline.getIntegerRegister(reg)) != expected[reg]) {
+                std::cerr << "x" << reg << " is " << pipeline.getIntegerRegister(reg) << ", expected "
+                          << static_cast<int32_t>(expected[reg]) << std::endl;
+                return 1;
+            }
+        }
+
+        char line[160];
+        std::snprintf(line, sizeof(line), "%7d:%-4d %7d:%-4d %12llu %7.3f %12d %15d %10.3g\n",
+                      timing.first.latency, timing.first.interval, timing.second.latency, timing.second.interval,
+                      static_cast<unsigned long long>(result.cycles), double(result.cycles) / result.instructions_retired,
+                      result.stats.structural, result.stats.raw_multi_cycle, result.cycles / seconds);
+        std::cout << line;
+    }
+
+    std::cout << "\nRegisters match the reference for every timing\n";
+
+    return 0;
+}
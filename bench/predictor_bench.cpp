@@ -0,0 +1,359 @@
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../include/pipeline.h"
+
+/**
+ * Branch prediction: direction predictors on their own, and what they, the BTB and the RAS save in the pipeline
+ *
+ * First every predictor is fed synthetic outcome streams (loop exits, alternating, correlated and
+ * random branches) directly, which shows accuracy and predictions per second without a pipeline.
+ * Then a program of nested loops and data-dependent forward branches runs under each predictor, and
+ * a loop of direct and indirect calls under several BTB and RAS sizes. Every run must leave the same
+ * registers as a plain interpreter, the tables show CPI, accuracy, MPKI and wrong jump targets.
+ *
+ * Usage: predictor_bench [outer iterations] [seed]
+ */
+
+static Dword r_type(uint32_t funct7, uint32_t rs2, uint32_t rs1, uint32_t funct3, uint32_t rd) {
+    return (funct7 << 25) | (rs2 << 20) | (rs1 << 15) | (funct3 << 12) | (rd << 7) | 0x33;
+}
+
+static Dword i_type(uint32_t funct3, uint32_t rd, uint32_t rs1, int32_t imm) {
+    return ((static_cast<uint32_t>(imm) & 0xFFF) << 20) | (rs1 << 15) | (funct3 << 12) | (rd << 7) | 0x13;
+}
+
+// Branch immediates are laid out like a store's, and a taken branch at B goes to B + 16 + offset
+static Dword branch(uint32_t funct3, uint32_t rs1, uint32_t rs2, int32_t offset) {
+    uint32_t bits = static_cast<uint32_t>(offset) & 0xFFF;
+    return ((bits >> 5) << 25) | (rs2 << 20) | (rs1 << 15) | (funct3 << 12) | ((bits & 0x1F) << 7) | 0x63;
+}
+
+// Jumps go to J + 16 + offset too, and link J + 20
+static Dword jal(uint32_t rd, int32_t offset) {
+    uint32_t bits = static_cast<uint32_t>(offset) & 0x1FFFFF;
+    return (((bits >> 20) & 1) << 31) | (((bits >> 1) & 0x3FF) << 21) | (((bits >> 11) & 1) << 20) | (((bits >> 12) & 0xFF) << 12) | (rd << 7) | 0x6F;
+}
+
+static Dword jalr(uint32_t rd, uint32_t rs1) { return (rs1 << 15) | (rd << 7) | 0x67; }
+
+const Dword RET_WORD = 0x00008067; // JALR x0, 0(x1)
+
+const uint32_t BASE_ADDRESS = 496;
+const uint32_t OUTER = 20; // Loop counters, never written by the bodies
+const uint32_t INNER = 21;
+const uint32_t LINK = 1;
+const uint32_t SKIPPED = 4; // Words after a call its return lands past
+
+
+
+// SYNTHETIC STREAMS
+struct Stream {
+    const char* name;
+    std::size_t branches; // Distinct branch addresses
+};
+
+// Outcome of branch "which" on step "step" of a stream
+static bool outcome(int stream, std::size_t step, std::size_t which, std::mt19937& rng, std::vector<bool>& last) {
+
+    switch (stream) {
+        case 0: return (step % 8) != 7; // Loop of 8, exits once
+        case 1: return (step & 1) != 0; // Alternates
+        case 2: { // The second branch repeats the first, which is random
+            bool taken = (which == 0) ? (rng() & 1) != 0 : last[0];
+            last[which] = taken;
+            return taken;
+        }
+        default: return (rng() & 1) != 0;
+    }
+}
+
+static void run_streams(std::size_t steps) {
+
+    const Stream streams[] = {{"loop exit", 1}, {"alternating", 1}, {"correlated", 2}, {"random", 1}};
+
+    std::cout << "predictor        stream           accuracy   predictions/s\n";
+
+    for (int kind = 0; kind < NUM_PREDICTOR_KINDS; kind++) {
+        for (int stream = 0; stream < 4; stream++) {
+
+            BranchPredictor predictor;
+            predictor.configure(BranchPredictorConfig(PredictorKind(kind)));
+            std::mt19937 rng(7);
+            std::vector<bool> last(streams[stream].branches);
+            uint64_t correct = 0;
+            uint64_t predictions = steps * streams[stream].branches;
+
+            auto start = std::chrono::steady_clock::now();
+            for (std::size_t step = 0; step < steps; step++) {
+                for (std::size_t which = 0; which < streams[stream].branches; which++) {
+                    uint32_t pc = 0x1000 + static_cast<uint32_t>(which) * 64;
+                    uint64_t history = predictor.getHistory();
+                    bool predicted = predictor.predict(pc, pc - 32); // Backward, like a loop
+                    bool taken = outcome(stream, step, which, rng, last);
+                    predictor.update(pc, history, taken);
+                    if (predicted != taken) { predictor.setHistory((history << 1) | static_cast<uint64_t>(taken)); }
+                    correct += (predicted == taken);
+                }
+            }
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            char line[200];
+            std::snprintf(line, sizeof(line), "%-16s %-16s %7.2f%% %15.3g\n", predictor_kind_to_string(PredictorKind(kind)).c_str(),
+                          streams[stream].name, 100.0 * correct / predictions, predictions / seconds);
+            std::cout << line;
+        }
+    }
+}
+
+
+
+
+// PIPELINE
+struct Program {
+    std::vector<Dword> words;
+    std::array<uint32_t, 32> registers = {}; // What a plain interpreter leaves
+};
+
+// Runs words from BASE_ADDRESS, with the model's branch targets
+static std::array<uint32_t, 32> interpret(const std::vector<Dword>& words) {
+
+    std::array<uint32_t, 32> regs = {};
+    uint32_t pc = BASE_ADDRESS;
+
+    while (pc >= BASE_ADDRESS && pc < BASE_ADDRESS + words.size() * 4) {
+
+        Dword word = words[(pc - BASE_ADDRESS) / 4];
+        uint32_t rd = (word >> 7) & 0x1F, rs1 = (word >> 15) & 0x1F, rs2 = (word >> 20) & 0x1F, funct3 = (word >> 12) & 7;
+        int32_t imm = static_cast<int32_t>(word) >> 20;
+        uint32_t next = pc + 4;
+
+        switch (word & 0x7F) {
+            case 0x13: regs[rd] = (funct3 == 7) ? (regs[rs1] & static_cast<uint32_t>(imm)) : regs[rs1] + static_cast<uint32_t>(imm); break;
+            case 0x33: regs[rd] = (funct3 == 4) ? (regs[rs1] ^ regs[rs2]) : regs[rs1] + regs[rs2]; break;
+            case 0x63: {
+                int32_t offset = ((static_cast<int32_t>(word) >> 25) << 5) | static_cast<int32_t>(rd);
+                int32_t a = static_cast<int32_t>(regs[rs1]), b = static_cast<int32_t>(regs[rs2]);
+                bool taken = (funct3 == 0) ? a == b : (funct3 == 1) ? a != b : (funct3 == 4) ? a < b : a >= b;
+                if (taken) { next = pc + 16 + static_cast<uint32_t>(offset); }
+                break;
+            }
+            case 0x67: // JALR, RET
+                next = (regs[rs1] + static_cast<uint32_t>(imm)) & ~1u;
+                regs[rd] = pc + 20;
+                break;
+            case 0x6F: { // JAL
+                int32_t offset = ((static_cast<int32_t>(word) >> 31) << 20) | static_cast<int32_t>(word & 0xFF000) |
+                                 static_cast<int32_t>(((word >> 20) & 1) << 11) | static_cast<int32_t>(((word >> 21) & 0x3FF) << 1);
+                next = pc + 16 + static_cast<uint32_t>(offset);
+                regs[rd] = pc + 20;
+                break;
+            }
+        }
+
+        regs[0] = 0;
+        pc = next;
+    }
+
+    return regs;
+}
+
+static Program build_program(uint32_t outer, unsigned seed) {
+
+    Program program;
+    std::vector<Dword>& words = program.words;
+    std::mt19937 rng(seed);
+
+    for (uint32_t reg = 2; reg < 10; reg++) { words.push_back(i_type(0, reg, 0, static_cast<int32_t>(rng() % 41) - 20)); }
+
+    words.push_back(i_type(0, OUTER, 0, static_cast<int32_t>(outer)));
+    std::size_t outer_top = words.size();
+    words.push_back(i_type(0, INNER, 0, 6));
+    std::size_t inner_top = words.size();
+
+    for (int block = 0; block < 6; block++) {
+
+        uint32_t rd = 2 + rng() % 8;
+        uint32_t rs1 = 2 + rng() % 8;
+        uint32_t rs2 = 2 + rng() % 8;
+
+        words.push_back(r_type(0, rs2, rs1, (rng() & 1) ? 4 : 0, rd)); // ADD or XOR
+
+        if (block % 3 == 0) { // Taken every other inner iteration
+            words.push_back(i_type(7, 10, INNER, 1)); // ANDI
+            words.push_back(branch(0, 10, 0, 4 * 2 - 16)); // BEQ over the next one
+        } else { // Data dependent
+            words.push_back(branch((rng() & 1) ? 4 : 5, rs1, rs2, 4 * 2 - 16)); // BLT/BGE over the next one
+        }
+        words.push_back(i_type(0, rd, rd, static_cast<int32_t>(rng() % 11) - 5));
+    }
+
+    words.push_back(i_type(0, INNER, INNER, -1));
+    words.push_back(branch(1, INNER, 0, static_cast<int32_t>(4 * inner_top) - static_cast<int32_t>(4 * words.size()) - 16));
+    words.push_back(i_type(0, OUTER, OUTER, -1));
+    words.push_back(branch(1, OUTER, 0, static_cast<int32_t>(4 * outer_top) - static_cast<int32_t>(4 * words.size()) - 16));
+
+    program.registers = interpret(words);
+
+    return program;
+}
+
+// Offset from the word at "from" to the word at "to", for a branch or JAL
+static int32_t offset_to(std::size_t from, std::size_t to) { return static_cast<int32_t>(4 * to) - static_cast<int32_t>(4 * from) - 16; }
+
+static Program build_call_program(uint32_t outer) {
+    /**
+     * Three leaf functions, called directly and through a register that alternates between two of them
+     */
+
+    Program program;
+    std::vector<Dword>& words = program.words;
+
+    for (uint32_t reg = 2; reg < 10; reg++) { words.push_back(i_type(0, reg, 0, static_cast<int32_t>(reg))); }
+
+    std::size_t over = words.size();
+    words.push_back(0); // JAL over the functions
+
+    std::size_t functions[3];
+    functions[0] = words.size();
+    words.push_back(r_type(0, 3, 2, 0, 2));
+    words.push_back(i_type(0, 4, 4, 1));
+    words.push_back(RET_WORD);
+    functions[1] = words.size();
+    words.push_back(r_type(0, 2, 5, 4, 5));
+    words.push_back(RET_WORD);
+    functions[2] = words.size();
+    words.push_back(i_type(0, 6, 6, 3));
+    words.push_back(r_type(0, 6, 7, 0, 7));
+    words.push_back(RET_WORD);
+
+    words[over] = jal(10, offset_to(over, words.size()));
+
+    auto call = [&](Dword word) {
+        words.push_back(word);
+        for (uint32_t skipped = 0; skipped < SKIPPED; skipped++) { words.push_back(i_type(0, 9, 9, 1000)); } // Never runs
+    };
+
+    words.push_back(i_type(0, OUTER, 0, static_cast<int32_t>(outer)));
+    std::size_t top = words.size();
+
+    call(jal(LINK, offset_to(words.size(), functions[0])));
+    call(jal(LINK, offset_to(words.size(), functions[1])));
+
+    // x11 is function 2 on odd iterations, function 1 on even ones
+    words.push_back(i_type(7, 10, OUTER, 1)); // ANDI
+    words.push_back(i_type(0, 11, 0, static_cast<int32_t>(BASE_ADDRESS + 4 * functions[2])));
+    words.push_back(branch(1, 10, 0, 4 * 2 - 16)); // BNE over the next one
+    words.push_back(i_type(0, 11, 0, static_cast<int32_t>(BASE_ADDRESS + 4 * functions[1])));
+    call(jalr(LINK, 11));
+
+    call(jal(LINK, offset_to(words.size(), functions[2])));
+
+    words.push_back(i_type(0, OUTER, OUTER, -1));
+    words.push_back(branch(1, OUTER, 0, offset_to(words.size(), top)));
+
+    program.registers = interpret(words);
+
+    return program;
+}
+
+// Runs program on pipeline, false (with why on stderr) unless it finishes with the interpreter's registers
+static bool run_checked(Pipeline& pipeline, const Program& program, const std::string& name, RunResult& result, double& seconds) {
+
+    for (Dword word : program.words) { pipeline.addInstruction(decode_instruction(word)); }
+
+    auto start = std::chrono::steady_clock::now();
+    result = pipeline.run();
+    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (result.status != FINISHED) {
+        std::cerr << name << ": the run ended with " << run_status_to_string(result.status) << std::endl;
+        return false;
+    }
+
+    for (uint32_t reg = 0; reg < 32; reg++) {
+        if (static_cast<uint32_t>(pipeline.getIntegerRegister(reg)) != program.registers[reg]) {
+            std::cerr << name << ": x" << reg << " is " << pipeline.getIntegerRegister(reg) << ", expected "
+                      << static_cast<int32_t>(program.registers[reg]) << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+struct FrontEnd {
+    std::string name;
+    BranchTargetBufferConfig btb;
+    unsigned ras = 0;
+};
+
+int main(int argc, char* argv[]) {
+
+    uint32_t outer = (argc > 1) ? static_cast<uint32_t>(std::stoul(argv[1])) : 2000;
+    unsigned seed = (argc > 2) ? static_cast<unsigned>(std::stoul(argv[2])) : 1;
+
+    run_streams(1000000);
+
+    Program program = build_program(outer, seed);
+
+    std::cout << "\nProgram           : " << program.words.size() << " instructions, " << outer << " outer iterations (seed " << seed << ")\n\n";
+    std::cout << "predictor             cycles     CPI  branches  mispredicted  accuracy     MPKI   cycles/s\n";
+
+    for (int kind = 0; kind < NUM_PREDICTOR_KINDS; kind++) {
+
+        Pipeline pipeline;
+        if (!pipeline.setBranchPredictor(BranchPredictorConfig(PredictorKind(kind)))) { return 1; }
+
+        std::string name = predictor_kind_to_string(PredictorKind(kind));
+        RunResult result;
+        double seconds = 0;
+        if (!run_checked(pipeline, program, name, result, seconds)) { return 1; }
+
+        char line[200];
+        std::snprintf(line, sizeof(line), "%-16s %11llu %7.3f %9llu %13llu %8.2f%% %8.2f %10.3g\n", name.c_str(),
+                      static_cast<unsigned long long>(result.cycles), double(result.cycles) / result.instructions_retired,
+                      static_cast<unsigned long long>(result.stats.branches), static_cast<unsigned long long>(result.stats.mispredictions),
+                      100.0 * result.stats.predictionAccuracy(), result.stats.mispredictionsPerKilo(), result.cycles / seconds);
+        std::cout << line;
+    }
+
+    // Calls and returns under gshare, with and without a BTB and RAS
+    Program calls = build_call_program(outer);
+
+    std::vector<FrontEnd> front_ends = {
+        {"no BTB or RAS", BranchTargetBufferConfig(), 0},
+        {"RAS 8", BranchTargetBufferConfig(), 8},
+        {"BTB 16 1-way", BranchTargetBufferConfig(16, 1), 0},
+        {"BTB 256 4-way", BranchTargetBufferConfig(256, 4), 0},
+        {"BTB 16 1-way, RAS 2", BranchTargetBufferConfig(16, 1), 2},
+        {"BTB 256 4-way, RAS 8", BranchTargetBufferConfig(256, 4), 8}};
+
+    std::cout << "\nCall loop         : " << calls.words.size() << " instructions, " << outer << " iterations, gshare\n\n";
+    std::cout << "front end                  cycles     CPI     jumps  wrong target   cycles/s\n";
+
+    for (const FrontEnd& front_end : front_ends) {
+
+        Pipeline pipeline;
+        if (!pipeline.setBranchPredictor(BranchPredictorConfig(GSHARE)) || !pipeline.setBranchTargetBuffer(front_end.btb) ||
+            !pipeline.setReturnAddressStack(front_end.ras)) { return 1; }
+
+        RunResult result;
+        double seconds = 0;
+        if (!run_checked(pipeline, calls, front_end.name, result, seconds)) { return 1; }
+
+        char line[200];
+        std::snprintf(line, sizeof(line), "%-22s %11llu %7.3f %9llu %13llu %10.3g\n", front_end.name.c_str(),
+                      static_cast<unsigned long long>(result.cycles), double(result.cycles) / result.instructions_retired,
+                      static_cast<unsigned long long>(result.stats.jumps), static_cast<unsigned long long>(result.stats.target_mispredictions),
+                      result.cycles / seconds);
+        std::cout << line;
+    }
+
+    std::cout << "\nRegisters match the reference under every predictor and front end\n";
+
+    return 0;
+}
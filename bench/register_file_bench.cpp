@@ -0,0 +1,119 @@
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../include/pipeline.h"
+
+/**
+ * Integer register file: the old string-keyed map vs IntegerRegisterFile, then a whole headless run
+ *
+ * The workload is a register-heavy program (test/test_irr.txt by default) copied back to back.
+ * Its register traffic, two reads and a write per instruction, is first replayed against both
+ * register files, which must end up holding the same values. Then the scaled program is simulated
+ * to completion.
+ *
+ * Usage: register_file_bench [copies] [program]
+ */
+
+namespace legacy {
+
+// As Pipeline kept them before, keyed "R0".."R31"
+struct StringRegisterFile {
+
+    std::unordered_map<std::string, int32_t> registers;
+
+    StringRegisterFile() {
+        for (int i = 0; i < 32; i++) { registers["R" + std::to_string(i)] = 0; }
+    }
+
+    int32_t read(uint32_t reg) const { return registers.at("R" + std::to_string(reg)); }
+    void write(uint32_t reg, int32_t value) { registers["R" + std::to_string(reg)] = value; }
+};
+
+} // namespace legacy
+
+static bool read_program(const std::string& path, std::vector<Dword>& words) {
+
+    std::ifstream in(path);
+    if (!in.is_open()) { return false; }
+
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.size() < 32) { continue; }
+        words.push_back(static_cast<Dword>(std::stoul(line.substr(0, 32), nullptr, 2)));
+    }
+
+    return !words.empty();
+}
+
+template <typename RegisterFile>
+static double replay(const std::vector<Instruction>& program, std::size_t copies, RegisterFile& registers) {
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (std::size_t copy = 0; copy < copies; copy++) {
+        for (const Instruction& inst : program) {
+            Dependencies sources = inst.getDependencies();
+            int32_t value = registers.read(sources[RS1]) + registers.read(sources[RS2]) + 1;
+            if (inst.rd != 0) { registers.write(inst.rd, value); } // x0 stays 0 in both
+        }
+    }
+
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char* argv[]) {
+
+    std::size_t copies = (argc > 1) ? std::stoull(argv[1]) : 100000;
+    std::string path = (argc > 2) ? argv[2] : "../test/test_irr.txt";
+
+    std::vector<Dword> words;
+    if (!read_program(path, words)) {
+        std::cerr << "Could not read a program from [" << path << "]" << std::endl;
+        return 1;
+    }
+
+    std::vector<Instruction> program;
+    for (Dword word : words) { program.push_back(decode_instruction(word)); }
+
+    std::size_t instructions = program.size() * copies;
+
+    // Register traffic only
+    legacy::StringRegisterFile old_registers;
+    IntegerRegisterFile new_registers;
+
+    double old_time = replay(program, copies, old_registers);
+    double new_time = replay(program, copies, new_registers);
+
+    for (uint32_t reg = 0; reg < 32; reg++) {
+        if (old_registers.read(reg) != new_registers.read(reg)) {
+            std::cerr << "x" << reg << " differs: " << old_registers.read(reg) << " vs " << new_registers.read(reg) << std::endl;
+            return 1;
+        }
+    }
+
+    // Whole pipeline
+    Pipeline pipeline;
+    for (std::size_t copy = 0; copy < copies; copy++) {
+        for (Dword word : words) { pipeline.addInstruction(decode_instruction(word)); }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    RunResult result = pipeline.run();
+    double run_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (result.status != FINISHED) {
+        std::cerr << "The run ended with " << run_status_to_string(result.status) << std::endl;
+        return 1;
+    }
+
+    std::cout << "Instructions      : " << instructions << " (" << copies << " copies of " << path << ")\n";
+    std::cout << "String map        : " << (instructions / old_time) << " instructions/s of register traffic\n";
+    std::cout << "Register file     : " << (instructions / new_time) << " instructions/s of register traffic\n";
+    std::cout << "Speedup           : " << (old_time / new_time) << "x\n";
+    std::cout << "\nsim (headless)    : " << (result.cycles / run_time) << " cycles/s, " << result.cycles << " cycles\n";
+
+    return 0;
+}
@@ -0,0 +1,132 @@
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#include <string>
+
+#include "../include/pipeline.h"
+
+/**
+ * Simulated cycles per second with the per-cycle trace (dis) vs headless (sim)
+ *
+ * Runs a small loop (two ADDIs, ADD, SUB, BEQ back) for the same number of cycles both ways. The
+ * traced run builds getCycleOutput() every cycle like main.cpp does, but keeps it out of the
+ * terminal so only the formatting is measured. Logging is whatever RISCVSIM_LOG_LEVEL was built in.
+ * Heap use is measured by counting operator new after a short warm-up, the headless loop must
+ * make none.
+ *
+ * Then runs the loop body without the branch to completion many times over in this one process
+ * (a fresh Pipeline each time), the way an embedder would batch short simulations.
+ *
+ * Usage: sim_bench [num_cycles] [num_short_runs]
+ */
+
+static const Dword LOOP[] = {
+    0x00108093, // ADDI x1, x1, 1
+    0x00210113, // ADDI x2, x2, 2
+    0x002081B3, // ADD  x3, x1, x2
+    0x40118233, // SUB  x4, x3, x1
+    0xFE000863, // BEQ  x0, x0, -16 (back to the first ADDI)
+};
+
+static std::size_t heap_allocations = 0;
+
+void* operator new(std::size_t size) {
+    heap_allocations++;
+    if (void* memory = std::malloc(size)) { return memory; }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept { std::free(memory); }
+void operator delete(void* memory, std::size_t) noexcept { std::free(memory); }
+
+const uint64_t WARM_UP_CYCLES = 100; // A few trips around the loop before counting
+
+static double run(int cycles, bool traced, std::size_t& trace_bytes, std::size_t& allocations) {
+
+    Pipeline pipeline;
+    for (Dword word : LOOP) { pipeline.addInstruction(decode_instruction(word)); }
+
+    pipeline.run(WARM_UP_CYCLES);
+
+    trace_bytes = 0;
+    uint64_t limit = WARM_UP_CYCLES + cycles;
+    std::size_t allocations_before = heap_allocations;
+
+    auto start = std::chrono::steady_clock::now();
+
+    if (traced) {
+        while (pipeline.getCycle() < limit && pipeline.step() == RUNNING) {
+            trace_bytes += pipeline.getCycleOutput().size();
+        }
+    } else {
+        pipeline.step(cycles); // Not run(), its RunResult copies Stats once at the end
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    allocations = heap_allocations - allocations_before;
+
+    if (pipeline.getStatus() != RUNNING) {
+        std::cerr << "The loop ended (" << run_status_to_string(pipeline.getStatus()) << ") after " << pipeline.getCycle() << " cycles" << std::endl;
+        return 0;
+    }
+
+    return seconds;
+}
+
+// Straight line (no BEQ), runs to FINISHED
+static double short_runs(int runs, uint64_t& total_cycles) {
+
+    total_cycles = 0;
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < runs; i++) {
+        Pipeline pipeline;
+        for (std::size_t j = 0; j + 1 < sizeof(LOOP) / sizeof(LOOP[0]); j++) { pipeline.addInstruction(decode_instruction(LOOP[j])); }
+
+        RunResult result = pipeline.run(1000);
+        if (result.status != FINISHED) {
+            std::cerr << "Short run ended with " << run_status_to_string(result.status) << std::endl;
+            return 0;
+        }
+        total_cycles += result.cycles;
+    }
+
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char* argv[]) {
+
+    int cycles = (argc > 1) ? std::stoi(argv[1]) : 1000000;
+    int runs = (argc > 2) ? std::stoi(argv[2]) : 100000;
+
+    std::size_t trace_bytes = 0;
+    std::size_t no_bytes = 0;
+    std::size_t traced_allocations = 0;
+    std::size_t headless_allocations = 0;
+    double traced_time = run(cycles, true, trace_bytes, traced_allocations);
+    double headless_time = run(cycles, false, no_bytes, headless_allocations);
+
+    if (traced_time == 0 || headless_time == 0) { return 1; }
+
+    std::cout << "Cycles            : " << cycles << "\n";
+    std::cout << "dis (traced)      : " << (cycles / traced_time) << " cycles/s, " << trace_bytes / cycles << " B of trace per cycle, "
+              << (static_cast<double>(traced_allocations) / cycles) << " allocations per cycle\n";
+    std::cout << "sim (headless)    : " << (cycles / headless_time) << " cycles/s, " << headless_allocations << " allocations\n";
+    std::cout << "Speedup           : " << (traced_time / headless_time) << "x\n";
+
+    if (headless_allocations != 0) {
+        std::cerr << "The headless cycle loop allocated" << std::endl;
+        return 1;
+    }
+
+    uint64_t short_cycles = 0;
+    double short_time = short_runs(runs, short_cycles);
+    if (short_time == 0) { return 1; }
+
+    std::cout << "\nShort runs        : " << runs << " to completion, " << (short_cycles / runs) << " cycles each\n";
+    std::cout << "In process        : " << (runs / short_time) << " runs/s\n";
+
+    return 0;
+}
@@ -0,0 +1,117 @@
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+
+#include "../include/imagecache.h"
+#include "../include/lexer.h"
+#include "../include/pipeline.h"
+
+/**
+ * Startup time to the first simulated cycle: lexing + decoding + dis output vs a mapped .rvimg
+ *
+ * Follows main.cpp's batch text path. The cold run writes the cache, the warm run loads from it,
+ * and both dis outputs must be byte identical.
+ *
+ * Usage: startup_bench [num_instructions] [scratch_prefix]
+ */
+
+static void write_input(const std::string& path, std::size_t count) {
+
+    std::mt19937 rng(42);
+    std::ofstream out(path, std::ios::out | std::ios::trunc);
+
+    for (std::size_t i = 0; i < count; i++) {
+        out << std::bitset<32>(rng()).to_string() << "\n";
+    }
+}
+
+static double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static bool same_file(const std::string& a, const std::string& b) {
+    std::ifstream first(a, std::ios::binary);
+    std::ifstream second(b, std::ios::binary);
+    std::string first_text((std::istreambuf_iterator<char>(first)), std::istreambuf_iterator<char>());
+    std::string second_text((std::istreambuf_iterator<char>(second)), std::istreambuf_iterator<char>());
+    return first_text == second_text;
+}
+
+int main(int argc, char* argv[]) {
+
+    std::size_t count = (argc > 1) ? std::stoull(argv[1]) : 2000000;
+    std::string prefix = (argc > 2) ? argv[2] : "startup_bench";
+
+    std::string input = prefix + "_input.txt";
+    std::string cache_file = prefix + "_input.rvimg";
+    std::string cold_output = prefix + "_cold.dis";
+    std::string warm_output = prefix + "_warm.dis";
+
+    write_input(input, count);
+    std::remove(cache_file.c_str());
+
+    // The pipeline narrates every cycle, keep it out of the way
+    std::streambuf* cout_buffer = std::cout.rdbuf(nullptr);
+    std::cerr.setstate(std::ios::failbit);
+
+    // Cold: lex, decode, format, then write the cache
+    auto start = std::chrono::steady_clock::now();
+
+    Lexer cold_lexer;
+    Pipeline cold_pipeline;
+    cold_lexer.set_output_file(cold_output.c_str());
+    cold_lexer.set_input_file(input.c_str(), MAPPED);
+    while (!cold_lexer.isEOF()) { cold_pipeline.addInstruction(cold_lexer.read_next_instruction()); }
+    cold_lexer.close_output();
+    cold_pipeline.comprehensiveAdvance();
+
+    double cold_time = seconds_since(start);
+
+    start = std::chrono::steady_clock::now();
+    bool written = ImageCache::write(cache_file, input, cold_pipeline.getProgram(), ProgramImage(), cold_output);
+    double write_time = seconds_since(start);
+
+    // Warm: map the cache
+    start = std::chrono::steady_clock::now();
+
+    ImageCache cache;
+    bool hit = cache.open(cache_file, input);
+
+    Lexer warm_lexer;
+    Pipeline warm_pipeline;
+    warm_lexer.set_output_file(warm_output.c_str());
+    if (hit) {
+        warm_lexer.write_output_raw(cache.getDisText(), cache.getDisSize());
+        warm_pipeline.loadProgram(cache.getDataImage());
+        warm_pipeline.attachProgram(cache.getEntries(), cache.getNumSlots(), cache.getBase(), cache.getNumInstructions());
+    }
+    warm_lexer.close_output();
+    warm_pipeline.comprehensiveAdvance();
+
+    double warm_time = seconds_since(start);
+
+    std::cout.rdbuf(cout_buffer);
+    std::cerr.clear();
+
+    bool identical = written && hit && same_file(cold_output, warm_output);
+
+    std::remove(input.c_str());
+    std::remove(cache_file.c_str());
+    std::remove(cold_output.c_str());
+    std::remove(warm_output.c_str());
+
+    if (!identical) {
+        std::cerr << "Cache " << (written ? "" : "not written, ") << (hit ? "" : "missed, ")
+                  << "dis output from the cache differs" << std::endl;
+        return 1;
+    }
+
+    std::cout << "Instructions      : " << count << "\n";
+    std::cout << "No cache          : " << cold_time << " s to first cycle\n";
+    std::cout << "Writing the cache : " << write_time << " s (once)\n";
+    std::cout << "From cache        : " << warm_time << " s to first cycle\n";
+    std::cout << "Speedup           : " << (cold_time / warm_time) << "x\n";
+
+    return 0;
+}
@@ -0,0 +1,181 @@
+#ifndef BRANCH_PREDICTOR_H
+#define BRANCH_PREDICTOR_H
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+enum PredictorKind {
+    NOT_TAKEN, // What the pipeline always did, every taken branch flushes
+    BTFN, // Backward taken, forward not taken
+    BIMODAL, // 2 bit counters by pc
+    GSHARE, // 2 bit counters by pc xor global history
+    TAGE, // Bimodal base plus tagged tables over geometric history lengths
+
+    NUM_PREDICTOR_KINDS
+};
+
+std::string predictor_kind_to_string(PredictorKind kind); // "not-taken", "btfn", ...
+bool predictor_kind_from_string(const std::string& name, PredictorKind& kind); // false if there is no such predictor
+
+struct BranchPredictorConfig {
+    PredictorKind kind = NOT_TAKEN;
+    unsigned table_bits = 12; // log2 entries of the bimodal/gshare table and the TAGE base, gshare uses as many history bits
+
+    BranchPredictorConfig() = default;
+    BranchPredictorConfig(PredictorKind kind, unsigned table_bits = 12) : kind(kind), table_bits(table_bits) {}
+};
+
+
+/**
+ * Conditional branch direction predictor, asked at fetch and trained when the branch resolves in EX
+ *
+ * The global history is updated speculatively at fetch with each prediction. Every branch keeps the
+ * history it was predicted with (getHistory before predict), which trains it later and repairs the
+ * history when a branch mispredicts or the instructions behind a jump are flushed.
+ *
+ * Tables are flat arrays sized from the config when it is set, predicting and training never allocate.
+ */
+class BranchPredictor {
+
+public:
+
+    static const unsigned MIN_TABLE_BITS = 4;
+    static const unsigned MAX_TABLE_BITS = 24;
+
+    static const std::size_t TAGE_TABLES = 4;
+    static constexpr std::array<unsigned, TAGE_TABLES> TAGE_HISTORY = {5, 12, 27, 60}; // Bits of history per tagged table
+    static const unsigned TAGE_TAG_BITS = 9;
+
+    BranchPredictor();
+
+    bool configure(BranchPredictorConfig config); // false (and unchanged) if table_bits is out of range
+    const BranchPredictorConfig& getConfig() const;
+    std::string getName() const; // ie "gshare (4096 entries)"
+
+    bool predict(uint32_t pc, uint32_t target); // Also shifts the prediction into the history
+    void update(uint32_t pc, uint64_t history, bool taken); // history as it was when pc was predicted
+
+    uint64_t getHistory() const;
+    void setHistory(uint64_t newHistory); // To repair it after a flush
+
+private:
+
+    struct TageEntry {
+        uint16_t tag = 0;
+        int8_t counter = 0; // -4..3, taken when >= 0
+        uint8_t useful = 0; // 0..3
+    };
+
+    // Where a TAGE lookup lands in every table, for a pc and a history
+    struct TageLookup {
+        std::array<uint32_t, TAGE_TABLES> index;
+        std::array<uint16_t, TAGE_TABLES> tag;
+        int provider = -1; // Longest table that hit, -1 for the base
+        int alternate = -1; // Next longest that hit, -1 for the base
+    };
+
+    uint32_t baseIndex(uint32_t pc) const { return (pc >> 2) & ((1u << config.table_bits) - 1); }
+    TageLookup tageLookup(uint32_t pc, uint64_t history) const;
+    bool tageAlternate(uint32_t pc, const TageLookup& lookup) const; // What the next longest hit (or the base) says
+    bool tagePredict(uint32_t pc, const TageLookup& lookup) const;
+    void tageUpdate(uint32_t pc, uint64_t history, bool taken);
+
+    BranchPredictorConfig config;
+    uint64_t history = 0; // Newest outcome in bit 0
+
+    std::vector<uint8_t> counters; // 2 bit, bimodal/gshare table and the TAGE base
+    std::vector<TageEntry> tagged; // TAGE_TABLES tables back to back
+    unsigned tagged_bits = 0; // log2 entries per tagged table
+    uint64_t tage_updates = 0; // The useful bits age every 2^18 updates
+
+};
+
+
+
+struct BranchTargetBufferConfig {
+    unsigned entries = 0; // 0 for none, jumps are then never predicted and branches redirect to their decoded target
+    unsigned ways = 4;
+
+    BranchTargetBufferConfig() = default;
+    BranchTargetBufferConfig(unsigned entries, unsigned ways = 4) : entries(entries), ways(ways) {}
+};
+
+/**
+ * Set-associative branch target buffer, looked up by pc in IF and filled when a taken branch or a
+ * jump resolves in EX. Tags, targets and LRU stamps are flat arrays indexed by set * ways + way
+ */
+class BranchTargetBuffer {
+
+public:
+
+    static const unsigned MAX_ENTRIES = 1u << 20;
+
+    BranchTargetBuffer() = default;
+
+    bool configure(BranchTargetBufferConfig config); // false (and unchanged) unless entries and ways are powers of 2, ways <= entries
+    const BranchTargetBufferConfig& getConfig() const;
+    bool enabled() const { return !tags.empty(); }
+    std::string getName() const; // ie "1024 entries, 4-way", "none"
+
+    bool lookup(uint32_t pc, uint32_t& target); // A hit makes the entry most recently used
+    void update(uint32_t pc, uint32_t target); // Replaces the least recently used way of the set on a miss
+
+private:
+
+    static const uint32_t VALID = 1u << 31; // Tags are the whole word address, so entries never alias
+
+    uint32_t* find(uint32_t pc); // Index of the way holding pc in tags, nullptr on a miss
+
+    BranchTargetBufferConfig config;
+    uint32_t set_mask = 0;
+
+    std::vector<uint32_t> tags; // (pc >> 2) | VALID
+    std::vector<uint32_t> targets;
+    std::vector<uint64_t> last_used; // LRU stamps
+    uint64_t clock = 0;
+
+};
+
+
+/**
+ * Return address stack, pushed at fetch by calls (JAL/JALR writing x1) and popped by RET
+ *
+ * Like the history, it changes speculatively at fetch. A checkpoint (top, size and the top entry)
+ * taken before each instruction is fetched puts it back when the instructions behind are flushed.
+ * When full, a push overwrites the oldest entry.
+ */
+class ReturnAddressStack {
+
+public:
+
+    static const unsigned MAX_DEPTH = 1024;
+
+    struct Checkpoint {
+        uint32_t top = 0;
+        uint32_t size = 0;
+        uint32_t value = 0; // Entry under top
+    };
+
+    ReturnAddressStack() = default;
+
+    bool configure(unsigned depth); // 0 for none, false (and unchanged) above MAX_DEPTH
+    unsigned getDepth() const;
+
+    void push(uint32_t address);
+    bool pop(uint32_t& address); // false when empty
+
+    Checkpoint checkpoint() const;
+    void restore(const Checkpoint& checkpoint);
+
+private:
+
+    std::vector<uint32_t> entries;
+    uint32_t top = 0; // Next entry to push into
+    uint32_t size = 0;
+
+};
+
+#endif
@@ -0,0 +1,154 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+enum ReplacementPolicy {
+    LRU, // Least recently used, by a stamp per line
+    PLRU, // Tree pseudo-LRU, ways - 1 bits per set
+    RANDOM, // Any way, from a fixed seed so runs repeat
+
+    NUM_REPLACEMENT_POLICIES
+};
+
+std::string replacement_policy_to_string(ReplacementPolicy policy); // "lru", "plru", "random"
+bool replacement_policy_from_string(const std::string& name, ReplacementPolicy& policy); // false if there is no such policy
+
+struct CacheConfig {
+    uint32_t size = 0; // Bytes, 0 for none
+    unsigned ways = 1;
+    unsigned line_size = 32; // Bytes
+    ReplacementPolicy replacement = LRU;
+    bool write_back = true; // Otherwise write-through, every store also goes to the next level
+    bool write_allocate = true; // A store that misses brings its line in, otherwise it only goes to the next level
+
+    CacheConfig() = default;
+    CacheConfig(uint32_t size, unsigned ways, unsigned line_size, ReplacementPolicy replacement = LRU)
+        : size(size), ways(ways), line_size(line_size), replacement(replacement) {}
+};
+
+// "SIZE:WAYS:LINE[:OPTION]...", SIZE in bytes or with a k or m suffix, OPTION one of lru, plru, random,
+// wb, wt, wa, nwa (ie 32k:4:64:plru:wt), false if it doesn't parse. The values are checked by configure
+bool cache_config_from_string(const std::string& spec, CacheConfig& config);
+
+struct CacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0; // Valid lines replaced
+    uint64_t writebacks = 0; // Of those, dirty ones sent to the next level
+
+    double hitRate() const { return hits + misses ? static_cast<double>(hits) / (hits + misses) : 0.0; }
+};
+
+
+/**
+ * One set-associative cache level, only tags and state (the data stays in GuestMemory)
+ *
+ * Tags, dirty bits and LRU stamps are flat arrays indexed by set * ways + way, PLRU keeps one word of
+ * tree bits per set. Everything is sized when the config is set, accesses never allocate.
+ */
+class Cache {
+
+public:
+
+    static const unsigned MAX_WAYS = 64; // The PLRU tree of a set fits a word
+    static const uint32_t MAX_SIZE = 1u << 30;
+
+    Cache() = default;
+
+    bool configure(CacheConfig config); // false (and unchanged) unless size, ways and line size are powers of 2 that make at least one set
+    const CacheConfig& getConfig() const;
+    bool enabled() const { return !tags.empty(); }
+    std::string getName() const; // ie "32 KiB, 4-way, 64 B lines, lru, write-back, write-allocate", "none"
+
+    bool access(uint32_t address, bool write); // Counts a hit or a miss, a hit becomes most recently used (and dirty if written back)
+    bool fill(uint32_t address, bool make_dirty, uint32_t& victim); // Brings the line in after a miss, true if a dirty line made room (its address in victim)
+
+    const CacheStats& getStats() const;
+
+private:
+
+    static const uint32_t VALID = 1u << 31; // Tags are the whole line address, so lines never alias
+
+    static const std::size_t NOT_FOUND = ~std::size_t(0);
+    std::size_t find(uint32_t line) const; // Index into tags of the way holding line, NOT_FOUND on a miss
+    std::size_t chooseVictim(std::size_t set); // Invalid way first, then by the policy
+    void touch(std::size_t set, unsigned way);
+
+    CacheConfig config;
+    unsigned line_bits = 0;
+    uint32_t set_mask = 0;
+
+    std::vector<uint32_t> tags; // (address >> line_bits) | VALID
+    std::vector<uint8_t> dirty;
+    std::vector<uint64_t> last_used; // LRU stamps
+    std::vector<uint64_t> tree; // PLRU bits by set, node n (1..ways - 1) points at the half to replace next
+    uint64_t clock = 0;
+    uint64_t random_state = 0;
+
+    CacheStats stats;
+
+};
+
+
+
+enum CacheLevel {
+    L1I, // Instruction fetch
+    L1D, // Loads and stores
+    L2, // Unified, behind both
+
+    NUM_CACHE_LEVELS
+};
+
+std::string cache_level_to_string(CacheLevel level); // "L1I", "L1D", "L2"
+
+struct MemoryHierarchyConfig {
+    std::array<CacheConfig, NUM_CACHE_LEVELS> levels; // None of them by default
+    unsigned l2_latency = 10; // Cycles an L1 miss that hits in L2 stalls
+    unsigned memory_latency = 100; // Cycles a miss in the last cache stalls on top of that
+
+    MemoryHierarchyConfig() = default;
+};
+
+/**
+ * L1 instruction and data caches, an optional unified L2 and memory behind them, as stall cycles
+ *
+ * An L1 hit costs nothing beyond the IF/IS and DF/DS stages the pipeline always had, and a side
+ * without an L1 keeps that fixed latency whatever else is configured. A miss stalls for the level
+ * that has the line. Writes to the next level (write-through stores, dirty lines, stores that don't
+ * allocate) go through a write buffer and never stall.
+ */
+class MemoryHierarchy {
+
+public:
+
+    static const unsigned MAX_LATENCY = 1u << 16;
+
+    MemoryHierarchy() = default;
+
+    bool configure(const MemoryHierarchyConfig& config); // false (and unchanged) if a level or a latency is bad, caches start cold
+    const MemoryHierarchyConfig& getConfig() const;
+    const Cache& getCache(CacheLevel level) const;
+    bool enabled() const; // Any level
+
+    // Stall cycles for each access, 0 on an L1 hit or without an L1 on that side
+    unsigned fetch(uint32_t address);
+    unsigned load(uint32_t address);
+    unsigned store(uint32_t address);
+
+private:
+
+    unsigned read(CacheLevel level, uint32_t address); // L1I or L1D
+    unsigned missPenalty(uint32_t address); // Where an L1 miss finds its line
+    void writeNext(uint32_t address); // Into L2 if there is one, memory otherwise
+
+    MemoryHierarchyConfig config;
+    std::array<Cache, NUM_CACHE_LEVELS> caches;
+
+};
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef DECODED_PROGRAM_H
+#define DECODED_PROGRAM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "instruction.h"
+
+
+// One word of the program, already decoded (written as is to .rvimg files, see imagecache.h)
+struct DecodedEntry {
+    Instruction instruction;
+    uint32_t address = 0;
+    uint32_t present = 0; // 0 for holes between segments (and unfilled window slots)
+};
+
+static_assert(std::is_trivially_copyable<DecodedEntry>::value, "DecodedEntry is written to and mapped from disk");
+
+
+/**
+ * Predecoded program image, fetch is an array index by (pc - base) >> 2
+ *
+ * Whole program mode (window 0) keeps every instruction added, growing to cover the lowest to
+ * highest address. Window mode (streaming) keeps only the last "window" words, each address
+ * mapping to a fixed slot that later words overwrite. An attached image reads its entries from
+ * memory owned elsewhere (ie a mapped .rvimg) and can't be added to.
+ *
+ * Display strings are formatted the first time an address is fetched and kept from then on,
+ * so loading stays cheap and each static instruction is only ever formatted once. They live in
+ * fixed size chunks that never move, so pipeline stages can hold on to them by view.
+ */
+class DecodedProgram {
+
+public:
+
+    DecodedProgram() = default;
+
+    void reset(uint32_t base, std::size_t window = 0); // Base is otherwise taken from the first add
+    void attach(const DecodedEntry* entries, std::size_t num_slots, uint32_t base, std::size_t num_instructions);
+
+    void add(const Instruction& instruction, uint32_t address);
+
+    const Instruction* fetch(uint32_t address) const; // nullptr if address holds no instruction
+    std::string_view getDisplayString(uint32_t address); // "" if address holds no instruction, valid until reset (or the slot is reused)
+
+    // The slots, base and count, for writing the image out
+    const DecodedEntry* getEntries() const;
+    std::size_t getNumSlots() const;
+    uint32_t getBase() const;
+    bool isWindowed() const;
+
+    std::size_t size() const; // Instructions added
+    std::size_t getMemoryUsage() const; // Bytes held by the entries, display references and the text pool
+
+private:
+
+    struct DisplayRef {
+        uint32_t offset = 0; // Into the text chunks, a string never straddles two
+        uint16_t length = 0;
+        bool formatted = false;
+    };
+
+    std::size_t slotOf(uint32_t address) const; // Slot index, or getNumSlots() if address holds no instruction
+    char* textAt(uint32_t offset); // Allocates the chunk on first use
+
+    std::vector<DecodedEntry> entries; // Owned slots (empty when attached)
+    const DecodedEntry* slots = nullptr; // What fetch reads: entries.data() or the attached memory
+    std::size_t num_slots = 0;
+
+    std::vector<DisplayRef> displays; // One per slot
+    std::vector<std::unique_ptr<char[]>> text_chunks; // Display strings, back to back (window mode: one fixed region per slot)
+    std::size_t text_used = 0;
+
+    uint32_t base = 0;
+    bool has_base = false;
+    std::size_t window = 0;
+    bool attached = false;
+    std::size_t num_added = 0;
+
+};
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef DISASSEMBLER_H
+#define DISASSEMBLER_H
+
+#include <cstddef>
+#include <string>
+
+#include "threadpool.h"
+
+
+/**
+ * Parallel "dis" for the ASCII bit format
+ * 
+ * The input is split into chunks at line boundaries. Words are counted per chunk first, which
+ * gives every chunk its starting position (start_position + 4 * index), then chunks are decoded
+ * and formatted on the pool and written back in order. Output is byte-identical to Lexer's.
+ */
+
+// One input file to one output file
+bool disassemble_file_parallel(const std::string& input, const std::string& output, ThreadPool& pool,
+                               int start_position = 496, std::size_t chunk_bytes = 4 << 20);
+
+// Every regular file in input_dir to a file of the same name in output_dir
+bool disassemble_directory_parallel(const std::string& input_dir, const std::string& output_dir, ThreadPool& pool,
+                                    int start_position = 496, std::size_t chunk_bytes = 4 << 20);
+
+// Picks one of the above depending on whether input is a directory
+bool disassemble_parallel(const std::string& input, const std::string& output, unsigned num_threads);
+
+#endif
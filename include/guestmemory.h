@@ -0,0 +1,136 @@
+#ifndef GUEST_MEMORY_H
+#define GUEST_MEMORY_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+// One entry of the memory map, [base, base + size)
+struct MemoryRegion {
+    std::string name;
+    uint32_t base = 0;
+    uint64_t size = 0; // Up to the whole 4 GiB
+    bool writable = true;
+
+    bool contains(uint32_t address, uint32_t bytes) const { return address >= base && address - base + uint64_t(bytes) <= size; }
+};
+
+
+/**
+ * Sparse byte-addressed guest memory over the full 32 bit address space
+ *
+ * Two-level page table (10 + 10 bits of page number, 4 KiB pages). Leaf tables and pages are
+ * only allocated when first written, pages are carved out of 2 MiB arena chunks from mmap
+ * (optionally with MADV_HUGEPAGE), so a multi-GB working set costs only what it touches.
+ * Reads of mapped memory that was never written return 0 without allocating anything.
+ *
+ * Every checked access must lie inside one region of the memory map (and a writable one for
+ * stores). Once checked, a load or store is a page table walk and a memcpy at an offset.
+ */
+class GuestMemory {
+
+public:
+
+    static const uint32_t PAGE_BITS = 12;
+    static const uint32_t PAGE_SIZE = 1u << PAGE_BITS;
+    static const uint32_t LEAF_BITS = 10; // Pages per leaf table
+    static const uint32_t ROOT_BITS = 32 - PAGE_BITS - LEAF_BITS;
+    static const std::size_t CHUNK_SIZE = std::size_t(2) << 20; // Arena chunk, one huge page
+
+    GuestMemory() = default;
+    ~GuestMemory(); // Unmaps the arena
+
+    GuestMemory(const GuestMemory&) = delete;
+    GuestMemory& operator=(const GuestMemory&) = delete;
+
+    void setHugePages(bool enabled); // Applies to chunks mapped from now on
+
+
+    // Memory map
+    bool addRegion(const std::string& name, uint32_t base, uint64_t size, bool writable = true); // false if it overlaps another
+    void clearRegions();
+    const std::vector<MemoryRegion>& getRegions() const;
+
+    bool isMapped(uint32_t address, uint32_t bytes, bool write = false) const {
+        if (last_region < regions.size() && regions[last_region].contains(address, bytes)) {
+            return !write || regions[last_region].writable;
+        }
+        return findRegion(address, bytes, write);
+    }
+
+
+    // Checked access, false (and the value untouched) if outside the memory map
+    bool read8(uint32_t address, uint8_t& value) const { return read(address, &value, 1); }
+    bool read16(uint32_t address, uint16_t& value) const { return read(address, &value, 2); }
+    bool read32(uint32_t address, uint32_t& value) const { return read(address, &value, 4); }
+    bool write8(uint32_t address, uint8_t value) { return write(address, &value, 1); }
+    bool write16(uint32_t address, uint16_t value) { return write(address, &value, 2); }
+    bool write32(uint32_t address, uint32_t value) { return write(address, &value, 4); }
+
+
+    // Unchecked, ignore the memory map (loaders, trace output)
+    void copyIn(uint32_t address, const uint8_t* bytes, std::size_t count);
+    uint32_t peek32(uint32_t address) const; // 0 where nothing was written
+
+
+    std::size_t getPagesAllocated() const;
+    std::size_t getBytesReserved() const; // Arena chunks plus leaf tables
+
+private:
+
+    using Leaf = std::array<uint8_t*, std::size_t(1) << LEAF_BITS>;
+
+    // Page holding address, nullptr if never written
+    uint8_t* findPage(uint32_t address) const {
+        const Leaf* leaf = root[address >> (PAGE_BITS + LEAF_BITS)].get();
+        return leaf ? (*leaf)[(address >> PAGE_BITS) & ((1u << LEAF_BITS) - 1)] : nullptr;
+    }
+    uint8_t* touchPage(uint32_t address); // Allocates the page (and its leaf table) on first use
+    uint8_t* allocatePage(); // From the current arena chunk, mapping a new one when it runs out
+    bool findRegion(uint32_t address, uint32_t bytes, bool write) const; // Binary search, remembers the hit
+
+    bool read(uint32_t address, void* value, uint32_t bytes) const {
+        if (!isMapped(address, bytes)) { return false; }
+        uint32_t offset = address & (PAGE_SIZE - 1);
+        if (offset + bytes > PAGE_SIZE) { return readSplit(address, value, bytes); }
+        const uint8_t* page = findPage(address);
+        if (page) { std::memcpy(value, page + offset, bytes); }
+        else { std::memset(value, 0, bytes); }
+        return true;
+    }
+
+    bool write(uint32_t address, const void* value, uint32_t bytes) {
+        if (!isMapped(address, bytes, true)) { return false; }
+        uint32_t offset = address & (PAGE_SIZE - 1);
+        if (offset + bytes > PAGE_SIZE) { return writeSplit(address, value, bytes); }
+        uint8_t* page = findPage(address);
+        if (page == nullptr) { page = touchPage(address); }
+        std::memcpy(page + offset, value, bytes);
+        return true;
+    }
+
+    // Accesses straddling two pages, byte by byte
+    bool readSplit(uint32_t address, void* value, uint32_t bytes) const;
+    bool writeSplit(uint32_t address, const void* value, uint32_t bytes);
+
+    std::array<std::unique_ptr<Leaf>, std::size_t(1) << ROOT_BITS> root;
+
+    std::vector<MemoryRegion> regions; // Sorted by base
+    mutable std::size_t last_region = 0; // Loads and stores tend to stay in one region
+
+    // Arena
+    std::vector<std::pair<uint8_t*, std::size_t>> chunks; // Mapping and its length
+    uint8_t* chunk_next = nullptr;
+    uint8_t* chunk_end = nullptr;
+    std::size_t pages_allocated = 0;
+    std::size_t leaves_allocated = 0;
+    bool huge_pages = false;
+
+};
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef IMAGE_CACHE_H
+#define IMAGE_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "decodedprogram.h"
+#include "loader.h"
+
+
+/**
+ * Serialized predecoded program (.rvimg), written once and mmap'ed read-only on later runs
+ *
+ * Layout: ImageHeader, then the DecodedEntry slots (64 byte aligned), then the data segments
+ * (address, size, bytes padded to 4), then the dis output text. The header records a content
+ * hash and size of the source file, so an edited source simply misses and is rewritten.
+ * Bump RVIMG_VERSION whenever decoding, DecodedEntry or the dis format changes.
+ */
+
+const uint32_t RVIMG_VERSION = 1;
+
+struct ImageHeader {
+    char magic[8]; // "RVIMG\0\0\0"
+    uint32_t version;
+    uint32_t entry_size; // sizeof(DecodedEntry)
+    uint32_t num_exact; // Exact instructions the ISA had when written
+    uint32_t entry_point;
+
+    uint64_t source_hash;
+    uint64_t source_size;
+
+    uint32_t base; // Address of slot 0
+    uint32_t reserved;
+    uint64_t num_slots;
+    uint64_t num_instructions;
+    uint64_t entries_offset;
+
+    uint64_t segments_offset;
+    uint64_t num_segments;
+
+    uint64_t dis_offset;
+    uint64_t dis_size;
+};
+
+
+// 64 bit content hash of a whole file (not cryptographic), false if it can't be read
+bool hash_file(const std::string& filename, uint64_t& hash, uint64_t& size);
+
+
+class ImageCache {
+
+public:
+
+    ImageCache() = default;
+    ~ImageCache(); // Unmaps
+
+    ImageCache(const ImageCache&) = delete;
+    ImageCache& operator=(const ImageCache&) = delete;
+
+    // Maps cache_file, true only if it is a valid image of source_file as it is now
+    bool open(const std::string& cache_file, const std::string& source_file);
+
+    // Writes program, the data segments of image and the contents of dis_file (atomically, via rename)
+    static bool write(const std::string& cache_file, const std::string& source_file, const DecodedProgram& program,
+                      const ProgramImage& image, const std::string& dis_file);
+
+    // Valid after a successful open
+    const DecodedEntry* getEntries() const;
+    std::size_t getNumSlots() const;
+    std::size_t getNumInstructions() const;
+    uint32_t getBase() const;
+    const char* getDisText() const;
+    std::size_t getDisSize() const;
+    ProgramImage getDataImage() const; // Entry point and data segments, copied out
+
+private:
+
+    void close();
+
+    const char* mapped = nullptr;
+    std::size_t mapped_size = 0;
+    const ImageHeader* header = nullptr;
+
+};
+
+#endif
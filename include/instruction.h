@@ -3,13 +3,17 @@
 
 // Standard library string manip
 #include <string>
+#include <string_view>
 #include <bitset> // For binary printing
 #include <iostream>
 #include <sstream>
 #include <iomanip>
 #include <vector>
 #include <unordered_map>
-#include <regex>
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <type_traits>
 
 
 
@@ -21,7 +25,7 @@ typedef uint32_t Dword;
 
 
 // ENUM FOR INSTRUCTION TYPES [BY OPCODE, NOT EXACT]
-enum INST_TYPE {
+enum INST_TYPE : uint8_t {
     BLANK = 0x0,
     JAL = 0x6F,
     JALR = 0x67,
@@ -30,142 +34,116 @@ enum INST_TYPE {
     LOAD = 0x03,
     I_TYPE = 0x13, //Immediate
     BRANCH = 0x63,
+    LUI = 0x37, // Load upper immediate
+    AUIPC = 0x17, // Add upper immediate to PC
+    MISC_MEM = 0x0F, // FENCE
+    SYSTEM = 0x73, // ECALL, EBREAK
     OTHER = 0xFF
 };
 
 enum DEPENDENCY_TYPE {
     RS1,
-    RS2
+    RS2,
+
+    NUM_DEPENDENCY_TYPES
+};
+
+typedef std::array<uint32_t, NUM_DEPENDENCY_TYPES> Dependencies; // Register numbers, indexed by DEPENDENCY_TYPE
+typedef std::array<int32_t, NUM_DEPENDENCY_TYPES> RegisterValues; // Register contents, indexed by DEPENDENCY_TYPE
+
+
+// OPERAND LAYOUTS (which fields and which immediate an instruction has)
+enum INST_FORMAT {
+    NO_FORMAT,
+    R_FORMAT, // rd, rs1, rs2
+    I_FORMAT, // rd, rs1, imm[11:0]
+    S_FORMAT, // rs1, rs2, imm[11:5|4:0]
+    B_FORMAT, // rs1, rs2, branch offset
+    J_FORMAT, // rd, jump offset
+    U_FORMAT  // rd, imm[31:12] (kept in place, the low 12 bits are 0)
 };
 
 
-// ENUM FOR EXACT INSTRUCTIONS
-enum EXACT_INSTRUCTION {
-    JAL_E,
-    J,
-    JALR_E,
-    RET,
-    SW,
-    LW,
-
-    // R-Type Instructions
-    SLT,
-    SLL,
-    SRL,
-    SUB,
-    ADD,
-    NOP,
-    AND,
-    OR,
-    XOR,
-
-    // I-Type Instructions
-    ADDI,
-    SLTI,
-
-    // Branch Instructions
-    BEQ,
-    BNE,
-    BGE,
-    BLT,
+// ENUM FOR EXACT INSTRUCTIONS (one per line of isa.def)
+enum EXACT_INSTRUCTION : uint8_t {
+#define INSTRUCTION(name, mnemonic, opcode, funct3, funct7, format) name,
+#define ALIAS(name, mnemonic, base, mask, match) name,
+#include "isa.def"
+#undef INSTRUCTION
+#undef ALIAS
 
     // Error Type
     ERROR_EXACT_INSTRUCTION,
 };
 
 // INSTRUCTION STRUCT
+/*
+* Trivially copyable and at most 32 bytes, so the copies made by the pipeline (stages, forwarding
+* records, the instruction map) are plain memcpys with no heap traffic.
+* Per-dependency state lives in fixed arrays indexed by DEPENDENCY_TYPE.
+*/
 struct Instruction {
-    Dword value;
-    INST_TYPE type;
-    EXACT_INSTRUCTION instruction;
+    Dword value = 0;
+    int32_t imm = 0; // Immediate value
 
-    Dword rs1; // Source register 1
-    Dword rs2; // Source register 2
-    Dword rd; // Destination register
-    int32_t imm; // Immediate value
+    int32_t result = 0; // Result of the computation (for pipeline)
+    int32_t mem_address_store = 0; //For instructions where you need to store an address
 
-    int32_t result; // Result of the computation (for pipeline)
-    int32_t mem_address_store; //For instructions where you need to store an address
+    RegisterValues registerValues = {}; // Values of registers, retrieved during RF stage
 
-    std::unordered_map<DEPENDENCY_TYPE, int32_t> registerValues; // Values of registers, retrieved during RF stage
+    INST_TYPE type = BLANK;
+    EXACT_INSTRUCTION instruction = ERROR_EXACT_INSTRUCTION;
 
-    std::unordered_map<DEPENDENCY_TYPE, int32_t> getRegisterValues() const { return registerValues; }
-    void setRegisterValue(DEPENDENCY_TYPE reg, int32_t newValue) { registerValues[reg] = newValue; }
+    uint8_t rs1 = 0; // Source register 1
+    uint8_t rs2 = 0; // Source register 2
+    uint8_t rd = 0; // Destination register
+
+    std::array<int8_t, NUM_DEPENDENCY_TYPES> forward_from = {-1, -1}; // How many cycles ahead to forward each dependency from, -1 for none
 
     /**
-     * Flag that the instruction needs forwarding.
+     * Flags that the instruction needs forwarding (bit 0) or forwards to another (bit 1).
      */
-    bool needsForward = false;
-    bool needsToForward = false;
-    //int numCyclesAhead = 0; // How many cycles ahead is the instruction you're forwarding from?
-    void setForwardFlag(bool newFlag) {
-        needsForward = newFlag;
-    }
-    bool getForwardFlag() const { return needsForward; }
+    uint8_t forward_flags = 0;
 
-    void setNeedsToForwardFlag(bool newFlag) { needsToForward = newFlag; }
-    bool getNeedsToForwardFlag() const { return needsToForward; }
 
-    std::unordered_map<DEPENDENCY_TYPE, int> forward_from; // Stores how many cycles ahead to forward each dependency from 
-
-    void setNumCyclesAhead(DEPENDENCY_TYPE dep, int newNumCyclesAhead) {
-        forward_from[dep] = newNumCyclesAhead;
-    }
-    
-    int getNumCyclesAhead(DEPENDENCY_TYPE dep) const { 
-        auto it = forward_from.find(dep); // Look for the key in the map
-        if (it != forward_from.end()) {
-            return it->second; // Key found, return the associated value
-        }
-        return -1; // Key not found, return -1
-    }
+    RegisterValues getRegisterValues() const { return registerValues; }
+    void setRegisterValue(DEPENDENCY_TYPE reg, int32_t newValue) { registerValues[reg] = newValue; }
 
+    void setForwardFlag(bool newFlag) { forward_flags = newFlag ? (forward_flags | 0x1) : (forward_flags & ~0x1); }
+    bool getForwardFlag() const { return forward_flags & 0x1; }
 
+    void setNeedsToForwardFlag(bool newFlag) { forward_flags = newFlag ? (forward_flags | 0x2) : (forward_flags & ~0x2); }
+    bool getNeedsToForwardFlag() const { return forward_flags & 0x2; }
 
-    
+    void setNumCyclesAhead(DEPENDENCY_TYPE dep, int newNumCyclesAhead) { forward_from[dep] = static_cast<int8_t>(newNumCyclesAhead); }
+    int getNumCyclesAhead(DEPENDENCY_TYPE dep) const { return forward_from[dep]; }
 
-        
-    std::unordered_map<DEPENDENCY_TYPE, uint32_t> getDependencies() const {
 
-        std::unordered_map<DEPENDENCY_TYPE, uint32_t> dependencies;
+    Dependencies getDependencies() const {
 
         switch (type) {
             case JALR: // JALR uses rs1
-                dependencies[RS1] = rs1;
-                break;
-
             case LOAD: // LW uses rs1 for address calculation
-                dependencies[RS1] = rs1;
-                break;
+            case I_TYPE: // I-Type instructions use rs1
+                return {rs1, 0};
 
-            case STORE: // SW uses rs1 for address and rs2 for value
-                dependencies[RS1] = rs1;
-                dependencies[RS2] = rs2;
-                break;
+            case LUI: // No register sources
+            case AUIPC:
+            case MISC_MEM:
+            case SYSTEM:
+                return {0, 0};
 
-            case I_TYPE: // I-Type instructions use rs1
-                dependencies[RS1] = rs1;
-                break;
-
-            case IRR: // R-Type instructions (e.g., ADD, SUB) use rs1 and rs2
-            case BRANCH: // Branch instructions use rs1 and rs2
-                dependencies[RS1] = rs1;
-                dependencies[RS2] = rs2;
-                break;
-
-            default: // Default case handles other instructions with rs1 and rs2
-                dependencies[RS1] = rs1;
-                dependencies[RS2] = rs2;
-                break;
+            // STORE (address and value), IRR, BRANCH and anything else use rs1 and rs2
+            default:
+                return {rs1, rs2};
         }
 
-        return dependencies;
     }
 
     uint32_t getDestination() const {
 
-        if (type == STORE || type == BRANCH || type == BLANK || type == OTHER) {
-            std::cerr << "Error: Instruction of type " << type << " should not have a destination." << std::endl;
+        if (type == STORE || type == BRANCH || type == MISC_MEM || type == SYSTEM || type == BLANK || type == OTHER) {
+            std::cerr << "Error: Instruction of type " << static_cast<int>(type) << " should not have a destination." << std::endl;
             return static_cast<uint32_t>(-1); // Return a sentinel value indicating no destination
         }
 
@@ -186,13 +164,15 @@ struct Instruction {
     uint32_t getMemAddress() const { return mem_address_store; }
     void setMemAddress(uint32_t newAddress) { mem_address_store = newAddress; }
 
-    
-
 };
 
+static_assert(std::is_trivially_copyable<Instruction>::value, "Instruction is copied around the pipeline by value");
+static_assert(sizeof(Instruction) <= 32, "Instruction should stay within 32 bytes");
+
 
 // TO STRING FUNCTIONS
 std::string exact_instruction_to_string(EXACT_INSTRUCTION instruction);
+std::string_view exact_instruction_name(EXACT_INSTRUCTION instruction); // Same, without allocating
 std::string itype_to_string(INST_TYPE instructionType);
 
 
@@ -212,26 +192,56 @@ int32_t get_jal_imm(Dword instruction);
 int32_t get_s_type_imm(Dword instruction);
 int32_t get_b_type_imm(Dword instruction); // MADE CORRECTIONS -> WRITE TESTS TO CHECK
 int32_t get_jalr_imm(Dword instruction);
+int32_t get_u_type_imm(Dword instruction);
+int32_t get_shift_amount(const Instruction& inst); // SLLI/SRLI/SRAI, imm[4:0]
+bool is_shift_immediate(EXACT_INSTRUCTION instruction); // SLLI, SRLI, SRAI
+
+
+// DECODING (table driven, see isa.def)
+Instruction decode_instruction(Dword value); // Opcode, exact instruction and fields in one step
+INST_FORMAT get_instruction_format(EXACT_INSTRUCTION instruction);
+
+
+// BATCH DECODING (structure of arrays)
+/*
+* One entry per word, each field in its own array. Fields a format doesn't have are 0,
+* exactly as decode_instruction leaves them.
+*/
+struct DecodedBatch {
+    std::vector<Dword> value;
+    std::vector<uint8_t> opcode;
+    std::vector<uint8_t> rd;
+    std::vector<uint8_t> rs1;
+    std::vector<uint8_t> rs2;
+    std::vector<int32_t> imm;
+    std::vector<uint8_t> exact;
+
+    std::size_t size() const { return value.size(); }
+    void resize(std::size_t count);
+
+    Instruction getInstruction(std::size_t index) const; // Same as decode_instruction(value[index])
+};
 
+void decode_batch(const Dword* words, std::size_t count, DecodedBatch& batch); // AVX2 when compiled for it
+void decode_batch_scalar(const Dword* words, std::size_t count, DecodedBatch& batch);
 
-// GET EXACT INSTRUCTIONS
-EXACT_INSTRUCTION decompose_IRR(Dword instruction);
-EXACT_INSTRUCTION decompose_JALR(Dword instruction);
-EXACT_INSTRUCTION decompose_I_TYPE(Dword instruction);
-EXACT_INSTRUCTION decompose_BRANCH(Dword instruction);
-EXACT_INSTRUCTION decompose_JAL_J(Dword instruction);
-EXACT_INSTRUCTION decompose_types(Dword instruction, INST_TYPE type);
 
+// INSTRUCTION -> CHAR BUFFER, AS IN EXAMPLE
+// Write into a caller provided buffer of MAX_FORMATTED_LENGTH, return the length (no '\0', no '\n'), never allocate
+const std::size_t MAX_FORMATTED_LENGTH = 128; // The longest line is under 100, leaving room to append a '\n'
 
-// POPULATE VALUES FOR YOUR INSTRUCTION
-Instruction get_populated_instruction(Dword instruction, INST_TYPE type);
+std::size_t format_instruction(const Instruction& inst, int position, bool isBlank, char* buffer);
+std::size_t format_special_case(const Instruction& inst, EXACT_INSTRUCTION type, int position, char* buffer);
+std::size_t format_disassembly(const Instruction& inst, int position, char* buffer); // One dis line, picks between the two above
+std::size_t format_new_style(const Instruction& inst, char* buffer); // Pipeline trace form, ie "ADDI  R1, R0, #8"
 
 
-// INSTRUCTION -> STRING, AS IN EXAMPLE
+// INSTRUCTION -> STRING, AS IN EXAMPLE (wrappers around the above)
 std::string register_to_string(Byte reg);
 std::string to_binary_string(Dword value, int bits);
 std::string instruction_to_string(Instruction inst, int position, bool isBlank);
 std::string handle_special_case(Instruction inst, EXACT_INSTRUCTION type, int position);
+std::string disassemble_instruction(Instruction inst, int position); // Picks between the two above
 std::string instruction_to_new_style_string(Instruction inst);
 
 #endif
\ No newline at end of file
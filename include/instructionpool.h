@@ -0,0 +1,51 @@
+#ifndef INSTRUCTION_POOL_H
+#define INSTRUCTION_POOL_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "instruction.h"
+
+
+// Handle to an instruction in an InstructionPool
+using InstructionSlot = uint8_t;
+
+
+/**
+ * Fixed set of in-flight instructions, preallocated with the pipeline
+ *
+ * A fetched instruction is copied into a free slot and the stages pass the handle along,
+ * so nothing is allocated or freed while the pipeline runs. Every stage holds at most one
+ * instruction, so CAPACITY slots can never run out. NO_SLOT (an empty stage) resolves to a
+ * blank instruction that is never handed out, so a stray read of an empty stage stays in bounds.
+ */
+class InstructionPool {
+
+public:
+
+    static const std::size_t CAPACITY = 8; // One per stage
+
+    InstructionPool();
+
+    InstructionSlot acquire(const Instruction& instruction, uint32_t address = 0); // NO_SLOT if every slot is in use, address is where it was fetched from
+    void release(InstructionSlot slot);
+
+    Instruction& get(InstructionSlot slot) { return slots[slot]; }
+    const Instruction& get(InstructionSlot slot) const { return slots[slot]; }
+    uint32_t getAddress(InstructionSlot slot) const { return addresses[slot]; } // AUIPC needs its own pc
+
+    std::size_t inUse() const;
+
+private:
+
+    std::array<Instruction, CAPACITY + 1> slots; // The last one is NO_SLOT's
+    std::array<uint32_t, CAPACITY + 1> addresses = {}; // Fetch address of each slot's instruction
+    std::array<InstructionSlot, CAPACITY> free_slots; // Stack, the top free_count are free
+    std::size_t free_count = 0;
+
+};
+
+const InstructionSlot NO_SLOT = InstructionPool::CAPACITY;
+
+#endif
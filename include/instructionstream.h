@@ -0,0 +1,63 @@
+#ifndef INSTRUCTION_STREAM_H
+#define INSTRUCTION_STREAM_H
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include "instruction.h"
+
+
+// A decoded instruction and the address it was decoded for
+struct StreamedInstruction {
+    uint32_t address = 0;
+    Instruction instruction;
+};
+
+
+/**
+ * Bounded single-producer/single-consumer ring between a lexer thread and the pipeline
+ * 
+ * The producer runs on its own thread (see start) and blocks while the ring is full,
+ * the consumer pops on demand. Only head/tail are shared, so no locks are needed.
+ */
+class InstructionStream {
+
+public:
+
+    explicit InstructionStream(std::size_t capacity = 1024); // Rounded up to a power of two
+    ~InstructionStream();
+
+    InstructionStream(const InstructionStream&) = delete;
+    InstructionStream& operator=(const InstructionStream&) = delete;
+
+    // Runs producer on a new thread, the stream is finished once it returns
+    void start(std::function<void(InstructionStream&)> producer);
+
+    // Producer side
+    void push(StreamedInstruction item); // Waits while the ring is full
+
+    // Consumer side
+    bool tryPop(StreamedInstruction& item); // false if nothing is ready yet
+    bool pop(StreamedInstruction& item); // Waits for an item, false once finished and empty
+    bool isFinished() const;
+    void drain(); // Discards whatever is left and joins the producer
+
+    std::size_t getCapacity() const;
+
+private:
+
+    std::vector<StreamedInstruction> buffer;
+    std::size_t mask;
+
+    alignas(64) std::atomic<std::size_t> head{0}; // Next slot to read (consumer owned)
+    alignas(64) std::atomic<std::size_t> tail{0}; // Next slot to write (producer owned)
+    alignas(64) std::atomic<bool> finished{false};
+
+    std::thread producer_thread;
+
+};
+
+#endif
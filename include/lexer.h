@@ -6,31 +6,57 @@
 #include <bitset>
 #include <string>
 #include <instruction.h>
+#include <outputsink.h>
+
+
+// How the lexer reads its input file
+enum InputMode {
+    STREAMED, // Character by character through an ifstream
+    MAPPED    // Whole file mmap'ed read-only, scanned in place
+};
+
+
+// Converts 32 ASCII '0'/'1' characters (MSB first) into a Dword
+Dword ascii_bits_to_dword(const char* bits);
+Dword ascii_bits_to_dword_scalar(const char* bits);
 
 
 class Lexer {
 
 public:
 
+    ~Lexer();
+
     // Utility functions
-    void set_input_file(const char* filename);
-    void set_output_file(const char* filename);
-    void write_output(std::string output);
+    void set_input_file(const char* filename, InputMode mode = STREAMED);
+    void set_output_file(const char* filename, bool background = false, bool direct = false);
+    void write_output(const std::string& output);
+    void write_output_raw(const char* data, std::size_t length); // No newline added
+    void close_output(); // Flushes buffered output, call once all output is written
     bool isEOF(); 
 
     // Reading instructions
     Dword consume_instruction(); // Main logic for reading an instruction through (handles reader aspect)
-    void reset_instruction(); // Resets the "curr instruction" class variable
     Instruction read_next_instruction(); // Uses the opcode generated by consume_instruction to read over the instruction and create the curr_instruction variable
 
     
 
     std::size_t getFileSize() const;
+    InputMode getInputMode() const;
 
 private:
 
+    // Mapped input helpers
+    bool map_input_file(const char* filename);
+    void unmap_input_file();
+    Dword consume_mapped_instruction();
+
     std::ifstream inputFile;
-    std::ofstream outputFile;
+    OutputSink outputFile;
+
+    InputMode inputMode = STREAMED;
+    const char* mappedData = nullptr; // Start of the mmap'ed file (MAPPED only)
+    bool mappedEOF = false;
 
     std::size_t fileSize; //Byte size of file
     std::size_t bitsConsumed = 0;
@@ -44,4 +70,4 @@ private:
 
 
 
-#endif
\ No newline at end of file
+#endif
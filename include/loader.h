@@ -0,0 +1,42 @@
+#ifndef LOADER_H
+#define LOADER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "instruction.h"
+
+
+// Input formats the simulator can load
+enum ProgramFormat {
+    TEXT_BITS,  // One ASCII '0'/'1' per bit (test/*.txt), handled by Lexer
+    RAW_BINARY, // Flat little-endian image of 32-bit words
+    ELF32       // ELF32 RISC-V executable
+};
+
+// One contiguous chunk of guest memory taken from the input file
+struct LoadedSegment {
+    uint32_t address = 0;
+    std::vector<uint8_t> bytes; // Already zero-filled up to the in-memory size (.bss)
+    bool executable = false;
+};
+
+// Everything a loader pulls out of a file
+struct ProgramImage {
+    uint32_t entry_point = 496;
+    std::vector<LoadedSegment> segments;
+};
+
+
+// Format detection (ELF magic first, then the .bin extension)
+ProgramFormat detect_program_format(const std::string& filename);
+
+// Loaders, both return false (and print why) if the file cannot be used
+bool load_raw_binary(const std::string& filename, uint32_t base_address, ProgramImage& image);
+bool load_elf32(const std::string& filename, ProgramImage& image);
+
+// Little-endian instruction words of an executable segment
+std::vector<Dword> segment_words(const LoadedSegment& segment);
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <iostream>
+
+
+/**
+ * Diagnostics with the level fixed at compile time
+ *
+ * RISCVSIM_LOG_LEVEL (set from CMake, WARN by default) is the most verbose level built in. A
+ * message above it is an `if constexpr (false)`, so neither it nor its arguments cost anything.
+ * Everything goes to stderr, stdout is left to the simulator's own output.
+ *
+ *   LOG_DEBUG("Forwarded " << value << " from " << stage);
+ */
+
+#define RISCVSIM_LOG_NONE 0
+#define RISCVSIM_LOG_ERROR 1 // Something is wrong with the program or the simulator
+#define RISCVSIM_LOG_WARN 2 // Suspicious, but the simulation carries on
+#define RISCVSIM_LOG_INFO 3 // Once per run
+#define RISCVSIM_LOG_DEBUG 4 // Per cycle narration
+
+#ifndef RISCVSIM_LOG_LEVEL
+#define RISCVSIM_LOG_LEVEL RISCVSIM_LOG_WARN
+#endif
+
+#define RISCVSIM_LOG(level, message) \
+    do { if constexpr (RISCVSIM_LOG_LEVEL >= (level)) { std::cerr << message << "\n"; } } while (0)
+
+#define LOG_ERROR(message) RISCVSIM_LOG(RISCVSIM_LOG_ERROR, message)
+#define LOG_WARN(message) RISCVSIM_LOG(RISCVSIM_LOG_WARN, message)
+#define LOG_INFO(message) RISCVSIM_LOG(RISCVSIM_LOG_INFO, message)
+#define LOG_DEBUG(message) RISCVSIM_LOG(RISCVSIM_LOG_DEBUG, message)
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef OUTPUT_SINK_H
+#define OUTPUT_SINK_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+/**
+ * Buffered file writer for disassembly output
+ * 
+ * Text is copied into a large reusable block that is only written out when full (or on flush/close).
+ * Optionally full blocks are handed to a background writer thread that batches them into one writev,
+ * and the file can be opened with O_DIRECT to bypass the page cache.
+ */
+class OutputSink {
+
+public:
+
+    explicit OutputSink(std::size_t block_size = 1 << 20); // Rounded up to a multiple of 4 KiB
+    ~OutputSink();
+
+    OutputSink(const OutputSink&) = delete;
+    OutputSink& operator=(const OutputSink&) = delete;
+
+    bool open(const char* filename, bool background = false, bool direct = false);
+    bool isOpen() const;
+
+    void write(const char* data, std::size_t length);
+    void writeLine(const std::string& line); // Appends '\n'
+
+    void flush(); // Everything written so far reaches the file
+    void close();
+
+private:
+
+    struct Block {
+        char* data = nullptr;
+        std::size_t used = 0;
+    };
+
+    char* acquireBlock(); // Reuses a free block, allocating only if none are free
+    void submitCurrent(); // Writes (or queues) the current block and starts a new one
+    void writeBlocks(std::vector<Block>& blocks); // One writev for all of them
+    bool writeAll(const char* data, std::size_t length);
+    void writerLoop();
+
+    int fd = -1;
+    std::size_t block_size;
+    bool background = false;
+    bool direct = false;
+
+    Block current;
+    std::vector<char*> free_blocks;
+
+    // Background writer state
+    std::vector<Block> queued;
+    std::mutex mutex;
+    std::condition_variable work_ready;
+    std::condition_variable work_done;
+    bool writer_busy = false;
+    bool stopping = false;
+    std::thread writer;
+
+};
+
+#endif
@@ -1,6 +1,7 @@
 #ifndef PIPELINE_H
 #define PIPELINE_H
 
+#include <array>
 #include <vector> 
 #include <unordered_map>
 #include <iostream>
@@ -11,6 +12,13 @@
 
 #include "instruction.h"
 #include "pipelinestage.h"
+#include "loader.h"
+#include "instructionstream.h"
+#include "decodedprogram.h"
+#include "guestmemory.h"
+#include "branchpredictor.h"
+#include "cache.h"
+#include "log.h"
 
 struct PipelineRegisters {
 
@@ -36,195 +44,284 @@ struct PipelineRegisters {
 
 };
 
-struct Flags {
+struct alignas(64) IntegerRegisterFile {
+    /**
+     * x0..x31 back to back, 128 bytes starting on a cache line
+     * x0 is hard-wired to zero (writes to it are dropped) and the caller checks register numbers
+     */
 
-    bool isRAWStalled = false; //Means that the instruction in ID stage is stalled
-    int RAWstallsRemaining = 0;
+    std::array<int32_t, 32> values = {};
+    uint32_t dirty = 0; // Bit n set once xn changes, until clearDirty
 
-    bool isBranchStalled = false;
-    int branchStallsRemaining = 0;
+    int32_t read(uint32_t reg) const { return values[reg]; }
+
+    void write(uint32_t reg, int32_t value) {
+        if (reg == 0) { return; }
+        dirty |= static_cast<uint32_t>(values[reg] != value) << reg;
+        values[reg] = value;
+    }
 
-    StageType stopStage = NONE; // Stage to stop at
+    void clearDirty() { dirty = 0; }
 
-    Flags() = default;
+    IntegerRegisterFile() = default;
 
 };
 
-struct Stats {
+// What an instruction executes on, an instruction waits in RF while its unit is busy
+enum FunctionalUnit {
+    ALU, // Integer ops, upper immediates, FENCE and ECALL/EBREAK
+    MEMORY_UNIT, // Loads and stores (address in EX, memory in DF/DS)
+    BRANCH_UNIT, // Branches and jumps
+    MULTIPLIER, // MUL, MULH, MULHSU, MULHU
+    DIVIDER, // DIV, DIVU, REM, REMU
 
-    // Total stalls
-    int total_loads = 0;
-    int total_branches = 0;
-    int other = 0;
+    NUM_FUNCTIONAL_UNITS
+};
 
-    std::unordered_map<std::string, int> num_forwards = {
-        {"EX/DF -> RF/EX", 0},
-        {"DF/DS -> EX/DF", 0},
-        {"DF/DS -> RF/EX", 0},
-        {"DS/WB -> EX/DF", 0},
-        {"DS/WB -> RF/EX", 0}
-    };
+struct FunctionalUnitTiming {
+    int latency = 1; // Cycles from entering EX until the result can be forwarded
+    int interval = 1; // Cycles from entering EX until the unit takes the next instruction
 
-    Stats() = default;
+    FunctionalUnitTiming() = default;
+    FunctionalUnitTiming(int latency, int interval) : latency(latency), interval(interval) {}
+};
 
-    std::string toString() const {
-        std::ostringstream output;
+// One line of timing.def
+struct InstructionTiming {
+    FunctionalUnit unit = ALU;
+    StageType result_stage = NONE; // First stage holding the result, NONE if it writes no register through WB
+    uint8_t latency = 1; // Cycles from entering EX until a dependent can enter EX
+    uint8_t interval = 1; // Cycles from entering EX until the unit takes the next instruction
+    StageType data_stage = EX; // Stage rs2 is first needed in
+    uint8_t redirect_stalls = 0; // Cycles fetch shows as stalled after it redirects the pc
+};
 
-        // Total Stalls
-        output << "Total Stalls:\n";
-        output << "* Loads\t\t: " << total_loads << "\n";
-        output << "* Branches\t: " << total_branches << "\n";
-        output << "* Other\t\t: " << other << "\n";
+const std::size_t NUM_EXACT_INSTRUCTIONS = ERROR_EXACT_INSTRUCTION + 1;
 
-        output << "\nTotal Forwardings:\n";
-        for (const auto& forwarding : num_forwards) {
-            output << "* " << forwarding.first << " : " << forwarding.second << "\n";
-        }
+typedef std::array<InstructionTiming, NUM_EXACT_INSTRUCTIONS> InstructionTimingTable; // Indexed by EXACT_INSTRUCTION
 
-        return output.str();
+const InstructionTimingTable& default_instruction_timing(); // As timing.def gives it
+
+struct Scoreboard {
+    /**
+     * Registers with a write in flight, kept as instructions enter and leave RF..WB
+     * writers[r] has bit s set while the instruction in stage s writes xr (never x0), so the
+     * nearest producer ahead of a stage is the lowest set bit above it
+     */
+
+    uint32_t pending = 0; // Bit r set while writers[r] != 0
+    std::array<uint8_t, 32> writers = {};
+    std::array<uint8_t, NUM_STAGES> writes = {}; // Register the instruction in each stage writes, 0 for none
+    std::array<uint64_t, 32> ready_cycle = {}; // First cycle the last result executed for xr can be used in EX
+    std::array<uint64_t, NUM_FUNCTIONAL_UNITS> unit_free_cycle = {}; // First cycle each unit takes another instruction in EX
+    uint64_t cycle = 0; // What those count, cycles the back end moved (it stands still while DF waits on a cache miss)
+
+    void enter(StageType stage, uint32_t reg) {
+        writes[stage] = static_cast<uint8_t>(reg);
+        if (reg == 0) { return; }
+        writers[reg] |= static_cast<uint8_t>(1u << stage);
+        pending |= 1u << reg;
     }
 
-    void recordForwarding(std::string forward_type) {
+    void move(StageType from, StageType to) {
+        uint32_t reg = writes[from];
+        writes[to] = static_cast<uint8_t>(reg);
+        writes[from] = 0;
+        if (reg != 0) { writers[reg] = static_cast<uint8_t>((writers[reg] & ~(1u << from)) | (1u << to)); }
+    }
 
-        auto it = num_forwards.find(forward_type);
-        if (it != num_forwards.end()) {
-            // If the entry exists, increment its value
-            it->second++;
-        } else {
-            // If the entry does not exist, return
-            return;
-        }
+    void leave(StageType stage) {
+        uint32_t reg = writes[stage];
+        writes[stage] = 0;
+        if (reg == 0) { return; }
+        writers[reg] &= static_cast<uint8_t>(~(1u << stage));
+        if (writers[reg] == 0) { pending &= ~(1u << reg); }
+    }
 
+    // Nearest stage after "stage" holding a writer of reg, NONE if there is none
+    StageType producerAfter(uint32_t reg, StageType stage) const {
+        uint32_t ahead = writers[reg] & ~((2u << stage) - 1);
+        return ahead ? static_cast<StageType>(__builtin_ctz(ahead)) : NONE;
     }
 
+    Scoreboard() = default;
 
 };
 
-struct Forwarding {
-    /**
-     * For keeping track of forwarding paths
-     */
+struct Flags {
 
-    bool detected = false;
-    void setDetected(bool newDetected) {
-        detected = newDetected;
-    }
-    bool getDetected() const {
-        return detected;
-    }
-    std::unordered_map<std::string, std::string> paths_output = {
-        {"EX/DF -> RF/EX", "(none)"},
-        {"DF/DS -> EX/DF", "(none)"},
-        {"DF/DS -> RF/EX", "(none)"},
-        {"DS/WB -> EX/DF", "(none)"},
-        {"DS/WB -> RF/EX", "(none)"}
-    };
+    bool isBranchStalled = false;
+    int branchStallsRemaining = 0;
 
-    void resetPathsOutput() {
-        paths_output = {
-            {"EX/DF -> RF/EX", "(none)"},
-            {"DF/DS -> EX/DF", "(none)"},
-            {"DF/DS -> RF/EX", "(none)"},
-            {"DS/WB -> EX/DF", "(none)"},
-            {"DS/WB -> RF/EX", "(none)"}
-        };
-        pending_forwards = {};
-        detected = false;
-    }
+    StageType heldStage = NONE; // This cycle, it and every stage before it are held (RF for a result that isn't ready or a busy unit, IF or DF for a cache miss)
 
-    std::unordered_map<StageType, StageType> paths;
+    uint64_t fetchReadyCycle = 0; // IF keeps its instruction until this cycle (instruction cache miss)
+    uint64_t dataReadyCycle = 0; // DF keeps its load or store until this cycle (data cache miss)
 
-    std::vector<std::pair<Instruction, Instruction>> pending_forwards;
+    bool halted = false; // ECALL/EBREAK executed, nothing more is fetched
 
-    // and when to actually complete them
+    Flags() = default;
 
+};
 
-    // Convert to string for output with fixed order
-    std::string toString() const {
-        std::ostringstream output;
+// FORWARDING PATHS
+/*
+* A path is a (from, to) pair of stages: the result held by the instruction in "from" goes to the
+* instruction in "to". Results are used in EX (and store data in DF), so only DF..WB forward and only
+* into EX or DF. A path is indexed by forward_path(from, to) wherever it is counted.
+*/
+const std::size_t NUM_FORWARD_PATHS = NUM_STAGES * NUM_STAGES;
+
+inline std::size_t forward_path(StageType from, StageType to) { return from * NUM_STAGES + to; }
+
+inline bool forward_path_exists(StageType from, StageType to) {
+    return (to == EX || to == DF) && from > to && from <= WB;
+}
+
+std::string forward_path_name(StageType from, StageType to); // By pipeline registers, ie "EX/DF -> RF/EX" for DF to EX
+
+struct BypassNetwork {
+    /**
+     * Which forwarding paths are wired, enabled[from] has bit "to" set if the path is on
+     * Every path that exists is on by default, with one turned off its consumers wait for a later path
+     * or for the register file
+     */
+
+    std::array<uint8_t, NUM_STAGES> enabled = {};
+
+    bool allows(StageType from, StageType to) const { return from < NUM_STAGES && ((enabled[from] >> to) & 1u); }
 
-        output << "Forwarding:\n";
-
-        if (pending_forwards.empty()) {
-            output << " Detected: (none)\n";
-        } else {
-            output << " Detected:\n";
-            for (size_t i = 0; i < pending_forwards.size(); ++i) {
-                const auto& [from, to] = pending_forwards[i];
-                output << "  [" << i << "] "
-                    << "(" << instruction_to_new_style_string(from) << ") to ("
-                    << instruction_to_new_style_string(to) << ")\n";
+    void set(StageType from, StageType to, bool on) {
+        if (on) { enabled[from] |= static_cast<uint8_t>(1u << to); }
+        else { enabled[from] &= static_cast<uint8_t>(~(1u << to)); }
+    }
+
+    BypassNetwork() {
+        for (int from = EX; from <= WB; from++) {
+            for (int to = EX; to <= WB; to++) {
+                if (forward_path_exists(StageType(from), StageType(to))) { set(StageType(from), StageType(to), true); }
             }
         }
+    }
 
-        // Fixed order of paths
-        output << " Forwarded:\n";
-        output << " * EX/DF -> RF/EX : " << paths_output.at("EX/DF -> RF/EX") << "\n";
-        output << " * DF/DS -> EX/DF : " << paths_output.at("DF/DS -> EX/DF") << "\n";
-        output << " * DF/DS -> RF/EX : " << paths_output.at("DF/DS -> RF/EX") << "\n";
-        output << " * DS/WB -> EX/DF : " << paths_output.at("DS/WB -> EX/DF") << "\n";
-        output << " * DS/WB -> RF/EX : " << paths_output.at("DS/WB -> RF/EX") << "\n";
+};
 
-        return output.str();
-    }
+struct Stats {
 
+    uint64_t instructions_retired = 0; // Reached WB
 
+    // Total stalls
+    int total_loads = 0;
+    int total_branches = 0;
+    int other = 0;
+    int structural = 0; // The unit an instruction needs was still busy
+    int raw_multi_cycle = 0; // Waiting on a result other than a load's (multiply/divide, or a retimed instruction)
+    int bypass = 0; // The result was there, but no enabled path could bring it
+    int instruction_cache = 0; // IF waiting on an instruction cache miss
+    int data_cache = 0; // DF waiting on a data cache miss
 
-    void addForward(Instruction from, Instruction to, int cycles_till_execution) {
+    std::array<int, NUM_FORWARD_PATHS> forwards = {}; // By forward_path(from, to)
 
-        pending_forwards.emplace_back(from, to);
+    // Conditional branches, predicted at fetch and resolved in EX
+    uint64_t branches = 0;
+    uint64_t mispredictions = 0; // Wrong direction, each one flushes IF..RF
 
-        // FIX FIX ?NOTE NOTE
-        
+    // Jumps (JAL, JALR, RET) and taken branches whose target fetch didn't have (or had wrong), from the BTB or RAS
+    uint64_t jumps = 0;
+    uint64_t target_mispredictions = 0;
 
-    }
+    // Hits, misses and evictions by CacheLevel, copied from the caches by Pipeline::getResult
+    std::array<CacheStats, NUM_CACHE_LEVELS> caches = {};
 
-    void completeForward(StageType from, StageType to, Instruction from_inst, Instruction to_inst, Stats* stats) {
-        paths[from] = to;
+    Stats() = default;
 
-        std::string updated_output = "(" + instruction_to_new_style_string(from_inst) + ") to ( " + instruction_to_new_style_string(to_inst) + ")";
+    double predictionAccuracy() const { return branches ? 1.0 - static_cast<double>(mispredictions) / branches : 1.0; }
+    double mispredictionsPerKilo() const { return instructions_retired ? 1000.0 * mispredictions / instructions_retired : 0.0; } // MPKI
 
-        if (from == DF && to == EX) {
-            paths_output["EX/DF -> RF/EX"] = updated_output;
-            stats->recordForwarding("EX/DF -> RF/EX");
-        }
+    std::string toString() const {
+        std::ostringstream output;
 
-        else if (from == DS && to == DF) {
-            paths_output["DF/DS -> EX/DF"] = updated_output;
-            stats->recordForwarding("DF/DS -> EX/DF");
-        }
+        // Total Stalls
+        output << "Total Stalls:\n";
+        output << "* Loads\t\t: " << total_loads << "\n";
+        output << "* Branches\t: " << total_branches << "\n";
+        output << "* Other\t\t: " << other << "\n";
 
-        else if (from == DS && to == EX) {
-            paths_output["DF/DS -> RF/EX"] = updated_output;
-            stats->recordForwarding("DF/DS -> RF/EX");
+        // Only once a multiply/divide has stalled, programs without one keep the usual output
+        if (structural != 0 || raw_multi_cycle != 0) {
+            output << "* Structural\t: " << structural << "\n";
+            output << "* RAW (mul/div)\t: " << raw_multi_cycle << "\n";
         }
+        if (bypass != 0) { output << "* No bypass\t: " << bypass << "\n"; }
+        if (instruction_cache != 0) { output << "* I-cache miss\t: " << instruction_cache << "\n"; }
+        if (data_cache != 0) { output << "* D-cache miss\t: " << data_cache << "\n"; }
 
-        else if (from == WB && to == DF) { 
-            paths_output["DS/WB -> EX/DF"] = updated_output;
-            stats->recordForwarding("DS/WB -> EX/DF");
+        // Furthest producer first
+        output << "\nTotal Forwardings:\n";
+        for (int from = WB; from > EX; from--) {
+            for (int to = EX; to < from; to++) {
+                if (!forward_path_exists(StageType(from), StageType(to))) { continue; }
+                output << "* " << forward_path_name(StageType(from), StageType(to)) << " : "
+                       << forwards[forward_path(StageType(from), StageType(to))] << "\n";
+            }
         }
 
-        else if (from == WB && to == EX) {
-            paths_output["DS/WB -> RF/EX"] = updated_output;
-            stats->recordForwarding("DS/WB -> RF/EX");
-        }
+        return output.str();
+    }
 
-        else {
-            std::cerr << "Should not be a forward here. Please check." << std::endl;
-            return;
-        }
+};
 
+struct Forwarding {
+    /**
+     * This cycle's forwards for the trace, kept as stages
+     * The instructions are still in those stages when the cycle is printed, so nothing is copied
+     * or formatted until then (see Pipeline::getForwardingOutput)
+     */
 
+    std::array<std::pair<StageType, StageType>, NUM_DEPENDENCY_TYPES> detected; // (from, to) found by ID
+    std::size_t num_detected = 0;
 
+    uint64_t completed = 0; // Bit forward_path(from, to) set once that path forwarded
 
-        return;
+    void resetPathsOutput() {
+        num_detected = 0;
+        completed = 0;
     }
 
+    void addForward(StageType from, StageType to) {
+        if (num_detected < detected.size()) { detected[num_detected++] = {from, to}; }
+    }
+
+    void completeForward(StageType from, StageType to, Stats* stats) {
+        completed |= uint64_t(1) << forward_path(from, to);
+        stats->forwards[forward_path(from, to)]++;
+    }
 
     Forwarding() = default;
 
 };
 
+// Where a run stands (RUNNING while it can still be stepped)
+enum RunStatus {
+    RUNNING,
+    FINISHED, // Every stage drained and nothing left to fetch
+    CYCLE_LIMIT, // Only in a RunResult: run() hit maxCycles, stepping can carry on
+    MEMORY_FAULT, // Load from an address outside data memory
+    REGISTER_FAULT // Register number past x31
+};
+
+std::string run_status_to_string(RunStatus status);
+
+uint32_t memory_access_bytes(EXACT_INSTRUCTION instruction); // 1, 2 or 4 for a load or store
+
+struct RunResult {
+    RunStatus status = RUNNING;
+    uint64_t cycles = 0;
+    uint64_t instructions_retired = 0;
+    Stats stats;
+    std::string message; // What went wrong (faults only)
+};
+
 class Pipeline {
 
 public:
@@ -232,9 +329,21 @@ public:
     // Constructors
     Pipeline();
 
+    // Stages point into this pipeline's instruction pool
+    Pipeline(const Pipeline&) = delete;
+    Pipeline& operator=(const Pipeline&) = delete;
+
     // Pipeline advancing methods
     bool sendNextInstruction(); // false if no new instruction to send (ie at end)
     void comprehensiveAdvance();
+
+    // Running to completion, nothing is printed and nothing exits the process
+    RunStatus step(); // One cycle (none once the program has ended or faulted)
+    RunStatus step(uint64_t cycles); // Up to "cycles" cycles, fewer if the program ends or faults first
+    RunResult run(uint64_t maxCycles = 0); // Until the program ends or faults, or for at most maxCycles more cycles (0 = no limit)
+    RunStatus getStatus() const;
+    RunResult getResult() const; // Status, cycles, retired instructions and Stats so far
+    uint64_t getCycle() const;
     void advanceInstruction(StageType from, StageType to, bool deallocate = false);
     bool allPipelineStagesEmpty();
 
@@ -246,7 +355,6 @@ public:
 
     // Stall Checks
     StageType checkDataHazard(DEPENDENCY_TYPE reg, uint32_t register_dependency);
-    StageType checkRAWHazard(DEPENDENCY_TYPE reg, uint32_t register_dependency);
 
     void addDetectedForward(StageType to, StageType from, DEPENDENCY_TYPE dep);
 
@@ -270,7 +378,6 @@ public:
     void writeBack(); // Simulates WB stage
 
     void handleStalledState(); // Handles stalled state
-    void setRAWStall(int numCycles, StageType stopStage);
 
 
 
@@ -281,37 +388,87 @@ public:
     void executeStore();
     void executeJType();
     void executeBranch();
+    void executeUType(); // LUI, AUIPC
+    void executeSystem(); // FENCE, ECALL, EBREAK
 
     uint32_t getForwardedValue(StageType stage, DEPENDENCY_TYPE dep);
-    bool isValidForward(StageType from, StageType to);
+    bool isValidForward(StageType from, StageType to); // The path exists and is enabled
+
+    // Branch direction predictor, BTB and return address stack, false (and unchanged) for a bad config, set before running
+    bool setBranchPredictor(BranchPredictorConfig config);
+    const BranchPredictor& getBranchPredictor() const;
+    bool setBranchTargetBuffer(BranchTargetBufferConfig config);
+    const BranchTargetBuffer& getBranchTargetBuffer() const;
+    bool setReturnAddressStack(unsigned depth);
+    const ReturnAddressStack& getReturnAddressStack() const;
+
+    // Instruction and data caches, L2 and memory latency, false (and unchanged) for a bad config, set before running
+    bool setMemoryHierarchy(const MemoryHierarchyConfig& config);
+    const MemoryHierarchy& getMemoryHierarchy() const;
+
+    // Forwarding paths, false (and unchanged) for a path the pipeline has no room for
+    bool setForwardingPath(StageType from, StageType to, bool enabled);
+    const BypassNetwork& getBypassNetwork() const;
+
+    // Timing of one instruction, false (and unchanged) unless 1 <= interval <= latency and the result exists by then
+    bool setInstructionTiming(EXACT_INSTRUCTION instruction, InstructionTiming timing);
+    const InstructionTiming& getInstructionTiming(EXACT_INSTRUCTION instruction) const;
+
+    // Latency and interval of every instruction on a unit (ie --mul/--div), same checks
+    bool setFunctionalUnitTiming(FunctionalUnit unit, FunctionalUnitTiming timing);
+    FunctionalUnitTiming getFunctionalUnitTiming(FunctionalUnit unit) const; // As its first instruction in timing.def has it
 
-    // Memory access helper functions
+    // Memory access helper functions (words, through the memory map)
     bool setDataMemory(uint32_t address, int32_t data);
     int32_t getDataMemory(uint32_t address);
-    // Make some more for integer registers
+    GuestMemory& getMemory(); // To change the memory map or turn on huge pages before running
+
+    // Any width, by the load or store doing the access (LB..LHU, SB..SW)
+    bool storeDataMemory(EXACT_INSTRUCTION store, uint32_t address, int32_t data); // Low bytes of data, must be aligned
+    int32_t loadDataMemory(EXACT_INSTRUCTION load, uint32_t address); // Sign or zero extended, faults like getDataMemory
 
     // To string methods
-    std::string getCycleOutput();
+    std::string getCycleOutput(bool changed_registers_only = false); // changed_registers_only also starts the next change set
     std::string getPipelineStatusOutput();
-    std::string getIntegerRegistersOutput();
+    std::string getIntegerRegistersOutput(bool changed_only = false); // changed_only lists the registers changed since clearDirtyRegisters
     std::string getPipelineRegistersOutput() const;
     std::string getDataMemoryOutput() const;
     std::string getStalledInstruction();
+    std::string getForwardingOutput(); // Forwards detected and completed this cycle
     std::string getPCOutput();
+    std::string getSummaryOutput(double seconds) const; // Final Stats, and simulated cycles per second over "seconds"
 
 
     // Consuming from lexer
     void addInstruction(Instruction instruction);
+    void addInstruction(Instruction instruction, uint32_t address);
+
+    // Consuming from a binary/ELF loader (sets entry point, code and data)
+    void loadProgram(const ProgramImage& image);
+    void setEntryPoint(uint32_t address);
+
+    // Consuming a predecoded image in place (ie a mapped .rvimg), entries must outlive the pipeline
+    void attachProgram(const DecodedEntry* entries, std::size_t num_slots, uint32_t base, std::size_t num_instructions);
+    const DecodedProgram& getProgram() const;
+
+    // Consuming from a lexer thread, only the last "window" decoded instructions are kept
+    void attachInstructionStream(InstructionStream* stream, std::size_t window = 4096);
 
     // Methods for interacting with integer registers
     void setIntegerRegister(uint32_t register_num, int32_t val);
     int32_t getIntegerRegister(uint32_t register_num);
+    uint32_t getDirtyRegisters() const; // Bit n set if xn changed since clearDirtyRegisters
+    void clearDirtyRegisters();
 
 
 
 private:
 
-    int curr_cycle = 0;
+    uint64_t curr_cycle = 0;
+
+    RunStatus status = RUNNING;
+    std::string fault_message;
+    void fault(RunStatus reason, const std::string& message); // The first fault of a run sticks
 
     // Pipeline Registers
     PipelineRegisters pipeline_registers;
@@ -324,22 +481,61 @@ private:
 
     // Forwarding
     Forwarding forwarding;
+    BypassNetwork bypass;
+
+    // Latency, unit and issue interval of every instruction, starts as timing.def
+    InstructionTimingTable instruction_timing = default_instruction_timing();
+
+    // Branch prediction, what fetch predicted for each in-flight instruction by slot
+    struct FetchPrediction {
+        uint64_t history = 0; // Global history before it was fetched
+        ReturnAddressStack::Checkpoint ras; // And the return address stack
+        bool taken = false; // Direction predicted for a branch
+        bool redirected = false; // Fetch went on at next instead of the following word
+        uint32_t next = 0;
+    };
+    BranchPredictor predictor;
+    BranchTargetBuffer btb;
+    ReturnAddressStack ras;
+    std::array<FetchPrediction, InstructionPool::CAPACITY + 1> fetch_predictions;
+    void predictFetch(const Instruction& instruction, uint32_t address, FetchPrediction& prediction);
+    bool resolveRedirect(bool taken, uint32_t target); // In EX, false if fetch didn't follow it and was sent there
+    void squashYounger(); // Cancels IF..RF and puts the history and RAS back to before the instruction in EX was fetched
+    void dropOlderWrite(uint32_t reg); // Before a link register is written in EX
+
+    // Caches, looked up as an instruction enters IF and as a load or store enters DF
+    MemoryHierarchy memory_hierarchy;
+
+    // RAW and structural hazards
+    Scoreboard scoreboard;
+    uint32_t waitingOnResult(bool& unreachable); // Register the instruction in RF needs that isn't ready for EX, 0 if none
+    bool operandReady(uint32_t reg, StageType needed, bool& unreachable); // reg can be had by "needed" if RF moves to EX now
+    bool functionalUnitBusy(); // The unit the instruction in RF needs can't take it into EX yet
+    void holdFrontEnd(StageType last_held); // Keeps IF..last_held in place for a cycle (RF or DF)
 
     // instruction_index represents the index of the next instruction to be sent
     int instruction_index = 0;
 
-    std::vector<Instruction> instructions; // Raw instructions recieved from lexer
+    DecodedProgram program; // Instructions by address, fetch indexes it by (pc - base) >> 2
 
-    std::unordered_map<StageType, PipelineStage> stages;  // The 8 pipeline stages
+    InstructionPool instruction_pool; // Every in-flight instruction, stages hold slots into it
+    std::array<PipelineStage, NUM_STAGES> stages; // The 8 pipeline stages, indexed by StageType
 
-    std::unordered_map<std::string, int32_t> integer_registers; // Integer registers
+    IntegerRegisterFile integer_registers; // Integer registers
 
-    std::unordered_map<uint32_t, int32_t> data_memory;
+    // Data memory, mapped at 600..1003 unless loadProgram replaces that with the data segments
+    GuestMemory data_memory;
+    uint32_t data_memory_low = 600; // First address the trace shows
 
-    std::unordered_map<int, Instruction> instruction_map; //Maps PC to instruction
+    uint32_t text_base = 496; // Address of the first instruction added without an explicit address
 
     int pc = 492; // Program counter
 
+    // Streaming mode
+    bool fetchFromStream(uint32_t address); // Pulls from the stream until address is decoded
+    InstructionStream* instruction_stream = nullptr;
+    uint32_t stream_next_address = 0; // Lowest address the stream has not delivered yet
+
 };
 
 
@@ -2,9 +2,10 @@
 #define PIPELINE_STAGE_H
 
 #include "instruction.h"
-#include <memory>
+#include "instructionpool.h"
+#include <string>
+#include <string_view>
 #include <vector>
-#include <regex>
 
 
 enum StageType {
@@ -20,41 +21,44 @@ enum StageType {
     NONE // Dummy type
 };
 
+const std::size_t NUM_STAGES = NONE; // Stages are indexed by StageType
+
+const char* stage_type_name(StageType type); // "IF".."WB", "Unknown" for NONE
+
 class PipelineStage {
 
 public: 
 
     PipelineStage(); // Default to IF or an invalid state
-    PipelineStage(StageType type);
+    PipelineStage(StageType type, InstructionPool* pool); // Instructions live in pool, the stage only holds a slot
 
 
     // Instruction management
 
-    void setInstruction(std::unique_ptr<Instruction> instr);
-    std::unique_ptr<Instruction> clearInstruction();
+    void setInstruction(InstructionSlot slot); // Formats its display string
+    void setInstruction(InstructionSlot slot, std::string_view display); // Display string already known, must outlive the stage's use of it
+    InstructionSlot clearInstruction(); // Hands the slot over, the stage is empty afterwards
     bool isEmpty() const;
 
     
     // Getters NEED TO UPDATE THESE FOR MEMORY SAFETY
     StageType getStageType() const;
-    std::unordered_map<DEPENDENCY_TYPE, uint32_t> getDependencies() const; // Protect these from segfaults
+    Dependencies getDependencies() const; // Protect these from segfaults
     uint32_t getDestination() const;
     int32_t getImmediate() const;
     EXACT_INSTRUCTION getExactInstruction() const;
     uint32_t getValue() const;
-    void deallocateInstruction();
+    uint32_t getAddress() const; // Where the instruction was fetched from
+    void deallocateInstruction(); // Returns the slot to the pool
     INST_TYPE getInstructionType();
 
-    // DO NOT USE THIS EXCEPT TO MOVE !!!
-    std::unique_ptr<Instruction>& getInstruction(); // !!!
-    // DO NOT USE THIS EXCEPT TO MOVE!! 
-
+    InstructionSlot getSlot() const;
     Instruction getInstructionCopy() const;
 
     void setResult(int32_t newResult); // for setting the result of a computation in ex stage
     int32_t getResult() const;
 
-    std::unordered_map<DEPENDENCY_TYPE, int32_t> getRegisterValues() const;
+    RegisterValues getRegisterValues() const;
     void setRegisterValue(DEPENDENCY_TYPE reg, int32_t newValue);
     
     // for seetting memory address for store
@@ -72,8 +76,10 @@ public:
     int getNumCyclesAhead(DEPENDENCY_TYPE dep) const;
 
 
-    // Get and set current state
+    // Get and set current state, the text is only built by getState
     void setState(std::string updatedState);
+    void setStalled(); // **STALL**
+    void setFetched(Dword value); // <Fetched ...> as shown by IS
     std::string getState() const;
     void resetState();
 
@@ -83,7 +89,7 @@ public:
     // Utility functions
     std::string getStageName() const;
     std::string getInstructionString(); // Get instruction string
-    std::string getNewStyleIstring() const;
+    std::string_view getNewStyleIstring() const;
 
     // get and set already completed
     bool getAlreadyCompleted() const;
@@ -93,11 +99,31 @@ public:
 
 private:
 
+    enum StateKind {
+        STATE_NOP,
+        STATE_UNKNOWN, // <unknown>
+        STATE_STALL,
+        STATE_FETCHED, // fetched_value
+        STATE_DISPLAY, // The display string
+        STATE_TEXT // state_text
+    };
+
     StageType type;
-    std::unique_ptr<Instruction> curr_instruction;
-    std::string state = "* " + getStageName() + " : NOP\n";
+    InstructionPool* pool = nullptr;
+    InstructionSlot slot = NO_SLOT;
+
+    Instruction& current() { return pool->get(slot); }
+    const Instruction& current() const { return pool->get(slot); }
+
+    StateKind state = STATE_NOP;
+    Dword fetched_value = 0;
+    std::string state_text;
+
+    std::string_view display; // Usually into the program's display strings
+    std::string owned_display; // When setInstruction had to format it
+    bool owns_display = false;
 
-    std::string new_style_istring;
+    std::string_view getDisplay() const;
 
     bool alreadyCompleted = false; // for when in a stall, something was already completed
 
@@ -0,0 +1,57 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+/**
+ * Fixed set of worker threads pulling tasks from a shared queue
+ */
+class ThreadPool {
+
+public:
+
+    explicit ThreadPool(unsigned num_threads = 0); // 0 means one per hardware thread
+    ~ThreadPool(); // Finishes queued tasks, then joins
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Queues a task, the future holds its result (or exception)
+    template <typename F>
+    auto submit(F task) -> std::future<decltype(task())> {
+
+        auto packaged = std::make_shared<std::packaged_task<decltype(task())()>>(std::move(task));
+        auto result = packaged->get_future();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.emplace_back([packaged]() { (*packaged)(); });
+        }
+        task_ready.notify_one();
+
+        return result;
+    }
+
+    unsigned getNumThreads() const;
+
+private:
+
+    void workerLoop();
+
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable task_ready;
+    bool stopping = false;
+
+};
+
+#endif
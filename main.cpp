@@ -1,9 +1,14 @@
+#include <chrono>
 #include <iostream>
 #include <string>
 #include <stdlib.h>
 
 #include "include/lexer.h"
 #include "include/pipeline.h"
+#include "include/loader.h"
+#include "include/instructionstream.h"
+#include "include/disassembler.h"
+#include "include/imagecache.h"
 
 int main(int argc, char* argv[]) { 
 
@@ -21,9 +26,9 @@ int main(int argc, char* argv[]) {
     std::string outputfile = argv[2];
     std::string operation = argv[3];
 
-    // Force dis flag
-    if (std::string(argv[3]) != "dis") {
-        std::cerr << "Operation must be 'dis'." << std::endl;
+    // dis prints every cycle, sim runs headless and prints a summary at the end
+    if (operation != "dis" && operation != "sim") {
+        std::cerr << "Operation must be 'dis' or 'sim'." << std::endl;
         std::cerr << "Please pass all required parameters: \n      --Inputfilename \n      --Outputfilename \n      --Operation" << std::endl;
         exit(1);
     }
@@ -38,14 +43,236 @@ int main(int argc, char* argv[]) {
     Instruction curr_instruction;
 
 
-    lexer->set_input_file(const_cast<char*>(inputfile.c_str()));
-    lexer->set_output_file(const_cast<char*>(outputfile.c_str()));
+    // Optional flags after the operation
+    uint32_t base_address = 496; // Where a flat .bin image is loaded
+    bool streaming = false; // Lex on a separate thread while simulating (text input only)
+    bool background_output = false; // Write dis output from a separate thread
+    bool direct_output = false; // Open the dis output with O_DIRECT
+    int dis_threads = -1; // >= 0 means parallel disassembly only (0 = all cores)
+    std::string cache_file; // Predecoded image to load from, or to write after a miss
+    long long max_cycles = -1; // 0 runs until the program ends, unset means 127 for dis and no limit for sim
+    bool changed_registers = false; // dis lists only the registers that changed since the previous cycle
+    std::vector<MemoryRegion> extra_regions; // Added to the memory map once the program is loaded
+    bool huge_pages = false; // Back guest memory with transparent huge pages
+    for (int i = 4; i < argc; i++) {
+        std::string flag = argv[i];
+        if (flag == "--stream") {
+            streaming = true;
+        } else if (flag == "--async-output") {
+            background_output = true;
+        } else if (flag == "--direct-output") {
+            direct_output = true;
+        } else if (flag.rfind("--threads=", 0) == 0) {
+            dis_threads = std::stoi(flag.substr(10));
+        } else if (flag == "--changed-registers") {
+            changed_registers = true;
+        } else if (flag == "--cache") {
+            cache_file = inputfile + ".rvimg";
+        } else if (flag.rfind("--cache=", 0) == 0) {
+            cache_file = flag.substr(8);
+        } else if (flag.rfind("--max-cycles=", 0) == 0) {
+            max_cycles = std::stoll(flag.substr(13));
+        } else if (flag.rfind("--memory=", 0) == 0) {
+            // --memory=BASE:SIZE[:ro]
+            std::string spec = flag.substr(9);
+            std::size_t colon = spec.find(':');
+            if (colon == std::string::npos) {
+                std::cerr << "Memory regions are given as --memory=BASE:SIZE[:ro]" << std::endl;
+                exit(1);
+            }
+            MemoryRegion region;
+            region.name = spec.substr(0, colon);
+            region.base = static_cast<uint32_t>(std::stoul(spec.substr(0, colon), nullptr, 0));
+            std::size_t end = 0;
+            region.size = std::stoull(spec.substr(colon + 1), &end, 0);
+            std::string access = spec.substr(colon + 1 + end);
+            if (!access.empty() && access != ":ro") {
+                std::cerr << "Memory regions are given as --memory=BASE:SIZE[:ro]" << std::endl;
+                exit(1);
+            }
+            region.writable = access.empty();
+            extra_regions.push_back(region);
+        } else if (flag.rfind("--mul=", 0) == 0 || flag.rfind("--div=", 0) == 0) {
+            // --mul=LATENCY[:INTERVAL], the multiplier is pipelined unless told otherwise, the divider is not
+            bool multiplier = flag[2] == 'm';
+            std::string spec = flag.substr(6);
+            std::size_t end = 0;
+            FunctionalUnitTiming timing;
+            timing.latency = std::stoi(spec, &end);
+            timing.interval = multiplier ? 1 : timing.latency;
+            if (end < spec.size()) {
+                if (spec[end] != ':') {
+                    std::cerr << "Functional unit timings are given as " << flag.substr(0, 6) << "LATENCY[:INTERVAL]" << std::endl;
+                    exit(1);
+                }
+                timing.interval = std::stoi(spec.substr(end + 1));
+            }
+            if (!pipeline->setFunctionalUnitTiming(multiplier ? MULTIPLIER : DIVIDER, timing)) { exit(1); }
+        } else if (flag.rfind("--no-forward=", 0) == 0) {
+            // --no-forward=FROM:TO by stage (ie DF:EX), or all
+            std::string spec = flag.substr(13);
+            if (spec == "all") {
+                for (int from = DF; from <= WB; from++) {
+                    for (int to = EX; to < from; to++) {
+                        if (forward_path_exists(StageType(from), StageType(to))) { pipeline->setForwardingPath(StageType(from), StageType(to), false); }
+                    }
+                }
+                continue;
+            }
+            StageType ends[2] = {NONE, NONE};
+            std::size_t colon = spec.find(':');
+            for (int end = 0; end < 2 && colon != std::string::npos; end++) {
+                std::string name = (end == 0) ? spec.substr(0, colon) : spec.substr(colon + 1);
+                for (int stage = IF; stage < NONE; stage++) {
+                    if (name == stage_type_name(StageType(stage))) { ends[end] = StageType(stage); }
+                }
+            }
+            if (ends[0] == NONE || ends[1] == NONE) {
+                std::cerr << "Forwarding paths are given as --no-forward=FROM:TO (ie DF:EX) or --no-forward=all" << std::endl;
+                exit(1);
+            }
+            if (!pipeline->setForwardingPath(ends[0], ends[1], false)) { exit(1); }
+        } else if (flag.rfind("--predictor=", 0) == 0) {
+            // --predictor=NAME[:BITS], ie gshare:14
+            std::string spec = flag.substr(12);
+            std::size_t colon = spec.find(':');
+            BranchPredictorConfig config;
+            if (!predictor_kind_from_string(spec.substr(0, colon), config.kind)) {
+                std::cerr << "Branch predictors are given as --predictor=NAME[:BITS], NAME one of not-taken, btfn, bimodal, gshare, tage" << std::endl;
+                exit(1);
+            }
+            if (colon != std::string::npos) { config.table_bits = static_cast<unsigned>(std::stoul(spec.substr(colon + 1))); }
+            if (!pipeline->setBranchPredictor(config)) { exit(1); }
+        } else if (flag.rfind("--btb=", 0) == 0) {
+            // --btb=ENTRIES[:WAYS], 4-way unless told otherwise
+            std::string spec = flag.substr(6);
+            std::size_t end = 0;
+            BranchTargetBufferConfig config;
+            config.entries = static_cast<unsigned>(std::stoul(spec, &end));
+            if (end < spec.size()) {
+                if (spec[end] != ':') {
+                    std::cerr << "Branch target buffers are given as --btb=ENTRIES[:WAYS]" << std::endl;
+                    exit(1);
+                }
+                config.ways = static_cast<unsigned>(std::stoul(spec.substr(end + 1)));
+            }
+            if (!pipeline->setBranchTargetBuffer(config)) { exit(1); }
+        } else if (flag.rfind("--ras=", 0) == 0) {
+            if (!pipeline->setReturnAddressStack(static_cast<unsigned>(std::stoul(flag.substr(6))))) { exit(1); }
+        } else if (flag.rfind("--icache=", 0) == 0 || flag.rfind("--dcache=", 0) == 0 || flag.rfind("--l2=", 0) == 0) {
+            // --icache=SIZE:WAYS:LINE[:OPTION]..., ie --dcache=32k:4:64:plru:wt, options lru/plru/random, wb/wt, wa/nwa
+            std::size_t equals = flag.find('=');
+            CacheLevel level = (flag[2] == 'i') ? L1I : (flag[2] == 'd') ? L1D : L2;
+            MemoryHierarchyConfig config = pipeline->getMemoryHierarchy().getConfig();
+            if (!cache_config_from_string(flag.substr(equals + 1), config.levels[level])) {
+                std::cerr << "Caches are given as " << flag.substr(0, equals + 1) << "SIZE:WAYS:LINE[:OPTION]..., OPTION one of lru, plru, random, wb, wt, wa, nwa" << std::endl;
+                exit(1);
+            }
+            if (!pipeline->setMemoryHierarchy(config)) { exit(1); }
+        } else if (flag.rfind("--l2-latency=", 0) == 0 || flag.rfind("--mem-latency=", 0) == 0) {
+            // Cycles an L1 miss takes from L2, and a miss in the last cache from memory
+            MemoryHierarchyConfig config = pipeline->getMemoryHierarchy().getConfig();
+            unsigned latency = static_cast<unsigned>(std::stoul(flag.substr(flag.find('=') + 1)));
+            if (flag[2] == 'l') { config.l2_latency = latency; }
+            else { config.memory_latency = latency; }
+            if (!pipeline->setMemoryHierarchy(config)) { exit(1); }
+        } else if (flag == "--huge-pages") {
+            huge_pages = true;
+        } else if (flag.rfind("--base=", 0) == 0) {
+            base_address = static_cast<uint32_t>(std::stoul(flag.substr(7), nullptr, 0));
+        } else {
+            std::cerr << "Unknown option: " << flag << std::endl;
+            exit(1);
+        }
+    }
 
-    //std::cout << "File size: " << static_cast<int>(lexer->getFileSize()) << std::endl;
-    
-    while (!lexer->isEOF()) {
-        curr_instruction = lexer->read_next_instruction();
-        pipeline->addInstruction(curr_instruction);
+    pipeline->getMemory().setHugePages(huge_pages); // Before loading, ELF data goes straight into pages
+
+    // Parallel disassembly of a text file (or a directory of them), no simulation
+    if (dis_threads >= 0) {
+        return disassemble_parallel(inputfile, outputfile, static_cast<unsigned>(dis_threads)) ? 0 : 1;
+    }
+
+    lexer->set_output_file(const_cast<char*>(outputfile.c_str()), background_output, direct_output);
+
+    ProgramFormat format = detect_program_format(inputfile);
+
+    // Lives until main returns, the pipeline drains it when the program ends
+    InstructionStream stream;
+
+    // Mapped until main returns, the pipeline fetches straight from it
+    ImageCache cache;
+    bool cache_hit = !cache_file.empty() && cache.open(cache_file, inputfile);
+
+    ProgramImage image; // Entry point and data segments (empty for text input)
+
+    if (cache_hit) {
+
+        lexer->write_output_raw(cache.getDisText(), cache.getDisSize());
+        lexer->close_output();
+
+        pipeline->loadProgram(cache.getDataImage());
+        pipeline->attachProgram(cache.getEntries(), cache.getNumSlots(), cache.getBase(), cache.getNumInstructions());
+
+    } else if (format == TEXT_BITS && streaming) {
+
+        lexer->set_input_file(const_cast<char*>(inputfile.c_str()), MAPPED);
+
+        stream.start([lexer](InstructionStream& s) {
+            uint32_t address = 496;
+            while (!lexer->isEOF()) {
+                s.push({address, lexer->read_next_instruction()});
+                address += 4;
+            }
+            lexer->close_output();
+        });
+
+        pipeline->attachInstructionStream(&stream);
+
+    } else if (format == TEXT_BITS) {
+
+        lexer->set_input_file(const_cast<char*>(inputfile.c_str()), MAPPED);
+
+        //std::cout << "File size: " << static_cast<int>(lexer->getFileSize()) << std::endl;
+        
+        while (!lexer->isEOF()) {
+            curr_instruction = lexer->read_next_instruction();
+            pipeline->addInstruction(curr_instruction);
+        }
+
+        lexer->close_output();
+
+    } else {
+
+        bool loaded = (format == ELF32) ? load_elf32(inputfile, image) 
+                                        : load_raw_binary(inputfile, base_address, image);
+        if (!loaded) { exit(1); }
+
+        // Disassemble the code segments at their real addresses
+        for (const LoadedSegment& segment : image.segments) {
+            if (!segment.executable) { continue; }
+            std::vector<Dword> words = segment_words(segment);
+            DecodedBatch decoded;
+            decode_batch(words.data(), words.size(), decoded);
+            char line[MAX_FORMATTED_LENGTH];
+            for (std::size_t i = 0; i < decoded.size(); i++) {
+                std::size_t length = format_disassembly(decoded.getInstruction(i), segment.address + (i * 4), line);
+                line[length++] = '\n';
+                lexer->write_output_raw(line, length);
+            }
+        }
+
+        lexer->close_output();
+        pipeline->loadProgram(image);
+    }
+
+    for (const MemoryRegion& region : extra_regions) {
+        if (!pipeline->getMemory().addRegion(region.name, region.base, region.size, region.writable)) { exit(1); }
+    }
+
+    // Streamed programs are never whole in memory, so only batch loads fill the cache
+    if (!cache_file.empty() && !cache_hit && !streaming) {
+        ImageCache::write(cache_file, inputfile, pipeline->getProgram(), image, outputfile);
     }
 
     //std::cout << pipeline->getPipelineStatusOutput();
@@ -57,10 +284,35 @@ int main(int argc, char* argv[]) {
     //std::cout << pipeline->getCycleOutput();
     //pipeline->comprehensiveAdvance();
 
+    if (max_cycles < 0) { max_cycles = (operation == "dis") ? 127 : 0; }
+
+    if (operation == "sim") {
+
+        auto start = std::chrono::steady_clock::now();
+        RunResult result = pipeline->run(static_cast<uint64_t>(max_cycles));
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << "Ended: " << run_status_to_string(result.status);
+        if (!result.message.empty()) { std::cout << " (" << result.message << ")"; }
+        std::cout << "\n\n" << pipeline->getSummaryOutput(seconds);
+
+        return (result.status == FINISHED || result.status == CYCLE_LIMIT) ? 0 : 1;
+    }
+
+    // Flushed every cycle, so a run that faults mid-program still shows how it got there
     while (true) {
-        pipeline->comprehensiveAdvance();
-        std::cout << pipeline->getCycleOutput();
+
+        RunStatus status = pipeline->step();
+
+        if (status == MEMORY_FAULT || status == REGISTER_FAULT) {
+            std::cerr << "Error: " << pipeline->getResult().message << std::endl;
+            return 1;
+        }
+
+        std::cout << pipeline->getCycleOutput(changed_registers) << std::flush;
+
+        if (status != RUNNING || (max_cycles > 0 && pipeline->getCycle() >= static_cast<uint64_t>(max_cycles))) { break; }
     }
 
     return 0;
-}	
\ No newline at end of file
+}
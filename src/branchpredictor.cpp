@@ -0,0 +1,379 @@
+#include "../include/branchpredictor.h"
+
+#include <iostream>
+
+
+static const char* const PREDICTOR_NAMES[NUM_PREDICTOR_KINDS] = {"not-taken", "btfn", "bimodal", "gshare", "tage"};
+
+std::string predictor_kind_to_string(PredictorKind kind) {
+    if (kind < 0 || kind >= NUM_PREDICTOR_KINDS) { return "unknown"; }
+    return PREDICTOR_NAMES[kind];
+}
+
+bool predictor_kind_from_string(const std::string& name, PredictorKind& kind) {
+
+    for (int candidate = 0; candidate < NUM_PREDICTOR_KINDS; candidate++) {
+        if (name == PREDICTOR_NAMES[candidate]) {
+            kind = static_cast<PredictorKind>(candidate);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// 2 bit saturating counter, taken from 2 up
+static void train_counter(uint8_t& counter, bool taken) {
+    if (taken && counter < 3) { counter++; }
+    else if (!taken && counter > 0) { counter--; }
+}
+
+// The newest "length" bits of history XORed down to "bits" bits
+static uint32_t fold_history(uint64_t history, unsigned length, unsigned bits) {
+
+    uint64_t remaining = (length >= 64) ? history : history & ((uint64_t(1) << length) - 1);
+    uint32_t folded = 0;
+
+    while (remaining != 0) {
+        folded ^= static_cast<uint32_t>(remaining & ((uint64_t(1) << bits) - 1));
+        remaining >>= bits;
+    }
+
+    return folded;
+}
+
+
+
+
+// CONFIGURATION
+BranchPredictor::BranchPredictor() { configure(BranchPredictorConfig()); }
+
+bool BranchPredictor::configure(BranchPredictorConfig newConfig) {
+
+    if (newConfig.kind < 0 || newConfig.kind >= NUM_PREDICTOR_KINDS) {
+        std::cerr << "Error: Unknown branch predictor." << std::endl;
+        return false;
+    }
+
+    if (newConfig.table_bits < MIN_TABLE_BITS || newConfig.table_bits > MAX_TABLE_BITS) {
+        std::cerr << "Error: Branch predictor tables take " << MIN_TABLE_BITS << " to " << MAX_TABLE_BITS
+                  << " index bits, not " << newConfig.table_bits << "." << std::endl;
+        return false;
+    }
+
+    config = newConfig;
+    history = 0;
+    tage_updates = 0;
+
+    // Only what the kind uses, weakly not taken to start
+    bool uses_counters = config.kind == BIMODAL || config.kind == GSHARE || config.kind == TAGE;
+    counters.assign(uses_counters ? (std::size_t(1) << config.table_bits) : 0, 1);
+
+    tagged_bits = config.table_bits - 2;
+    tagged.assign(config.kind == TAGE ? TAGE_TABLES << tagged_bits : 0, TageEntry());
+
+    return true;
+}
+
+const BranchPredictorConfig& BranchPredictor::getConfig() const { return config; }
+
+std::string BranchPredictor::getName() const {
+
+    std::string name = predictor_kind_to_string(config.kind);
+
+    if (config.kind == BIMODAL || config.kind == GSHARE) {
+        name += " (" + std::to_string(counters.size()) + " entries)";
+    } else if (config.kind == TAGE) {
+        name += " (" + std::to_string(counters.size()) + " base + " + std::to_string(TAGE_TABLES) + " x "
+              + std::to_string(std::size_t(1) << tagged_bits) + " tagged entries)";
+    }
+
+    return name;
+}
+
+
+
+
+// PREDICTING AND TRAINING
+bool BranchPredictor::predict(uint32_t pc, uint32_t target) {
+
+    bool taken = false;
+
+    switch (config.kind) {
+        case BTFN:
+            taken = target < pc;
+            break;
+        case BIMODAL:
+            taken = counters[baseIndex(pc)] >= 2;
+            break;
+        case GSHARE:
+            taken = counters[baseIndex(pc ^ (static_cast<uint32_t>(history) << 2))] >= 2;
+            break;
+        case TAGE:
+            taken = tagePredict(pc, tageLookup(pc, history));
+            break;
+        default: // NOT_TAKEN
+            break;
+    }
+
+    history = (history << 1) | static_cast<uint64_t>(taken);
+
+    return taken;
+}
+
+void BranchPredictor::update(uint32_t pc, uint64_t branch_history, bool taken) {
+
+    switch (config.kind) {
+        case BIMODAL:
+            train_counter(counters[baseIndex(pc)], taken);
+            return;
+        case GSHARE:
+            train_counter(counters[baseIndex(pc ^ (static_cast<uint32_t>(branch_history) << 2))], taken);
+            return;
+        case TAGE:
+            tageUpdate(pc, branch_history, taken);
+            return;
+        default: // NOT_TAKEN and BTFN don't learn
+            return;
+    }
+}
+
+uint64_t BranchPredictor::getHistory() const { return history; }
+
+void BranchPredictor::setHistory(uint64_t newHistory) { history = newHistory; }
+
+
+
+
+// TAGE
+BranchPredictor::TageLookup BranchPredictor::tageLookup(uint32_t pc, uint64_t branch_history) const {
+
+    TageLookup lookup;
+    uint32_t word = pc >> 2;
+
+    for (std::size_t table = 0; table < TAGE_TABLES; table++) {
+
+        unsigned length = TAGE_HISTORY[table];
+        uint32_t index = word ^ (word >> tagged_bits) ^ fold_history(branch_history, length, tagged_bits);
+        uint32_t tag = word ^ fold_history(branch_history, length, TAGE_TAG_BITS)
+                     ^ (fold_history(branch_history, length, TAGE_TAG_BITS - 1) << 1);
+
+        lookup.index[table] = (static_cast<uint32_t>(table) << tagged_bits) | (index & ((1u << tagged_bits) - 1));
+        lookup.tag[table] = static_cast<uint16_t>(tag & ((1u << TAGE_TAG_BITS) - 1));
+    }
+
+    // Longest history that hits provides, the next one is the alternate
+    for (int table = TAGE_TABLES - 1; table >= 0; table--) {
+        if (tagged[lookup.index[table]].tag != lookup.tag[table]) { continue; }
+        if (lookup.provider < 0) { lookup.provider = table; }
+        else {
+            lookup.alternate = table;
+            break;
+        }
+    }
+
+    return lookup;
+}
+
+bool BranchPredictor::tageAlternate(uint32_t pc, const TageLookup& lookup) const {
+    return (lookup.alternate >= 0) ? tagged[lookup.index[lookup.alternate]].counter >= 0 : counters[baseIndex(pc)] >= 2;
+}
+
+bool BranchPredictor::tagePredict(uint32_t pc, const TageLookup& lookup) const {
+    /**
+     * A freshly allocated entry (weak, not yet useful) defers to the alternate
+     */
+
+    if (lookup.provider < 0) { return tageAlternate(pc, lookup); }
+
+    const TageEntry& provider = tagged[lookup.index[lookup.provider]];
+    bool weak = provider.counter == 0 || provider.counter == -1;
+
+    return (weak && provider.useful == 0) ? tageAlternate(pc, lookup) : provider.counter >= 0;
+}
+
+void BranchPredictor::tageUpdate(uint32_t pc, uint64_t branch_history, bool taken) {
+    /**
+     * The provider's counter learns the outcome, and its useful bits follow whether it beat the
+     * alternate. A misprediction allocates one entry in a longer table (one whose useful bits are 0),
+     * or ages the longer tables if none is free
+     */
+
+    TageLookup lookup = tageLookup(pc, branch_history);
+    bool predicted = tagePredict(pc, lookup);
+    bool alternate = tageAlternate(pc, lookup);
+
+    if (lookup.provider < 0) {
+        train_counter(counters[baseIndex(pc)], taken);
+    } else {
+        TageEntry& provider = tagged[lookup.index[lookup.provider]];
+        bool provider_taken = provider.counter >= 0;
+
+        if (provider_taken != alternate) {
+            if (provider_taken == taken && provider.useful < 3) { provider.useful++; }
+            else if (provider_taken != taken && provider.useful > 0) { provider.useful--; }
+        }
+
+        if (taken && provider.counter < 3) { provider.counter++; }
+        else if (!taken && provider.counter > -4) { provider.counter--; }
+    }
+
+    if (predicted != taken) {
+
+        bool allocated = false;
+        for (std::size_t table = lookup.provider + 1; table < TAGE_TABLES && !allocated; table++) {
+            TageEntry& entry = tagged[lookup.index[table]];
+            if (entry.useful != 0) { continue; }
+            entry.tag = lookup.tag[table];
+            entry.counter = taken ? 0 : -1;
+            allocated = true;
+        }
+
+        for (std::size_t table = lookup.provider + 1; table < TAGE_TABLES && !allocated; table++) {
+            tagged[lookup.index[table]].useful--;
+        }
+    }
+
+    // Age the useful bits so stale entries can be replaced
+    if ((++tage_updates & ((uint64_t(1) << 18) - 1)) == 0) {
+        for (TageEntry& entry : tagged) { entry.useful >>= 1; }
+    }
+}
+
+
+
+
+// BRANCH TARGET BUFFER
+static bool is_power_of_two(unsigned value) { return value != 0 && (value & (value - 1)) == 0; }
+
+bool BranchTargetBuffer::configure(BranchTargetBufferConfig newConfig) {
+
+    if (newConfig.entries != 0 && (!is_power_of_two(newConfig.entries) || !is_power_of_two(newConfig.ways) ||
+                                   newConfig.ways > newConfig.entries || newConfig.entries > MAX_ENTRIES)) {
+        std::cerr << "Error: A BTB takes a power of 2 entries (up to " << MAX_ENTRIES << ") and a power of 2 ways, not "
+                  << newConfig.entries << " entries and " << newConfig.ways << " ways." << std::endl;
+        return false;
+    }
+
+    config = newConfig;
+    set_mask = config.entries ? config.entries / config.ways - 1 : 0;
+    clock = 0;
+
+    tags.assign(config.entries, 0);
+    targets.assign(config.entries, 0);
+    last_used.assign(config.entries, 0);
+
+    return true;
+}
+
+const BranchTargetBufferConfig& BranchTargetBuffer::getConfig() const { return config; }
+
+std::string BranchTargetBuffer::getName() const {
+    if (!enabled()) { return "none"; }
+    return std::to_string(config.entries) + " entries, " + std::to_string(config.ways) + "-way";
+}
+
+uint32_t* BranchTargetBuffer::find(uint32_t pc) {
+
+    uint32_t tag = (pc >> 2) | VALID;
+    uint32_t* set = tags.data() + ((pc >> 2) & set_mask) * config.ways;
+
+    for (unsigned way = 0; way < config.ways; way++) {
+        if (set[way] == tag) { return set + way; }
+    }
+
+    return nullptr;
+}
+
+bool BranchTargetBuffer::lookup(uint32_t pc, uint32_t& target) {
+
+    if (!enabled()) { return false; }
+
+    uint32_t* entry = find(pc);
+    if (entry == nullptr) { return false; }
+
+    std::size_t index = entry - tags.data();
+    last_used[index] = ++clock;
+    target = targets[index];
+
+    return true;
+}
+
+void BranchTargetBuffer::update(uint32_t pc, uint32_t target) {
+
+    if (!enabled()) { return; }
+
+    uint32_t* entry = find(pc);
+
+    // Least recently used way, invalid ones have a stamp of 0
+    if (entry == nullptr) {
+        std::size_t first = ((pc >> 2) & set_mask) * config.ways;
+        std::size_t victim = first;
+        for (std::size_t way = first + 1; way < first + config.ways; way++) {
+            if (last_used[way] < last_used[victim]) { victim = way; }
+        }
+        entry = tags.data() + victim;
+        *entry = (pc >> 2) | VALID;
+    }
+
+    std::size_t index = entry - tags.data();
+    last_used[index] = ++clock;
+    targets[index] = target;
+}
+
+
+
+
+// RETURN ADDRESS STACK
+bool ReturnAddressStack::configure(unsigned depth) {
+
+    if (depth > MAX_DEPTH) {
+        std::cerr << "Error: A return address stack holds up to " << MAX_DEPTH << " entries, not " << depth << "." << std::endl;
+        return false;
+    }
+
+    entries.assign(depth, 0);
+    top = 0;
+    size = 0;
+
+    return true;
+}
+
+unsigned ReturnAddressStack::getDepth() const { return static_cast<unsigned>(entries.size()); }
+
+void ReturnAddressStack::push(uint32_t address) {
+
+    if (entries.empty()) { return; }
+
+    entries[top] = address;
+    top = (top + 1) % entries.size();
+    if (size < entries.size()) { size++; }
+}
+
+bool ReturnAddressStack::pop(uint32_t& address) {
+
+    if (size == 0) { return false; }
+
+    top = (top + static_cast<uint32_t>(entries.size()) - 1) % entries.size();
+    size--;
+    address = entries[top];
+
+    return true;
+}
+
+ReturnAddressStack::Checkpoint ReturnAddressStack::checkpoint() const {
+
+    Checkpoint saved;
+    saved.top = top;
+    saved.size = size;
+    if (size != 0) { saved.value = entries[(top + entries.size() - 1) % entries.size()]; }
+
+    return saved;
+}
+
+void ReturnAddressStack::restore(const Checkpoint& saved) {
+
+    top = saved.top;
+    size = saved.size;
+    if (size != 0) { entries[(top + entries.size() - 1) % entries.size()] = saved.value; }
+}
@@ -0,0 +1,343 @@
+#include "../include/cache.h"
+
+#include <cstdlib>
+#include <iostream>
+
+
+static const char* const POLICY_NAMES[NUM_REPLACEMENT_POLICIES] = {"lru", "plru", "random"};
+
+std::string replacement_policy_to_string(ReplacementPolicy policy) {
+    if (policy < 0 || policy >= NUM_REPLACEMENT_POLICIES) { return "unknown"; }
+    return POLICY_NAMES[policy];
+}
+
+bool replacement_policy_from_string(const std::string& name, ReplacementPolicy& policy) {
+
+    for (int candidate = 0; candidate < NUM_REPLACEMENT_POLICIES; candidate++) {
+        if (name == POLICY_NAMES[candidate]) {
+            policy = static_cast<ReplacementPolicy>(candidate);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Decimal, with an optional k or m multiplier when allowed, false unless all of text is used
+static bool parse_number(const std::string& text, bool allow_suffix, uint64_t& value) {
+
+    if (text.empty() || text[0] < '0' || text[0] > '9') { return false; }
+
+    char* end = nullptr;
+    value = std::strtoull(text.c_str(), &end, 10);
+
+    if (allow_suffix && (*end == 'k' || *end == 'K')) { value <<= 10; end++; }
+    else if (allow_suffix && (*end == 'm' || *end == 'M')) { value <<= 20; end++; }
+
+    return *end == '\0' && value <= UINT32_MAX;
+}
+
+bool cache_config_from_string(const std::string& spec, CacheConfig& config) {
+
+    std::vector<std::string> fields;
+    std::size_t start = 0;
+    for (std::size_t colon = spec.find(':'); ; colon = spec.find(':', start)) {
+        fields.push_back(spec.substr(start, colon - start));
+        if (colon == std::string::npos) { break; }
+        start = colon + 1;
+    }
+
+    if (fields.size() < 3) { return false; }
+
+    uint64_t size = 0, ways = 0, line_size = 0;
+    if (!parse_number(fields[0], true, size) || !parse_number(fields[1], false, ways) || !parse_number(fields[2], false, line_size)) {
+        return false;
+    }
+
+    CacheConfig parsed = config;
+    parsed.size = static_cast<uint32_t>(size);
+    parsed.ways = static_cast<unsigned>(ways);
+    parsed.line_size = static_cast<unsigned>(line_size);
+
+    for (std::size_t field = 3; field < fields.size(); field++) {
+        const std::string& option = fields[field];
+        if (replacement_policy_from_string(option, parsed.replacement)) { continue; }
+        else if (option == "wb") { parsed.write_back = true; }
+        else if (option == "wt") { parsed.write_back = false; }
+        else if (option == "wa") { parsed.write_allocate = true; }
+        else if (option == "nwa") { parsed.write_allocate = false; }
+        else { return false; }
+    }
+
+    config = parsed;
+    return true;
+}
+
+static bool is_power_of_two(uint64_t value) { return value != 0 && (value & (value - 1)) == 0; }
+
+// "32 KiB", "2 MiB", "96 B"
+static std::string size_to_string(uint32_t bytes) {
+    if (bytes >= (1u << 30) && bytes % (1u << 30) == 0) { return std::to_string(bytes >> 30) + " GiB"; }
+    if (bytes >= (1u << 20) && bytes % (1u << 20) == 0) { return std::to_string(bytes >> 20) + " MiB"; }
+    if (bytes >= 1024 && bytes % 1024 == 0) { return std::to_string(bytes >> 10) + " KiB"; }
+    return std::to_string(bytes) + " B";
+}
+
+
+
+
+// CACHE
+bool Cache::configure(CacheConfig newConfig) {
+
+    if (newConfig.replacement < 0 || newConfig.replacement >= NUM_REPLACEMENT_POLICIES) {
+        std::cerr << "Error: Unknown cache replacement policy." << std::endl;
+        return false;
+    }
+
+    if (newConfig.size != 0 && (!is_power_of_two(newConfig.size) || newConfig.size > MAX_SIZE ||
+                                !is_power_of_two(newConfig.ways) || newConfig.ways > MAX_WAYS ||
+                                !is_power_of_two(newConfig.line_size) || newConfig.line_size < 4 ||
+                                uint64_t(newConfig.ways) * newConfig.line_size > newConfig.size)) {
+        std::cerr << "Error: A cache takes a power of 2 size (up to " << size_to_string(MAX_SIZE) << "), ways (up to " << MAX_WAYS
+                  << ") and line size (at least 4 B) that make at least one set, not " << newConfig.size << " B, "
+                  << newConfig.ways << " ways and " << newConfig.line_size << " B lines." << std::endl;
+        return false;
+    }
+
+    config = newConfig;
+    stats = CacheStats();
+    clock = 0;
+    random_state = 0x9E3779B97F4A7C15ull;
+
+    std::size_t lines = config.size ? config.size / config.line_size : 0;
+    line_bits = static_cast<unsigned>(__builtin_ctz(config.line_size));
+    set_mask = lines ? static_cast<uint32_t>(lines / config.ways - 1) : 0;
+
+    // Only what the policy uses
+    tags.assign(lines, 0);
+    dirty.assign(lines, 0);
+    last_used.assign(config.replacement == LRU ? lines : 0, 0);
+    tree.assign(config.replacement == PLRU && lines ? set_mask + std::size_t(1) : 0, 0);
+
+    return true;
+}
+
+const CacheConfig& Cache::getConfig() const { return config; }
+
+const CacheStats& Cache::getStats() const { return stats; }
+
+std::string Cache::getName() const {
+    if (!enabled()) { return "none"; }
+    return size_to_string(config.size) + ", " + std::to_string(config.ways) + "-way, " + std::to_string(config.line_size) + " B lines, " +
+           replacement_policy_to_string(config.replacement) + ", " + (config.write_back ? "write-back" : "write-through") + ", " +
+           (config.write_allocate ? "write-allocate" : "no write-allocate");
+}
+
+std::size_t Cache::find(uint32_t line) const {
+
+    uint32_t tag = line | VALID;
+    std::size_t first = (line & set_mask) * config.ways;
+
+    for (std::size_t way = first; way < first + config.ways; way++) {
+        if (tags[way] == tag) { return way; }
+    }
+
+    return NOT_FOUND;
+}
+
+bool Cache::access(uint32_t address, bool write) {
+
+    uint32_t line = address >> line_bits;
+    std::size_t index = find(line);
+
+    if (index == NOT_FOUND) {
+        stats.misses++;
+        return false;
+    }
+
+    stats.hits++;
+    if (write && config.write_back) { dirty[index] = 1; }
+
+    std::size_t set = line & set_mask;
+    touch(set, static_cast<unsigned>(index - set * config.ways));
+
+    return true;
+}
+
+bool Cache::fill(uint32_t address, bool make_dirty, uint32_t& victim) {
+
+    uint32_t line = address >> line_bits;
+    std::size_t set = line & set_mask;
+    std::size_t index = chooseVictim(set);
+
+    bool written_back = false;
+    if (tags[index] & VALID) {
+        stats.evictions++;
+        if (dirty[index]) {
+            stats.writebacks++;
+            victim = (tags[index] & ~VALID) << line_bits;
+            written_back = true;
+        }
+    }
+
+    tags[index] = line | VALID;
+    dirty[index] = make_dirty;
+    touch(set, static_cast<unsigned>(index - set * config.ways));
+
+    return written_back;
+}
+
+std::size_t Cache::chooseVictim(std::size_t set) {
+
+    std::size_t first = set * config.ways;
+
+    for (std::size_t way = first; way < first + config.ways; way++) {
+        if ((tags[way] & VALID) == 0) { return way; }
+    }
+
+    switch (config.replacement) {
+        case LRU: {
+            std::size_t victim = first;
+            for (std::size_t way = first + 1; way < first + config.ways; way++) {
+                if (last_used[way] < last_used[victim]) { victim = way; }
+            }
+            return victim;
+        }
+        case PLRU: {
+            // Follow the bits from the root down to a leaf
+            std::size_t node = 1, way = 0;
+            for (unsigned half = config.ways >> 1; half != 0; half >>= 1) {
+                bool right = (tree[set] >> node) & 1;
+                if (right) { way |= half; }
+                node = 2 * node + right;
+            }
+            return first + way;
+        }
+        default: // RANDOM, xorshift64
+            random_state ^= random_state << 13;
+            random_state ^= random_state >> 7;
+            random_state ^= random_state << 17;
+            return first + (random_state & (config.ways - 1));
+    }
+}
+
+void Cache::touch(std::size_t set, unsigned way) {
+
+    if (config.replacement == LRU) {
+        last_used[set * config.ways + way] = ++clock;
+        return;
+    }
+
+    if (config.replacement != PLRU) { return; }
+
+    // Every node on the way's path points at the other half
+    uint64_t& bits = tree[set];
+    std::size_t node = 1;
+    for (unsigned half = config.ways >> 1; half != 0; half >>= 1) {
+        bool right = (way & half) != 0;
+        if (right) { bits &= ~(uint64_t(1) << node); }
+        else { bits |= uint64_t(1) << node; }
+        node = 2 * node + right;
+    }
+}
+
+
+
+
+// MEMORY HIERARCHY
+static const char* const LEVEL_NAMES[NUM_CACHE_LEVELS] = {"L1I", "L1D", "L2"};
+
+std::string cache_level_to_string(CacheLevel level) {
+    if (level < 0 || level >= NUM_CACHE_LEVELS) { return "unknown"; }
+    return LEVEL_NAMES[level];
+}
+
+bool MemoryHierarchy::configure(const MemoryHierarchyConfig& newConfig) {
+
+    if (newConfig.l2_latency > MAX_LATENCY || newConfig.memory_latency > MAX_LATENCY) {
+        std::cerr << "Error: Cache and memory latencies are at most " << MAX_LATENCY << " cycles." << std::endl;
+        return false;
+    }
+
+    std::array<Cache, NUM_CACHE_LEVELS> configured;
+    for (int level = 0; level < NUM_CACHE_LEVELS; level++) {
+        if (!configured[level].configure(newConfig.levels[level])) { return false; }
+    }
+
+    config = newConfig;
+    caches = std::move(configured);
+
+    return true;
+}
+
+const MemoryHierarchyConfig& MemoryHierarchy::getConfig() const { return config; }
+
+const Cache& MemoryHierarchy::getCache(CacheLevel level) const { return caches[level]; }
+
+bool MemoryHierarchy::enabled() const {
+    return caches[L1I].enabled() || caches[L1D].enabled() || caches[L2].enabled();
+}
+
+unsigned MemoryHierarchy::fetch(uint32_t address) { return read(L1I, address); }
+
+unsigned MemoryHierarchy::load(uint32_t address) { return read(L1D, address); }
+
+unsigned MemoryHierarchy::store(uint32_t address) {
+
+    Cache& l1 = caches[L1D];
+    if (!l1.enabled()) { return 0; }
+
+    const CacheConfig& policy = l1.getConfig();
+
+    if (l1.access(address, true)) {
+        if (!policy.write_back) { writeNext(address); }
+        return 0;
+    }
+
+    if (!policy.write_allocate) {
+        writeNext(address);
+        return 0;
+    }
+
+    unsigned stalls = missPenalty(address);
+
+    uint32_t victim = 0;
+    if (l1.fill(address, policy.write_back, victim)) { writeNext(victim); }
+    if (!policy.write_back) { writeNext(address); }
+
+    return stalls;
+}
+
+unsigned MemoryHierarchy::read(CacheLevel level, uint32_t address) {
+
+    Cache& l1 = caches[level];
+    if (!l1.enabled() || l1.access(address, false)) { return 0; }
+
+    unsigned stalls = missPenalty(address);
+
+    uint32_t victim = 0;
+    if (l1.fill(address, false, victim)) { writeNext(victim); }
+
+    return stalls;
+}
+
+unsigned MemoryHierarchy::missPenalty(uint32_t address) {
+
+    Cache& l2 = caches[L2];
+    if (!l2.enabled()) { return config.memory_latency; }
+    if (l2.access(address, false)) { return config.l2_latency; }
+
+    uint32_t victim = 0;
+    l2.fill(address, false, victim); // Memory takes a dirty victim through the write buffer
+
+    return config.l2_latency + config.memory_latency;
+}
+
+void MemoryHierarchy::writeNext(uint32_t address) {
+
+    Cache& l2 = caches[L2];
+    if (!l2.enabled() || l2.access(address, true)) { return; }
+
+    uint32_t victim = 0;
+    if (l2.getConfig().write_allocate) { l2.fill(address, l2.getConfig().write_back, victim); }
+}
@@ -0,0 +1,178 @@
+#include "../include/decodedprogram.h"
+
+#include <algorithm>
+
+
+namespace {
+
+// Window mode reserves this much text per slot, display strings are well under it
+const std::size_t WINDOW_DISPLAY_BYTES = 64;
+
+// Display text is allocated this much at a time (a multiple of WINDOW_DISPLAY_BYTES)
+const std::size_t TEXT_CHUNK_BYTES = 64 * 1024;
+
+} // namespace
+
+
+
+void DecodedProgram::reset(uint32_t new_base, std::size_t new_window) {
+
+    entries.clear();
+    displays.clear();
+    text_chunks.clear();
+    text_used = 0;
+
+    base = new_base;
+    has_base = true;
+    window = new_window;
+    attached = false;
+    num_added = 0;
+
+    if (window > 0) {
+        entries.resize(window);
+        displays.resize(window);
+    }
+
+    slots = entries.data();
+    num_slots = entries.size();
+}
+
+void DecodedProgram::attach(const DecodedEntry* mapped, std::size_t count, uint32_t new_base, std::size_t num_instructions) {
+    /*
+    * Reads entries in place, only the display references are allocated here
+    */
+
+    reset(new_base);
+
+    attached = true;
+    slots = mapped;
+    num_slots = count;
+    num_added = num_instructions;
+    displays.resize(count);
+}
+
+void DecodedProgram::add(const Instruction& instruction, uint32_t address) {
+
+    if (attached) {
+        std::cerr << "Error: Cannot add to an attached program image." << std::endl;
+        return;
+    }
+
+    if (!has_base) {
+        base = address & ~3u;
+        has_base = true;
+    }
+
+    // Segment below everything so far, shift the image up to start there (whole program mode only)
+    if (address < base) {
+
+        if (window > 0) {
+            std::cerr << "Error: Address " << address << " is below the stream window." << std::endl;
+            return;
+        }
+
+        std::size_t shift = (base - (address & ~3u)) >> 2;
+        entries.insert(entries.begin(), shift, DecodedEntry());
+        displays.insert(displays.begin(), shift, DisplayRef());
+        base = address & ~3u;
+    }
+
+    std::size_t index = (address - base) >> 2;
+
+    if (window > 0) {
+        index %= window;
+    } else if (index >= entries.size()) {
+        entries.resize(index + 1);
+        displays.resize(index + 1);
+    }
+
+    DecodedEntry& entry = entries[index];
+
+    entry.instruction = instruction;
+    entry.address = address;
+    entry.present = 1;
+
+    displays[index] = DisplayRef();
+
+    slots = entries.data();
+    num_slots = entries.size();
+    num_added++;
+}
+
+std::size_t DecodedProgram::slotOf(uint32_t address) const {
+
+    if (!has_base || address < base || ((address - base) & 3) != 0) { return num_slots; }
+
+    std::size_t index = (address - base) >> 2;
+
+    if (window > 0) {
+        index %= window;
+    } else if (index >= num_slots) {
+        return num_slots;
+    }
+
+    // In window mode the slot may hold a different (older or newer) address
+    if (!slots[index].present || slots[index].address != address) { return num_slots; }
+
+    return index;
+}
+
+const Instruction* DecodedProgram::fetch(uint32_t address) const {
+    std::size_t index = slotOf(address);
+    return (index == num_slots) ? nullptr : &slots[index].instruction;
+}
+
+std::string_view DecodedProgram::getDisplayString(uint32_t address) {
+
+    std::size_t index = slotOf(address);
+    if (index == num_slots) { return std::string_view(); }
+
+    DisplayRef& display = displays[index];
+
+    if (!display.formatted) {
+
+        char formatted[MAX_FORMATTED_LENGTH];
+        std::size_t length = std::min(format_new_style(slots[index].instruction, formatted), WINDOW_DISPLAY_BYTES);
+
+        if (window > 0) {
+            display.offset = static_cast<uint32_t>(index * WINDOW_DISPLAY_BYTES);
+        } else {
+            // Start a new chunk rather than split the string
+            if (text_used % TEXT_CHUNK_BYTES + length > TEXT_CHUNK_BYTES) {
+                text_used += TEXT_CHUNK_BYTES - text_used % TEXT_CHUNK_BYTES;
+            }
+            display.offset = static_cast<uint32_t>(text_used);
+            text_used += length;
+        }
+
+        std::copy(formatted, formatted + length, textAt(display.offset));
+        display.length = static_cast<uint16_t>(length);
+        display.formatted = true;
+    }
+
+    return std::string_view(textAt(display.offset), display.length);
+}
+
+char* DecodedProgram::textAt(uint32_t offset) {
+
+    std::size_t chunk = offset / TEXT_CHUNK_BYTES;
+
+    if (chunk >= text_chunks.size()) { text_chunks.resize(chunk + 1); }
+    if (!text_chunks[chunk]) { text_chunks[chunk].reset(new char[TEXT_CHUNK_BYTES]); }
+
+    return text_chunks[chunk].get() + offset % TEXT_CHUNK_BYTES;
+}
+
+const DecodedEntry* DecodedProgram::getEntries() const { return slots; }
+std::size_t DecodedProgram::getNumSlots() const { return num_slots; }
+uint32_t DecodedProgram::getBase() const { return base; }
+bool DecodedProgram::isWindowed() const { return window > 0; }
+
+std::size_t DecodedProgram::size() const { return num_added; }
+
+std::size_t DecodedProgram::getMemoryUsage() const {
+    std::size_t text_bytes = 0;
+    for (const std::unique_ptr<char[]>& chunk : text_chunks) { text_bytes += chunk ? TEXT_CHUNK_BYTES : 0; }
+
+    return entries.capacity() * sizeof(DecodedEntry) + displays.capacity() * sizeof(DisplayRef) + text_bytes;
+}
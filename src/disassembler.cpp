@@ -0,0 +1,303 @@
+#include "../include/disassembler.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <future>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../include/instruction.h"
+#include "../include/lexer.h"
+#include "../include/outputsink.h"
+
+
+namespace {
+
+// Read-only mapping of a whole file, empty files are left unmapped
+struct MappedInput {
+
+    const char* data = nullptr;
+    std::size_t size = 0;
+    bool ok = false;
+
+    explicit MappedInput(const std::string& filename) {
+
+        int fd = open(filename.c_str(), O_RDONLY);
+        if (fd < 0) { return; }
+
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            close(fd);
+            return;
+        }
+
+        size = static_cast<std::size_t>(st.st_size);
+        ok = true;
+
+        if (size > 0) {
+            void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped == MAP_FAILED) {
+                ok = false;
+            } else {
+                data = static_cast<const char*>(mapped);
+            }
+        }
+
+        close(fd);
+    }
+
+    ~MappedInput() {
+        if (data != nullptr) { munmap(const_cast<char*>(data), size); }
+    }
+
+};
+
+// Byte range of the input, always starting at a line start
+struct Chunk {
+    std::size_t begin = 0;
+    std::size_t end = 0;
+    bool last = false;
+    std::size_t first_index = 0; // Index of the chunk's first word in the whole file
+};
+
+bool is_whitespace(char c) { return c == '\n' || c == ' ' || c == '\t'; }
+
+template <typename Visit>
+void scan_words(const MappedInput& input, const Chunk& chunk, Visit visit) {
+    /*
+    * Walks the words of a chunk exactly the way Lexer::consume_instruction does,
+    * including the extra (blank or partial) word read when the file runs out
+    */
+
+    std::size_t position = chunk.begin;
+
+    while (true) {
+
+        while (position < chunk.end && is_whitespace(input.data[position])) { position++; }
+
+        if (position >= chunk.end && !chunk.last) { return; }
+
+        std::size_t remaining = input.size - position;
+
+        if (remaining < 32) {
+            if (!chunk.last) { return; }
+
+            char buff[32] = {0};
+            for (std::size_t i = 0; i < remaining; i++) { buff[i] = input.data[position + i]; }
+            visit(ascii_bits_to_dword_scalar(buff));
+            return;
+        }
+
+        visit(ascii_bits_to_dword(input.data + position));
+        position += 32;
+    }
+
+}
+
+std::vector<Chunk> split_chunks(const MappedInput& input, std::size_t chunk_bytes) {
+    /*
+    * Cuts roughly every chunk_bytes, moving each cut forward past the next newline
+    */
+
+    std::vector<Chunk> chunks;
+    std::size_t begin = 0;
+
+    while (true) {
+
+        Chunk chunk;
+        chunk.begin = begin;
+
+        std::size_t cut = begin + chunk_bytes;
+
+        if (cut >= input.size) {
+            chunk.end = input.size;
+            chunk.last = true;
+            chunks.push_back(chunk);
+            return chunks;
+        }
+
+        const char* newline = static_cast<const char*>(memchr(input.data + cut, '\n', input.size - cut));
+
+        if (newline == nullptr) {
+            chunk.end = input.size;
+            chunk.last = true;
+            chunks.push_back(chunk);
+            return chunks;
+        }
+
+        chunk.end = static_cast<std::size_t>(newline - input.data) + 1;
+        chunks.push_back(chunk);
+        begin = chunk.end;
+    }
+
+}
+
+std::string format_chunk(const MappedInput& input, const Chunk& chunk, int start_position) {
+
+    std::string text;
+    text.reserve((chunk.end - chunk.begin) * 5 / 4 + 64); // Lines come out a bit longer than they go in
+
+    int position = start_position + static_cast<int>(chunk.first_index * 4);
+
+    // Collect the chunk's words, then decode them in one batch
+    std::vector<Dword> words;
+    words.reserve((chunk.end - chunk.begin) / 33 + 1);
+    scan_words(input, chunk, [&words](Dword word) { words.push_back(word); });
+
+    DecodedBatch decoded;
+    decode_batch(words.data(), words.size(), decoded);
+
+    char line[MAX_FORMATTED_LENGTH];
+    for (std::size_t i = 0; i < decoded.size(); i++) {
+        std::size_t length = format_disassembly(decoded.getInstruction(i), position, line);
+        line[length++] = '\n';
+        text.append(line, length);
+        position += 4;
+    }
+
+    return text;
+}
+
+} // namespace
+
+
+
+bool disassemble_file_parallel(const std::string& input, const std::string& output, ThreadPool& pool,
+                               int start_position, std::size_t chunk_bytes) {
+
+    MappedInput mapped(input);
+
+    if (!mapped.ok) {
+        std::cerr << "Error: File [" << input << "] could not be opened." << std::endl;
+        return false;
+    }
+
+    OutputSink sink;
+    if (!sink.open(output.c_str())) {
+        std::cerr << "Error: Output file [" << output << "] could not be opened." << std::endl;
+        return false;
+    }
+
+    if (mapped.data != nullptr) { madvise(const_cast<char*>(mapped.data), mapped.size, MADV_SEQUENTIAL); }
+
+    std::vector<Chunk> chunks = split_chunks(mapped, chunk_bytes);
+
+    // Pass 1: count words per chunk, then prefix sum for each chunk's first index
+    std::vector<std::future<std::size_t>> counts;
+    for (const Chunk& chunk : chunks) {
+        counts.push_back(pool.submit([&mapped, chunk]() {
+            std::size_t count = 0;
+            scan_words(mapped, chunk, [&count](Dword) { count++; });
+            return count;
+        }));
+    }
+
+    std::size_t index = 0;
+    for (std::size_t i = 0; i < chunks.size(); i++) {
+        chunks[i].first_index = index;
+        index += counts[i].get();
+    }
+
+    // Pass 2: format on the pool, write in order, keeping a bounded number of chunks in flight
+    std::size_t max_in_flight = 2 * static_cast<std::size_t>(pool.getNumThreads());
+    std::vector<std::future<std::string>> pending;
+    std::size_t next_submit = 0;
+
+    for (std::size_t next_write = 0; next_write < chunks.size(); next_write++) {
+
+        while (next_submit < chunks.size() && next_submit < next_write + max_in_flight) {
+            const Chunk chunk = chunks[next_submit];
+            pending.push_back(pool.submit([&mapped, chunk, start_position]() {
+                return format_chunk(mapped, chunk, start_position);
+            }));
+            next_submit++;
+        }
+
+        std::string text = pending[next_write].get();
+        sink.write(text.data(), text.size());
+    }
+
+    sink.close();
+
+    return true;
+}
+
+
+bool disassemble_directory_parallel(const std::string& input_dir, const std::string& output_dir, ThreadPool& pool,
+                                    int start_position, std::size_t chunk_bytes) {
+    /*
+    * Small files are done whole, one per task, so many small inputs still use every thread
+    * Large files are chunked one at a time
+    */
+
+    namespace fs = std::filesystem;
+
+    std::error_code error;
+    fs::create_directories(output_dir, error);
+
+    if (error) {
+        std::cerr << "Error: Output directory [" << output_dir << "] could not be created." << std::endl;
+        return false;
+    }
+
+    std::vector<fs::path> inputs;
+    for (const fs::directory_entry& entry : fs::directory_iterator(input_dir, error)) {
+        if (entry.is_regular_file()) { inputs.push_back(entry.path()); }
+    }
+    std::sort(inputs.begin(), inputs.end());
+
+    bool success = !error;
+    std::vector<std::future<bool>> small_files;
+
+    for (const fs::path& path : inputs) {
+
+        std::string output = (fs::path(output_dir) / path.filename()).string();
+
+        if (fs::file_size(path, error) > chunk_bytes) {
+            success = disassemble_file_parallel(path.string(), output, pool, start_position, chunk_bytes) && success;
+            continue;
+        }
+
+        small_files.push_back(pool.submit([path, output, start_position]() {
+
+            MappedInput mapped(path.string());
+            OutputSink sink(64 << 10);
+
+            if (!mapped.ok || !sink.open(output.c_str())) {
+                std::cerr << "Error: Could not disassemble [" << path.string() << "]." << std::endl;
+                return false;
+            }
+
+            Chunk whole;
+            whole.end = mapped.size;
+            whole.last = true;
+
+            std::string text = format_chunk(mapped, whole, start_position);
+            sink.write(text.data(), text.size());
+            sink.close();
+
+            return true;
+        }));
+    }
+
+    for (std::future<bool>& result : small_files) { success = result.get() && success; }
+
+    return success;
+}
+
+
+bool disassemble_parallel(const std::string& input, const std::string& output, unsigned num_threads) {
+
+    ThreadPool pool(num_threads);
+
+    if (std::filesystem::is_directory(input)) {
+        return disassemble_directory_parallel(input, output, pool);
+    }
+
+    return disassemble_file_parallel(input, output, pool);
+}
@@ -0,0 +1,194 @@
+#include "../include/guestmemory.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+
+#include <sys/mman.h>
+
+
+GuestMemory::~GuestMemory() {
+    for (const auto& chunk : chunks) { munmap(chunk.first, chunk.second); }
+}
+
+void GuestMemory::setHugePages(bool enabled) { huge_pages = enabled; }
+
+
+
+
+// MEMORY MAP
+bool GuestMemory::addRegion(const std::string& name, uint32_t base, uint64_t size, bool writable) {
+
+    if (size == 0 || base + size > (uint64_t(1) << 32)) {
+        std::cerr << "Error: Region [" << name << "] does not fit in the address space." << std::endl;
+        return false;
+    }
+
+    for (const MemoryRegion& region : regions) {
+        if (base < region.base + region.size && region.base < base + size) {
+            std::cerr << "Error: Region [" << name << "] overlaps region [" << region.name << "]." << std::endl;
+            return false;
+        }
+    }
+
+    MemoryRegion region;
+    region.name = name;
+    region.base = base;
+    region.size = size;
+    region.writable = writable;
+
+    auto position = std::upper_bound(regions.begin(), regions.end(), base,
+                                     [](uint32_t address, const MemoryRegion& other) { return address < other.base; });
+    regions.insert(position, region);
+    last_region = 0;
+
+    return true;
+}
+
+void GuestMemory::clearRegions() {
+    regions.clear();
+    last_region = 0;
+}
+
+const std::vector<MemoryRegion>& GuestMemory::getRegions() const { return regions; }
+
+bool GuestMemory::findRegion(uint32_t address, uint32_t bytes, bool write) const {
+
+    // Last region starting at or below address
+    auto position = std::upper_bound(regions.begin(), regions.end(), address,
+                                     [](uint32_t value, const MemoryRegion& region) { return value < region.base; });
+    if (position == regions.begin()) { return false; }
+    --position;
+
+    if (!position->contains(address, bytes)) { return false; }
+
+    last_region = static_cast<std::size_t>(position - regions.begin());
+    return !write || position->writable;
+}
+
+
+
+
+// PAGES
+uint8_t* GuestMemory::allocatePage() {
+    /*
+    * Chunks are reserved with MAP_NORESERVE, so the kernel only backs the pages actually written
+    * With huge pages the chunk is aligned to 2 MiB so it can be backed by one
+    */
+
+    if (chunk_next == chunk_end) {
+
+        std::size_t length = huge_pages ? CHUNK_SIZE * 2 : CHUNK_SIZE;
+        void* mapping = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+
+        if (mapping == MAP_FAILED) {
+            std::cerr << "Error: Out of memory for guest pages (" << pages_allocated << " allocated)." << std::endl;
+            std::abort();
+        }
+
+        uint8_t* start = static_cast<uint8_t*>(mapping);
+
+        if (huge_pages) {
+            // Trim to an aligned CHUNK_SIZE window
+            uint8_t* aligned = reinterpret_cast<uint8_t*>((reinterpret_cast<uintptr_t>(start) + CHUNK_SIZE - 1) & ~(CHUNK_SIZE - 1));
+            if (aligned > start) { munmap(start, aligned - start); }
+            if (aligned + CHUNK_SIZE < start + length) { munmap(aligned + CHUNK_SIZE, (start + length) - (aligned + CHUNK_SIZE)); }
+            start = aligned;
+            length = CHUNK_SIZE;
+#ifdef MADV_HUGEPAGE
+            madvise(start, length, MADV_HUGEPAGE);
+#endif
+        }
+
+        chunks.emplace_back(start, length);
+        chunk_next = start;
+        chunk_end = start + length;
+    }
+
+    uint8_t* page = chunk_next;
+    chunk_next += PAGE_SIZE;
+    pages_allocated++;
+
+    return page; // Fresh anonymous memory is already zero
+}
+
+uint8_t* GuestMemory::touchPage(uint32_t address) {
+
+    std::unique_ptr<Leaf>& leaf = root[address >> (PAGE_BITS + LEAF_BITS)];
+
+    if (!leaf) {
+        leaf.reset(new Leaf());
+        leaf->fill(nullptr);
+        leaves_allocated++;
+    }
+
+    uint8_t*& page = (*leaf)[(address >> PAGE_BITS) & ((1u << LEAF_BITS) - 1)];
+    if (page == nullptr) { page = allocatePage(); }
+
+    return page;
+}
+
+bool GuestMemory::readSplit(uint32_t address, void* value, uint32_t bytes) const {
+
+    uint8_t* out = static_cast<uint8_t*>(value);
+
+    for (uint32_t i = 0; i < bytes; i++) {
+        const uint8_t* page = findPage(address + i);
+        out[i] = page ? page[(address + i) & (PAGE_SIZE - 1)] : 0;
+    }
+
+    return true;
+}
+
+bool GuestMemory::writeSplit(uint32_t address, const void* value, uint32_t bytes) {
+
+    const uint8_t* in = static_cast<const uint8_t*>(value);
+
+    for (uint32_t i = 0; i < bytes; i++) {
+        touchPage(address + i)[(address + i) & (PAGE_SIZE - 1)] = in[i];
+    }
+
+    return true;
+}
+
+
+
+
+// UNCHECKED
+void GuestMemory::copyIn(uint32_t address, const uint8_t* bytes, std::size_t count) {
+
+    std::size_t done = 0;
+
+    while (done < count) {
+        uint32_t at = static_cast<uint32_t>(address + done);
+        uint32_t offset = at & (PAGE_SIZE - 1);
+        std::size_t run = std::min<std::size_t>(PAGE_SIZE - offset, count - done);
+        std::memcpy(touchPage(at) + offset, bytes + done, run);
+        done += run;
+    }
+}
+
+uint32_t GuestMemory::peek32(uint32_t address) const {
+
+    uint32_t value = 0;
+
+    if ((address & (PAGE_SIZE - 1)) + 4 > PAGE_SIZE) {
+        readSplit(address, &value, 4);
+        return value;
+    }
+
+    const uint8_t* page = findPage(address);
+    if (page) { std::memcpy(&value, page + (address & (PAGE_SIZE - 1)), 4); }
+
+    return value;
+}
+
+std::size_t GuestMemory::getPagesAllocated() const { return pages_allocated; }
+
+std::size_t GuestMemory::getBytesReserved() const {
+
+    std::size_t bytes = leaves_allocated * sizeof(Leaf);
+    for (const auto& chunk : chunks) { bytes += chunk.second; }
+
+    return bytes;
+}
@@ -0,0 +1,287 @@
+#include "../include/imagecache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+namespace {
+
+const char RVIMG_MAGIC[8] = {'R', 'V', 'I', 'M', 'G', 0, 0, 0};
+
+const uint64_t HASH_K1 = 0x9E3779B97F4A7C15ull;
+const uint64_t HASH_K2 = 0xC2B2AE3D27D4EB4Full;
+
+uint64_t rotate_left(uint64_t value, int bits) { return (value << bits) | (value >> (64 - bits)); }
+
+uint64_t hash_bytes(const char* data, std::size_t size) {
+    /*
+    * Eight bytes per step, multiply/rotate mixing with a final avalanche
+    * Only needs to tell edited sources apart, not resist anyone trying to collide it
+    */
+
+    uint64_t hash = HASH_K1 ^ (size * HASH_K2);
+    std::size_t i = 0;
+
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, data + i, 8);
+        hash ^= rotate_left(word * HASH_K2, 31) * HASH_K1;
+        hash = rotate_left(hash, 27) * HASH_K1 + HASH_K2;
+    }
+
+    uint64_t tail = 0;
+    if (i < size) { std::memcpy(&tail, data + i, size - i); }
+    hash ^= rotate_left(tail * HASH_K2, 31) * HASH_K1;
+
+    hash ^= hash >> 33;
+    hash *= 0xFF51AFD7ED558CCDull;
+    hash ^= hash >> 33;
+    hash *= 0xC4CEB9FE1A85EC53ull;
+    hash ^= hash >> 33;
+
+    return hash;
+}
+
+std::size_t align_up(std::size_t value, std::size_t alignment) { return (value + alignment - 1) & ~(alignment - 1); }
+
+// Read-only mapping of a whole file, empty files are left unmapped
+bool map_file(const std::string& filename, const char*& data, std::size_t& size) {
+
+    data = nullptr;
+    size = 0;
+
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) { return false; }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        ::close(fd);
+        return false;
+    }
+
+    size = static_cast<std::size_t>(st.st_size);
+
+    if (size > 0) {
+        void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED) {
+            ::close(fd);
+            size = 0;
+            return false;
+        }
+        data = static_cast<const char*>(mapping);
+    }
+
+    ::close(fd);
+    return true;
+}
+
+void unmap_file(const char* data, std::size_t size) {
+    if (data != nullptr) { munmap(const_cast<char*>(data), size); }
+}
+
+} // namespace
+
+
+
+bool hash_file(const std::string& filename, uint64_t& hash, uint64_t& size) {
+
+    const char* data = nullptr;
+    std::size_t mapped_size = 0;
+
+    if (!map_file(filename, data, mapped_size)) { return false; }
+
+    if (data != nullptr) { madvise(const_cast<char*>(data), mapped_size, MADV_SEQUENTIAL); }
+
+    hash = hash_bytes(data, mapped_size);
+    size = mapped_size;
+
+    unmap_file(data, mapped_size);
+    return true;
+}
+
+
+
+// READING
+ImageCache::~ImageCache() { close(); }
+
+void ImageCache::close() {
+    unmap_file(mapped, mapped_size);
+    mapped = nullptr;
+    mapped_size = 0;
+    header = nullptr;
+}
+
+bool ImageCache::open(const std::string& cache_file, const std::string& source_file) {
+    /*
+    * Any mismatch (version, layout, ISA, source contents, truncated file) is just a miss
+    */
+
+    close();
+
+    if (!map_file(cache_file, mapped, mapped_size)) { return false; }
+
+    if (mapped_size < sizeof(ImageHeader)) {
+        close();
+        return false;
+    }
+
+    const ImageHeader* candidate = reinterpret_cast<const ImageHeader*>(mapped);
+
+    bool layout_ok = std::memcmp(candidate->magic, RVIMG_MAGIC, sizeof(RVIMG_MAGIC)) == 0 &&
+                     candidate->version == RVIMG_VERSION &&
+                     candidate->entry_size == sizeof(DecodedEntry) &&
+                     candidate->num_exact == ERROR_EXACT_INSTRUCTION + 1u;
+
+    bool bounds_ok = layout_ok &&
+                     candidate->entries_offset + candidate->num_slots * sizeof(DecodedEntry) <= mapped_size &&
+                     candidate->segments_offset <= mapped_size &&
+                     candidate->dis_offset + candidate->dis_size <= mapped_size;
+
+    if (!bounds_ok) {
+        close();
+        return false;
+    }
+
+    uint64_t source_hash = 0;
+    uint64_t source_size = 0;
+
+    if (!hash_file(source_file, source_hash, source_size) ||
+        source_hash != candidate->source_hash || source_size != candidate->source_size) {
+        close();
+        return false;
+    }
+
+    header = candidate;
+    return true;
+}
+
+const DecodedEntry* ImageCache::getEntries() const {
+    return reinterpret_cast<const DecodedEntry*>(mapped + header->entries_offset);
+}
+
+std::size_t ImageCache::getNumSlots() const { return header->num_slots; }
+std::size_t ImageCache::getNumInstructions() const { return header->num_instructions; }
+uint32_t ImageCache::getBase() const { return header->base; }
+const char* ImageCache::getDisText() const { return mapped + header->dis_offset; }
+std::size_t ImageCache::getDisSize() const { return header->dis_size; }
+
+ProgramImage ImageCache::getDataImage() const {
+
+    ProgramImage image;
+    image.entry_point = header->entry_point;
+
+    std::size_t offset = header->segments_offset;
+
+    for (uint64_t i = 0; i < header->num_segments; i++) {
+
+        if (offset + 8 > header->dis_offset) { break; } // Truncated, keep what is complete
+
+        uint32_t address;
+        uint32_t size;
+        std::memcpy(&address, mapped + offset, 4);
+        std::memcpy(&size, mapped + offset + 4, 4);
+        offset += 8;
+
+        if (offset + size > header->dis_offset) { break; }
+
+        LoadedSegment segment;
+        segment.address = address;
+        segment.bytes.assign(mapped + offset, mapped + offset + size);
+        image.segments.push_back(segment);
+
+        offset += align_up(size, 4);
+    }
+
+    return image;
+}
+
+
+
+// WRITING
+bool ImageCache::write(const std::string& cache_file, const std::string& source_file, const DecodedProgram& program,
+                       const ProgramImage& image, const std::string& dis_file) {
+    /*
+    * Written to a temporary name and renamed into place, so a run that reads the cache
+    * while another is writing it sees either the old file or the complete new one
+    */
+
+    if (program.isWindowed()) {
+        std::cerr << "Error: A streamed program cannot be cached." << std::endl;
+        return false;
+    }
+
+    ImageHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, RVIMG_MAGIC, sizeof(RVIMG_MAGIC));
+    header.version = RVIMG_VERSION;
+    header.entry_size = sizeof(DecodedEntry);
+    header.num_exact = ERROR_EXACT_INSTRUCTION + 1u;
+    header.entry_point = image.entry_point;
+
+    if (!hash_file(source_file, header.source_hash, header.source_size)) {
+        std::cerr << "Error: File [" << source_file << "] could not be hashed." << std::endl;
+        return false;
+    }
+
+    const char* dis_text = nullptr;
+    std::size_t dis_size = 0;
+    if (!map_file(dis_file, dis_text, dis_size)) {
+        std::cerr << "Error: Output file [" << dis_file << "] could not be read back for the cache." << std::endl;
+        return false;
+    }
+
+    // Data segments, padded to whole words
+    std::vector<char> segments;
+    for (const LoadedSegment& segment : image.segments) {
+        if (segment.executable) { continue; }
+        uint32_t address = segment.address;
+        uint32_t size = static_cast<uint32_t>(segment.bytes.size());
+        segments.insert(segments.end(), reinterpret_cast<const char*>(&address), reinterpret_cast<const char*>(&address) + 4);
+        segments.insert(segments.end(), reinterpret_cast<const char*>(&size), reinterpret_cast<const char*>(&size) + 4);
+        segments.insert(segments.end(), segment.bytes.begin(), segment.bytes.end());
+        segments.resize(align_up(segments.size(), 4), 0);
+        header.num_segments++;
+    }
+
+    header.base = program.getBase();
+    header.num_slots = program.getNumSlots();
+    header.num_instructions = program.size();
+    header.entries_offset = align_up(sizeof(ImageHeader), 64);
+    header.segments_offset = header.entries_offset + header.num_slots * sizeof(DecodedEntry);
+    header.dis_offset = header.segments_offset + segments.size();
+    header.dis_size = dis_size;
+
+    std::string temporary = cache_file + ".tmp" + std::to_string(getpid());
+    std::ofstream out(temporary, std::ios::out | std::ios::binary | std::ios::trunc);
+
+    if (!out.is_open()) {
+        std::cerr << "Error: Cache file [" << temporary << "] could not be opened." << std::endl;
+        unmap_file(dis_text, dis_size);
+        return false;
+    }
+
+    const char padding[64] = {0};
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(padding, header.entries_offset - sizeof(header));
+    out.write(reinterpret_cast<const char*>(program.getEntries()), header.num_slots * sizeof(DecodedEntry));
+    out.write(segments.data(), segments.size());
+    if (dis_size > 0) { out.write(dis_text, dis_size); }
+    out.close();
+
+    unmap_file(dis_text, dis_size);
+
+    if (!out || std::rename(temporary.c_str(), cache_file.c_str()) != 0) {
+        std::cerr << "Error: Cache file [" << cache_file << "] could not be written." << std::endl;
+        std::remove(temporary.c_str());
+        return false;
+    }
+
+    return true;
+}
@@ -1,36 +1,40 @@
 #include "../include/instruction.h"
 
+#include <charconv>
+#include <cstring>
+#include <string_view>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
 // TO STRING FUNCTIONS
+std::string_view exact_instruction_name(EXACT_INSTRUCTION instruction) {
+    /**
+     * Mnemonic of an exact instruction, straight from the table (no allocation)
+     */
+
+    static constexpr std::string_view mnemonics[] = {
+#define INSTRUCTION(name, mnemonic, opcode, funct3, funct7, format) mnemonic,
+#define ALIAS(name, mnemonic, base, mask, match) mnemonic,
+#include "../include/isa.def"
+#undef INSTRUCTION
+#undef ALIAS
+        "ERROR_EXACT_INSTRUCTION"
+    };
+
+    if (instruction < 0 || instruction > ERROR_EXACT_INSTRUCTION) { return "UNKNOWN_INSTRUCTION"; }
+
+    return mnemonics[instruction];
+}
+
 std::string exact_instruction_to_string(EXACT_INSTRUCTION instruction) {
     /**
      * Converts exact instruction to string
      * Helper method for writing, also great for testing
      */
-    switch (instruction) {
-        case JAL_E: return "JAL";
-        case J: return "J";
-        case JALR_E: return "JALR";
-        case RET: return "RET";
-        case SW: return "SW";
-        case LW: return "LW";
-        case SLT: return "SLT";
-        case SLL: return "SLL";
-        case SRL: return "SRL";
-        case SUB: return "SUB";
-        case ADD: return "ADD";
-        case AND: return "AND";
-        case OR: return "OR";
-        case XOR: return "XOR";
-        case ADDI: return "ADDI";
-        case NOP: return "NOP";
-        case SLTI: return "SLTI";
-        case BEQ: return "BEQ";
-        case BNE: return "BNE";
-        case BGE: return "BGE";
-        case BLT: return "BLT";
-        case ERROR_EXACT_INSTRUCTION: return "ERROR_EXACT_INSTRUCTION";
-        default: return "UNKNOWN_INSTRUCTION";
-    }
+
+    return std::string(exact_instruction_name(instruction));
 }
 
 std::string itype_to_string(INST_TYPE instructionType) {
@@ -45,6 +49,10 @@ std::string itype_to_string(INST_TYPE instructionType) {
         case LOAD: return "LOAD";
         case I_TYPE: return "I_TYPE";
         case BRANCH: return "BRANCH";
+        case LUI: return "LUI";
+        case AUIPC: return "AUIPC";
+        case MISC_MEM: return "MISC_MEM";
+        case SYSTEM: return "SYSTEM";
         default:     return "UNKNOWN_TYPE";
     }
 }
@@ -197,205 +205,546 @@ int32_t get_jalr_imm(Dword instruction) {
     return imm;
 }
 
+int32_t get_u_type_imm(Dword instruction) {
+    /**
+     * LUI/AUIPC's immediate is bits 31-12, left where they are (already shifted by 12)
+     */
+    return static_cast<int32_t>(instruction & 0xFFFFF000);
+}
 
+int32_t get_shift_amount(const Instruction& inst) {
+    /**
+     * The immediate shifts only use imm[4:0], SRAI also sets bit 10 of the immediate
+     */
+    return inst.imm & 0x1F;
+}
 
+bool is_shift_immediate(EXACT_INSTRUCTION instruction) {
+    return instruction == SLLI || instruction == SRLI || instruction == SRAI;
+}
 
 
-// GET EXACT INSTRUCTIONS
-EXACT_INSTRUCTION decompose_IRR(Dword instruction) {
-    
-    // Check funct3
-    Byte funct3 = get_funct3(instruction);
 
-    //std::cout << "Bytes 14-12: " << std::bitset<3>(distinguishing_bits) << std::endl;
 
-    switch (funct3) {
-        case 0: break; //Need to distinguish ADD and SUB
-        case 1: return SLL;
-        case 2: return SLT;
-        case 4: return XOR; 
-        case 5: return SRL;
-        case 6: return OR;
-        case 7: return AND;
-        default: return ERROR_EXACT_INSTRUCTION;
+
+// DECODE TABLES
+/*
+* Built at compile time from isa.def
+*
+* primary is indexed by opcode and funct3. An entry is either the exact instruction, or (SPLIT set)
+* the index of a funct7 table for opcode/funct3 pairs whose instructions differ only in funct7.
+* Aliases (J, RET, NOP) are checked afterwards with one mask/compare on the whole word.
+*/
+namespace {
+
+const int ANY = -1;
+
+struct InstructionSpec {
+    EXACT_INSTRUCTION exact;
+    int opcode;
+    int funct3;
+    int funct7;
+    INST_FORMAT format;
+};
+
+struct AliasSpec {
+    EXACT_INSTRUCTION exact;
+    EXACT_INSTRUCTION base;
+    Dword mask;
+    Dword match;
+};
+
+constexpr InstructionSpec INSTRUCTION_SPECS[] = {
+#define INSTRUCTION(name, mnemonic, opcode, funct3, funct7, format) {name, opcode, funct3, funct7, format},
+#define ALIAS(name, mnemonic, base, mask, match)
+#include "../include/isa.def"
+#undef INSTRUCTION
+#undef ALIAS
+};
+
+constexpr AliasSpec ALIAS_SPECS[] = {
+#define INSTRUCTION(name, mnemonic, opcode, funct3, funct7, format)
+#define ALIAS(name, mnemonic, base, mask, match) {name, base, mask, match},
+#include "../include/isa.def"
+#undef INSTRUCTION
+#undef ALIAS
+};
+
+const std::size_t NUM_EXACT = ERROR_EXACT_INSTRUCTION + 1;
+const std::size_t MAX_SPLITS = 16;
+const uint16_t SPLIT = 0x8000;
+
+struct DecodeTables {
+    uint16_t primary[128 * 8];
+    uint8_t split[MAX_SPLITS][128];
+
+    // Per exact instruction
+    uint8_t format[NUM_EXACT];
+    uint8_t alias[NUM_EXACT];
+    Dword alias_mask[NUM_EXACT];
+    Dword alias_match[NUM_EXACT];
+
+    // Fields are still extracted for unknown encodings of a known opcode
+    uint8_t opcode_format[128];
+};
+
+constexpr bool spec_matches(const InstructionSpec& spec, int opcode, int funct3) {
+    return spec.opcode == opcode && (spec.funct3 == ANY || spec.funct3 == funct3);
+}
+
+constexpr DecodeTables build_decode_tables() {
+
+    DecodeTables tables{};
+    std::size_t num_splits = 0;
+
+    for (std::size_t i = 0; i < NUM_EXACT; i++) {
+        tables.format[i] = NO_FORMAT;
+        tables.alias[i] = static_cast<uint8_t>(i);
+        tables.alias_mask[i] = 0xFFFFFFFF;
+        tables.alias_match[i] = 0; // Never matches a decoded word (opcode 0 is BLANK)
     }
 
-    // Now, we need to extract funct7 (to check if add or sub)
-    Byte funct7 = get_funct7(instruction);
+    for (const InstructionSpec& spec : INSTRUCTION_SPECS) {
+        tables.format[spec.exact] = static_cast<uint8_t>(spec.format);
+        tables.opcode_format[spec.opcode] = static_cast<uint8_t>(spec.format);
+    }
 
-    //std::cout << "Bytes 27-32: " << std::bitset<5>(distinguishing_bits) << std::endl;
+    for (const AliasSpec& alias : ALIAS_SPECS) {
+        tables.format[alias.exact] = tables.format[alias.base];
+        tables.alias[alias.base] = static_cast<uint8_t>(alias.exact);
+        tables.alias_mask[alias.base] = alias.mask;
+        tables.alias_match[alias.base] = alias.match;
+    }
 
-    switch (funct7) {
-        case 0: return ADD; // Need to check ADD or NOP
-        case 8: return SUB;
-        default: return ERROR_EXACT_INSTRUCTION;
+    for (int opcode = 0; opcode < 128; opcode++) {
+        for (int funct3 = 0; funct3 < 8; funct3++) {
+
+            uint16_t entry = ERROR_EXACT_INSTRUCTION;
+
+            // First matching spec that ignores funct7, and whether any spec looks at funct7
+            bool needs_split = false;
+            for (const InstructionSpec& spec : INSTRUCTION_SPECS) {
+                if (!spec_matches(spec, opcode, funct3)) { continue; }
+                if (spec.funct7 != ANY) { needs_split = true; }
+                else if (entry == ERROR_EXACT_INSTRUCTION) { entry = static_cast<uint16_t>(spec.exact); }
+            }
+
+            if (needs_split) {
+
+                // Specific funct7 values win, everything else falls back to the funct7-agnostic entry
+                for (int funct7 = 0; funct7 < 128; funct7++) {
+                    tables.split[num_splits][funct7] = static_cast<uint8_t>(entry);
+                    for (const InstructionSpec& spec : INSTRUCTION_SPECS) {
+                        if (spec_matches(spec, opcode, funct3) && spec.funct7 == funct7) {
+                            tables.split[num_splits][funct7] = static_cast<uint8_t>(spec.exact);
+                            break;
+                        }
+                    }
+                }
+
+                entry = static_cast<uint16_t>(SPLIT | num_splits);
+                num_splits++;
+            }
+
+            tables.primary[(opcode << 3) | funct3] = entry;
+        }
     }
 
-    return ERROR_EXACT_INSTRUCTION;
+    return tables;
 }
 
-EXACT_INSTRUCTION decompose_JALR(Dword instruction) {
-    // RET will be implemented as a specfic case of JALR with  JALR x0, x1, 0
+static_assert(NUM_EXACT <= 256, "Exact instructions must fit in a byte for the decode tables");
 
-    Byte rd = get_rd(instruction);
-    Byte rs1 = get_rs1(instruction);
-    Byte immediate = get_jalr_imm(instruction);
+constexpr DecodeTables DECODE_TABLES = build_decode_tables();
 
-    // For RET we have rd = 0, rs1 = 0x1, immediate = 0
+// The batch decoder picks fields by opcode alone, which needs every instruction of an opcode to share a format
+constexpr bool formats_follow_opcode() {
+    for (const InstructionSpec& spec : INSTRUCTION_SPECS) {
+        if (DECODE_TABLES.opcode_format[spec.opcode] != spec.format) { return false; }
+    }
+    return true;
+}
 
-    //std::cout << "Rd: " << std::bitset<3>(rd) << std::endl;
-    //std::cout << "Rs1: " << std::bitset<3>(rs1) << std::endl;
-    //std::cout << "Immediate: " << std::bitset<5>(immediate) << std::endl;
-    
-    if (rd == 0 && rs1 == 1 && immediate == 0) { return RET; }
+static_assert(formats_follow_opcode(), "Every instruction of an opcode must have the same format in isa.def");
 
-    return JALR_E;
+} // namespace
 
-}
 
-EXACT_INSTRUCTION decompose_I_TYPE(Dword instruction) {
+
+Instruction decode_instruction(Dword value) {
     /*
-    * Decomposes the immediate type instructions (ADDI, SLTI)
+    * Full decode of one word: type, exact instruction and fields
+    * One primary lookup, at most one funct7 lookup, one alias compare
     */
 
-    // We can use the same technique as IRR, as funct3 bits are the distinguishing bits here
-    Byte funct3 = get_funct3(instruction);
+    Instruction decoded;
+
+    decoded.value = value;
+    decoded.type = read_opcode(value);
+    decoded.rs1 = 0;
+    decoded.rs2 = 0;
+    decoded.rd = 0;
+    decoded.imm = 0;
+
+    uint16_t entry = DECODE_TABLES.primary[(value & 0x7F) << 3 | get_funct3(value)];
+    uint8_t exact = (entry & SPLIT) ? DECODE_TABLES.split[entry & 0xFF][get_funct7(value)] : static_cast<uint8_t>(entry);
 
-    switch (funct3) {
-        case 0: break;
-        case 2: return SLTI;
-        default: return ERROR_EXACT_INSTRUCTION;
+    // Aliases
+    if ((value & DECODE_TABLES.alias_mask[exact]) == DECODE_TABLES.alias_match[exact]) {
+        exact = DECODE_TABLES.alias[exact];
     }
 
-    // We break out here because we need to check the special case of ADDI (NOP)
-    Byte rd = get_rd(instruction);
-    Byte rs1 = get_rs1(instruction);
-    Dword immediate = get_i_type_imm(instruction);
+    decoded.instruction = static_cast<EXACT_INSTRUCTION>(exact);
 
-    if (rd == 0 && rs1 == 0 && immediate == 0) { return NOP; }
+    INST_FORMAT format = static_cast<INST_FORMAT>(exact == ERROR_EXACT_INSTRUCTION
+                                                  ? DECODE_TABLES.opcode_format[value & 0x7F]
+                                                  : DECODE_TABLES.format[exact]);
 
-    return ADDI;
+    // Populate the fields the format has
+    switch (format) {
+        case R_FORMAT:
+            decoded.rd = get_rd(value);
+            decoded.rs1 = get_rs1(value);
+            decoded.rs2 = get_rs2(value);
+            break;
+        case I_FORMAT:
+            decoded.rd = get_rd(value);
+            decoded.rs1 = get_rs1(value);
+            decoded.imm = get_i_type_imm(value);
+            break;
+        case S_FORMAT:
+            decoded.rs1 = get_rs1(value);
+            decoded.rs2 = get_rs2(value);
+            decoded.imm = get_s_type_imm(value);
+            break;
+        case B_FORMAT:
+            decoded.rs1 = get_rs1(value);
+            decoded.rs2 = get_rs2(value);
+            decoded.imm = get_b_type_imm(value);
+            break;
+        case J_FORMAT:
+            decoded.rd = get_rd(value);
+            decoded.imm = get_jal_imm(value);
+            break;
+        case U_FORMAT:
+            decoded.rd = get_rd(value);
+            decoded.imm = get_u_type_imm(value);
+            break;
+        default:
+            break;
+    }
+
+    return decoded;
+}
+
+INST_FORMAT get_instruction_format(EXACT_INSTRUCTION instruction) {
+    if (instruction < 0 || instruction > ERROR_EXACT_INSTRUCTION) { return NO_FORMAT; }
+    return static_cast<INST_FORMAT>(DECODE_TABLES.format[instruction]);
+}
+
+
+
+// BATCH DECODING
+void DecodedBatch::resize(std::size_t count) {
+    value.resize(count);
+    opcode.resize(count);
+    rd.resize(count);
+    rs1.resize(count);
+    rs2.resize(count);
+    imm.resize(count);
+    exact.resize(count);
+}
+
+Instruction DecodedBatch::getInstruction(std::size_t index) const {
+
+    Instruction decoded;
 
+    decoded.value = value[index];
+    decoded.type = static_cast<INST_TYPE>(opcode[index]);
+    decoded.instruction = static_cast<EXACT_INSTRUCTION>(exact[index]);
+    decoded.rd = rd[index];
+    decoded.rs1 = rs1[index];
+    decoded.rs2 = rs2[index];
+    decoded.imm = imm[index];
+
+    return decoded;
+}
+
+namespace {
+
+void decode_into_batch(Dword word, DecodedBatch& batch, std::size_t index) {
+    Instruction decoded = decode_instruction(word);
+    batch.value[index] = word;
+    batch.opcode[index] = get_opcode(word);
+    batch.rd[index] = static_cast<uint8_t>(decoded.rd);
+    batch.rs1[index] = static_cast<uint8_t>(decoded.rs1);
+    batch.rs2[index] = static_cast<uint8_t>(decoded.rs2);
+    batch.imm[index] = decoded.imm;
+    batch.exact[index] = static_cast<uint8_t>(decoded.instruction);
 }
 
-EXACT_INSTRUCTION decompose_BRANCH(Dword instruction) {
+} // namespace
+
+void decode_batch_scalar(const Dword* words, std::size_t count, DecodedBatch& batch) {
     /*
-    * Decomposes the branch type instructions (BGE, BNE, BEQ, BLT)
+    * Reference path (and the tail of the AVX2 path): one decode_instruction per word
     */
 
-   // We can use the same technique as IRR, as funct3 bits are the distinguishing bits here
-    Dword funct3 = get_funct3(instruction);
+    batch.resize(count);
 
-    switch (funct3) { 
-        case 0: return BEQ;
-        case 1: return BNE;
-        case 4: return BLT;
-        case 5: return BGE;
-        default: break;
+    for (std::size_t i = 0; i < count; i++) {
+        decode_into_batch(words[i], batch, i);
     }
-    
-    return ERROR_EXACT_INSTRUCTION;
 }
 
-EXACT_INSTRUCTION decompose_JAL_J(Dword instruction) {
-    /*
-    * Decomposes the special case JAL and J
-    */
+#if defined(__AVX2__)
+
+namespace {
+
+const int32_t HAS_RD = 0x100;
+const int32_t HAS_RS1 = 0x200;
+const int32_t HAS_RS2 = 0x400;
+
+// DECODE_TABLES widened to 32 bit entries, since gathers load whole dwords
+struct GatherTables {
+    int32_t primary[128 * 8];
+    int32_t split[MAX_SPLITS * 128];
+    int32_t alias[NUM_EXACT];
+    int32_t alias_mask[NUM_EXACT];
+    int32_t alias_match[NUM_EXACT];
+    int32_t opcode_info[128]; // Format in the low byte, HAS_* bits above it
+};
+
+constexpr GatherTables build_gather_tables() {
 
-   Byte rd = get_rd(instruction);
+    GatherTables tables{};
 
-   if (rd == 0) { return J; }
-   
-   return JAL_E;
+    for (std::size_t i = 0; i < 128 * 8; i++) { tables.primary[i] = DECODE_TABLES.primary[i]; }
 
+    for (std::size_t i = 0; i < MAX_SPLITS * 128; i++) { tables.split[i] = DECODE_TABLES.split[i / 128][i % 128]; }
+
+    for (std::size_t i = 0; i < NUM_EXACT; i++) {
+        tables.alias[i] = DECODE_TABLES.alias[i];
+        tables.alias_mask[i] = static_cast<int32_t>(DECODE_TABLES.alias_mask[i]);
+        tables.alias_match[i] = static_cast<int32_t>(DECODE_TABLES.alias_match[i]);
+    }
+
+    for (std::size_t i = 0; i < 128; i++) {
+        int32_t format = DECODE_TABLES.opcode_format[i];
+        int32_t fields = 0;
+        switch (format) {
+            case R_FORMAT: fields = HAS_RD | HAS_RS1 | HAS_RS2; break;
+            case I_FORMAT: fields = HAS_RD | HAS_RS1; break;
+            case S_FORMAT:
+            case B_FORMAT: fields = HAS_RS1 | HAS_RS2; break;
+            case J_FORMAT:
+            case U_FORMAT: fields = HAS_RD; break;
+            default: break;
+        }
+        tables.opcode_info[i] = format | fields;
+    }
+
+    return tables;
 }
 
-EXACT_INSTRUCTION decompose_types(Dword instruction, INST_TYPE type) {
+constexpr GatherTables GATHER_TABLES = build_gather_tables();
+
+void store_low_bytes(uint8_t* out, __m256i lanes) {
     /*
-    * Takes in an instruction type and the uint32 containing it, decomposes the type given by the opcode
-    * into a precise instruction
+    * Low byte of each of the 8 lanes -> 8 consecutive bytes
     */
+    const __m256i pick = _mm256_setr_epi8(0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                                          0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    __m256i packed = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(lanes, pick), _mm256_setr_epi32(0, 4, 0, 0, 0, 0, 0, 0));
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(out), _mm256_castsi256_si128(packed));
+}
 
-   switch (type) {
-        case IRR: return decompose_IRR(instruction);
-        case JALR: return decompose_JALR(instruction);
-        case JAL: return decompose_JAL_J(instruction);
-        case STORE: return SW;  // For these, we know that the only possible opcode is given here
-        case LOAD: return LW;
-        case I_TYPE: return decompose_I_TYPE(instruction);
-        case BRANCH: return decompose_BRANCH(instruction);
-        default: return ERROR_EXACT_INSTRUCTION;
-   }
+__m256i has_field(__m256i info, int32_t field) {
+    __m256i bit = _mm256_set1_epi32(field);
+    return _mm256_cmpeq_epi32(_mm256_and_si256(info, bit), bit);
 }
 
+} // namespace
 
+void decode_batch(const Dword* words, std::size_t count, DecodedBatch& batch) {
+    /*
+    * 8 words per iteration: fields by shift and mask, the exact instruction by gathering from
+    * the decode tables, aliases and funct7 splits by compare and blend. Immediates for every
+    * format are computed and the right one is selected per lane.
+    */
 
-// POPULATE THE VALUES (REGISTERS) FOR YOUR INSTRUCTION
-Instruction get_populated_instruction(Dword instruction, INST_TYPE type) {
-    
-    // Create variable to hold instruction
-    Instruction dummy;
-    
-    // Give initialized values
-    dummy.value = instruction;
-    dummy.rs1 = 0;
-    dummy.rs2 = 0;
-    dummy.rd = 0;
-    dummy.imm = 0;
-
-    // Determine which values are needed based on the instruction type
-    switch (type) {
-        case JAL:
-            dummy.rd = get_rd(instruction);
-            dummy.imm = get_jal_imm(instruction);
-            break;
-        case JALR:
-            dummy.rd = get_rd(instruction);
-            dummy.rs1 = get_rs1(instruction);
-            dummy.imm = get_i_type_imm(instruction);
-            break;
-        case IRR:  // Integer Register-Register (R-type)
-            dummy.rd = get_rd(instruction);
-            dummy.rs1 = get_rs1(instruction);
-            dummy.rs2 = get_rs2(instruction);
-            break;
-        case STORE:  // S-Type
-            dummy.rs1 = get_rs1(instruction);
-            dummy.rs2 = get_rs2(instruction);
-            dummy.imm = get_s_type_imm(instruction);
-            break;
-        case LOAD:  // I-Type (Load)
-            dummy.rd = get_rd(instruction);
-            dummy.rs1 = get_rs1(instruction);
-            dummy.imm = get_i_type_imm(instruction);
-            break;
-        case I_TYPE:  // Immediate (ADDI, etc.)
-            dummy.rd = get_rd(instruction);
-            dummy.rs1 = get_rs1(instruction);
-            dummy.imm = get_i_type_imm(instruction);
-            break;
-        case BRANCH:  // B-Type (BEQ, BNE, etc.)
-            dummy.rs1 = get_rs1(instruction);
-            dummy.rs2 = get_rs2(instruction);
-            dummy.imm = get_b_type_imm(instruction);
-            break;
-        default:
-            break;
+    batch.resize(count);
+
+    const __m256i five_bits = _mm256_set1_epi32(0x1F);
+    const __m256i seven_bits = _mm256_set1_epi32(0x7F);
+    const __m256i split_bit = _mm256_set1_epi32(SPLIT);
+
+    std::size_t i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+
+        __m256i w = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(words + i));
+
+        __m256i opcode = _mm256_and_si256(w, seven_bits);
+        __m256i funct3 = _mm256_and_si256(_mm256_srli_epi32(w, 12), _mm256_set1_epi32(0x7));
+        __m256i funct7 = _mm256_srli_epi32(w, 25);
+        __m256i rd = _mm256_and_si256(_mm256_srli_epi32(w, 7), five_bits);
+        __m256i rs1 = _mm256_and_si256(_mm256_srli_epi32(w, 15), five_bits);
+        __m256i rs2 = _mm256_and_si256(_mm256_srli_epi32(w, 20), five_bits);
+
+        // Exact instruction
+        __m256i entry = _mm256_i32gather_epi32(GATHER_TABLES.primary, _mm256_or_si256(_mm256_slli_epi32(opcode, 3), funct3), 4);
+        __m256i exact = entry;
+
+        __m256i is_split = _mm256_cmpeq_epi32(_mm256_and_si256(entry, split_bit), split_bit);
+        if (!_mm256_testz_si256(is_split, is_split)) {
+            __m256i split_index = _mm256_or_si256(_mm256_slli_epi32(_mm256_and_si256(entry, _mm256_set1_epi32(0xFF)), 7), funct7);
+            exact = _mm256_mask_i32gather_epi32(exact, GATHER_TABLES.split, split_index, is_split, 4);
+        }
+
+        __m256i alias_mask = _mm256_i32gather_epi32(GATHER_TABLES.alias_mask, exact, 4);
+        __m256i alias_match = _mm256_i32gather_epi32(GATHER_TABLES.alias_match, exact, 4);
+        __m256i is_alias = _mm256_cmpeq_epi32(_mm256_and_si256(w, alias_mask), alias_match);
+        exact = _mm256_blendv_epi8(exact, _mm256_i32gather_epi32(GATHER_TABLES.alias, exact, 4), is_alias);
+
+        __m256i info = _mm256_i32gather_epi32(GATHER_TABLES.opcode_info, opcode, 4);
+
+        // Immediates (arithmetic shifts do the sign extension)
+        __m256i i_imm = _mm256_srai_epi32(w, 20);
+        __m256i s_imm = _mm256_or_si256(_mm256_slli_epi32(_mm256_srai_epi32(w, 25), 5), rd); // Also the B layout used here
+        __m256i j_imm = _mm256_or_si256(
+            _mm256_or_si256(_mm256_and_si256(_mm256_srai_epi32(w, 11), _mm256_set1_epi32(static_cast<int32_t>(0xFFF00000))),
+                            _mm256_and_si256(w, _mm256_set1_epi32(0xFF000))),
+            _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi32(w, 9), _mm256_set1_epi32(0x800)),
+                            _mm256_and_si256(_mm256_srli_epi32(w, 20), _mm256_set1_epi32(0x7FE))));
+        __m256i u_imm = _mm256_and_si256(w, _mm256_set1_epi32(static_cast<int32_t>(0xFFFFF000)));
+
+        __m256i format = _mm256_and_si256(info, _mm256_set1_epi32(0xFF));
+        __m256i is_i = _mm256_cmpeq_epi32(format, _mm256_set1_epi32(I_FORMAT));
+        __m256i is_s = _mm256_or_si256(_mm256_cmpeq_epi32(format, _mm256_set1_epi32(S_FORMAT)),
+                                       _mm256_cmpeq_epi32(format, _mm256_set1_epi32(B_FORMAT)));
+        __m256i is_j = _mm256_cmpeq_epi32(format, _mm256_set1_epi32(J_FORMAT));
+        __m256i is_u = _mm256_cmpeq_epi32(format, _mm256_set1_epi32(U_FORMAT));
+
+        __m256i imm = _mm256_and_si256(i_imm, is_i);
+        imm = _mm256_blendv_epi8(imm, s_imm, is_s);
+        imm = _mm256_blendv_epi8(imm, j_imm, is_j);
+        imm = _mm256_blendv_epi8(imm, u_imm, is_u);
+
+        // Fields the format has
+        rd = _mm256_and_si256(rd, has_field(info, HAS_RD));
+        rs1 = _mm256_and_si256(rs1, has_field(info, HAS_RS1));
+        rs2 = _mm256_and_si256(rs2, has_field(info, HAS_RS2));
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(batch.value.data() + i), w);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(batch.imm.data() + i), imm);
+        store_low_bytes(batch.opcode.data() + i, opcode);
+        store_low_bytes(batch.rd.data() + i, rd);
+        store_low_bytes(batch.rs1.data() + i, rs1);
+        store_low_bytes(batch.rs2.data() + i, rs2);
+        store_low_bytes(batch.exact.data() + i, exact);
+    }
+
+    // Tail
+    for (; i < count; i++) {
+        decode_into_batch(words[i], batch, i);
     }
-    
-    return dummy;
 }
 
+#else
+
+void decode_batch(const Dword* words, std::size_t count, DecodedBatch& batch) {
+    decode_batch_scalar(words, count, batch);
+}
+
+#endif
+
 
 
 // PRINTING HELPER FUNCTIONS
+namespace {
+
+// "00000000" to "11111111", most significant bit first
+struct ByteBitTable {
+    char bits[256][8];
+
+    constexpr ByteBitTable() : bits() {
+        for (int byte = 0; byte < 256; byte++) {
+            for (int bit = 0; bit < 8; bit++) { bits[byte][bit] = ((byte >> (7 - bit)) & 1) ? '1' : '0'; }
+        }
+    }
+};
+
+constexpr ByteBitTable BYTE_BITS;
+
+// Appends to a caller provided buffer, never past MAX_FORMATTED_LENGTH
+struct LineWriter {
+    char* buffer;
+    std::size_t length = 0;
+
+    explicit LineWriter(char* buffer) : buffer(buffer) {}
+
+    void put(char c) { buffer[length++] = c; }
+
+    void put(std::string_view text) {
+        std::memcpy(buffer + length, text.data(), text.size());
+        length += text.size();
+    }
+
+    void spaces(int count) { while (count-- > 0) { put(' '); } }
+
+    void number(int64_t value) {
+        std::to_chars_result result = std::to_chars(buffer + length, buffer + MAX_FORMATTED_LENGTH, value);
+        length = static_cast<std::size_t>(result.ptr - buffer);
+    }
+
+    void reg(uint8_t index, char prefix) {
+        put(prefix);
+        number(index);
+    }
+
+    // #imm, with the sign in front of the # (ie -#8)
+    void immediate(int32_t imm) {
+        int64_t magnitude = imm;
+        if (magnitude < 0) {
+            put('-');
+            magnitude = -magnitude;
+        }
+        put('#');
+        number(magnitude);
+    }
+
+    // Binary split into the fields 6 6 5 3 5 7
+    void binaryFields(Dword value) {
+        char bits[32];
+        std::memcpy(bits, BYTE_BITS.bits[(value >> 24) & 0xFF], 8);
+        std::memcpy(bits + 8, BYTE_BITS.bits[(value >> 16) & 0xFF], 8);
+        std::memcpy(bits + 16, BYTE_BITS.bits[(value >> 8) & 0xFF], 8);
+        std::memcpy(bits + 24, BYTE_BITS.bits[value & 0xFF], 8);
+
+        put(std::string_view(bits, 6)); put(' ');
+        put(std::string_view(bits + 6, 6)); put(' ');
+        put(std::string_view(bits + 12, 5)); put(' ');
+        put(std::string_view(bits + 17, 3)); put(' ');
+        put(std::string_view(bits + 20, 5)); put(' ');
+        put(std::string_view(bits + 25, 7));
+    }
+
+    // Mnemonic padded to 6 columns, long names (ie ERROR_EXACT_INSTRUCTION) still get one space
+    void mnemonic(EXACT_INSTRUCTION instruction) {
+        std::string_view name = exact_instruction_name(instruction);
+        put(name);
+        spaces(std::max(6 - static_cast<int>(name.size()), 1));
+    }
+};
+
+} // namespace
+
 std::string register_to_string(Byte reg) {
     /*
     * Register to string (prepend x)
     */
-    std::ostringstream ss;
-    ss << "x" << reg;
-    return ss.str();
+    return "x" + std::to_string(reg);
 }
 
 std::string to_binary_string(Dword value, int bits) {
@@ -405,160 +754,209 @@ std::string to_binary_string(Dword value, int bits) {
     std::bitset<32> b(value);
     return b.to_string().substr(32 - bits, bits);
 }
-std::string instruction_to_string(Instruction inst, int position, bool isBlank) {
+
+std::size_t format_instruction(const Instruction& inst, int position, bool isBlank, char* buffer) {
     /*
     * Takes an instruction and our position in a file
     * Pretty prints it as a decompiled version, as shown in example
     */
 
-    std::ostringstream ss;
+    LineWriter out(buffer);
 
-    // Handle blank instruction
+    // Handle blank instruction: 32 zeros, the position and "0"
     if (isBlank) {
-        std::ostringstream ss;
-
-        // Output 32-bit zeros
-        ss << "00000000000000000000000000000000";
-
-        // Append the position and "0"
-        ss << "\t" << position << "\t0";
-
-        return ss.str();
+        out.put("00000000000000000000000000000000\t");
+        out.number(position);
+        out.put("\t0");
+        return out.length;
     }
 
-    // Stringstream to pretty print the binary
-    std::string binary_str = to_binary_string(inst.value, 32);
-    ss << binary_str.substr(0, 6) << " " << binary_str.substr(6, 6) << " "
-       << binary_str.substr(12, 5) << " " << binary_str.substr(17, 3) << " "
-       << binary_str.substr(20, 5) << " " << binary_str.substr(25, 7);
+    out.binaryFields(inst.value);
 
-    // Position
-    ss << "\t" << position;
-
-    // Exact Instruction with aligned formatting
-    ss << "\t" << exact_instruction_to_string(inst.instruction);
+    out.put('\t');
+    out.number(position);
+    out.put('\t');
 
     /**
      * This stuff is really not super useful. I just want to make the "diff" match since that's how grading is done.
      */
 
-    // Spacing adjustment
-    std::string mnemonic = exact_instruction_to_string(inst.instruction);
-    int padding = 6 - mnemonic.length(); // Padding adjustment
-    ss << std::string(padding, ' ');
+    // FENCE, ECALL and EBREAK have no operands (and no padding after the mnemonic)
+    if (inst.type == MISC_MEM || inst.type == SYSTEM) {
+        out.put(exact_instruction_name(inst.instruction));
+        return out.length;
+    }
+
+    out.mnemonic(inst.instruction);
 
     // Params
     switch (inst.type) {
         case IRR:  // R-Type
-            ss << register_to_string(inst.rd) << ", "
-               << register_to_string(inst.rs1) << ", "
-               << register_to_string(inst.rs2);
+            out.reg(inst.rd, 'x'); out.put(", ");
+            out.reg(inst.rs1, 'x'); out.put(", ");
+            out.reg(inst.rs2, 'x');
             break;
         case I_TYPE:  // I-Type
-            ss << register_to_string(inst.rd) << ", "
-               << register_to_string(inst.rs1) << ", "
-               << inst.imm;
+        case JALR:  // I-Type (JALR)
+            out.reg(inst.rd, 'x'); out.put(", ");
+            out.reg(inst.rs1, 'x'); out.put(", ");
+            out.number(is_shift_immediate(inst.instruction) ? get_shift_amount(inst) : inst.imm);
+            break;
+        case LUI:  // U-Type, the 20 bit immediate as written (ie LUI x5, 74565)
+        case AUIPC:
+            out.reg(inst.rd, 'x'); out.put(", ");
+            out.number(static_cast<uint32_t>(inst.imm) >> 12);
             break;
         case LOAD:  // Load (I-Type)
-            ss << register_to_string(inst.rd) << ", "
-               << inst.imm << "(" << register_to_string(inst.rs1) << ")";
+            out.reg(inst.rd, 'x'); out.put(", ");
+            out.number(inst.imm); out.put('('); out.reg(inst.rs1, 'x'); out.put(')');
             break;
         case STORE:  // Store (S-Type)
-            ss << register_to_string(inst.rs2) << ", "
-               << inst.imm << "(" << register_to_string(inst.rs1) << ")";
+            out.reg(inst.rs2, 'x'); out.put(", ");
+            out.number(inst.imm); out.put('('); out.reg(inst.rs1, 'x'); out.put(')');
             break;
         case BRANCH:  // B-Type
-            ss << register_to_string(inst.rs1) << ", "
-               << register_to_string(inst.rs2) << ", "
-               //<< std::bitset<30>(inst.imm);
-               << inst.imm;
+            out.reg(inst.rs1, 'x'); out.put(", ");
+            out.reg(inst.rs2, 'x'); out.put(", ");
+            out.number(inst.imm);
             break;
         case JAL:  // J-Type (JAL)
-            ss << register_to_string(inst.rd) << ", "
-               << inst.imm;
-            break;
-        case JALR:  // I-Type (JALR)
-            ss << register_to_string(inst.rd) << ", "
-               << register_to_string(inst.rs1) << ", "
-               << inst.imm;
+            out.reg(inst.rd, 'x'); out.put(", ");
+            out.number(inst.imm);
             break;
         default:
-            ss << "UNKNOWN";
+            out.put("UNKNOWN");
             break;
     }
 
-    return ss.str();
+    return out.length;
 }
 
-
-std::string handle_special_case(Instruction inst, EXACT_INSTRUCTION type, int position) {
+std::size_t format_special_case(const Instruction& inst, EXACT_INSTRUCTION type, int position, char* buffer) {
     /*
     * We need a helper function to handle the special cases that can arise from our custom instructions
     * These being J, NOP, and RET
     */
 
-    std::ostringstream ss;
-
-    // First, split into parts the same way as normal
-    std::string binary_str = to_binary_string(inst.value, 32);
-
-    ss << binary_str.substr(0, 6) << " " << binary_str.substr(6, 6) << " "
-       << binary_str.substr(12, 5) << " " << binary_str.substr(17, 3) << " "
-       << binary_str.substr(20, 5) << " " << binary_str.substr(25, 7);
-
-    // I realize the above could be its own function, but this is done for simplicity's sake
-    // For such an important assignment, I want to avoid using memory allocation as this exposes me to potential segfaults
-
-    // Append the position
-    ss << "\t" << position;
+    LineWriter out(buffer);
 
+    out.binaryFields(inst.value);
 
+    out.put('\t');
+    out.number(position);
 
     switch (type) {
         case J: 
-            ss << "\tJ\t#" << (position + inst.imm); // Address relative to position
-            ss << "  //JAL x0, " << inst.imm; // Comment for J
+            out.put("\tJ\t#");
+            out.number(static_cast<int64_t>(position) + inst.imm); // Address relative to position
+            out.put("  //JAL x0, "); // Comment for J
+            out.number(inst.imm);
             break;
         case NOP:
-            ss << "\tNOP";
-            ss << "\t\t//ADDI x0, x0, 0";
+            out.put("\tNOP\t\t//ADDI x0, x0, 0");
             break;
         case RET:
-            ss << "\tRET";
-            ss << "\t\t//JALR x0, x1, 0";
+            out.put("\tRET\t\t//JALR x0, x1, 0");
             break;
         default:
-            ss << "ERROR"; // An instruction that isn't of one of these types should never even be passed to this function
+            out.put("ERROR"); // An instruction that isn't of one of these types should never even be passed to this function
     }
 
-    return ss.str();
-
+    return out.length;
 }
 
+std::size_t format_disassembly(const Instruction& inst, int position, char* buffer) {
+    /*
+    * One line of "dis" output: blank words, the J/NOP/RET aliases, or the normal format
+    */
 
-std::string instruction_to_new_style_string(Instruction inst) {
-
-    // Result of the function fixes the istring
+    if (inst.type == BLANK) { return format_instruction(inst, position, true, buffer); }
 
-    std::string input = instruction_to_string(inst, 500, false);
+    EXACT_INSTRUCTION exact_instruction = inst.instruction;
 
-    // Remove trailing newline, if it exists
-    if (!input.empty() && input.back() == '\n') {
-        input.pop_back();
+    if (exact_instruction == RET || exact_instruction == NOP || exact_instruction == J) {
+        return format_special_case(inst, exact_instruction, position, buffer);
     }
 
-    input = std::regex_replace(input, std::regex(R"(x(\d+))"), "R$1");
+    return format_instruction(inst, position, false, buffer);
+}
+
+std::size_t format_new_style(const Instruction& inst, char* buffer) {
+    /*
+    * The operand part of the dis line (mnemonic, padding, operands) with registers as R<n>
+    * Immediates get a # prefix, memory offsets don't (LW R1, 4(R2))
+    */
+
+    LineWriter out(buffer);
 
-    // Replace immediate values with "#" prefix
-    if (inst.getExactInstruction() != LW && inst.getExactInstruction() != SW) {
-        input = std::regex_replace(input, std::regex(R"(\b(\d+)\b)"), "#$1");
+    if (inst.type == MISC_MEM || inst.type == SYSTEM) {
+        out.put(exact_instruction_name(inst.instruction));
+        return out.length;
     }
 
-    // Remove everything before the last tab
-    size_t lastTab = input.find_last_of('\t');
-    if (lastTab != std::string::npos) {
-        input = input.substr(lastTab + 1);
+    out.mnemonic(inst.instruction);
+
+    switch (inst.type) {
+        case IRR:
+            out.reg(inst.rd, 'R'); out.put(", ");
+            out.reg(inst.rs1, 'R'); out.put(", ");
+            out.reg(inst.rs2, 'R');
+            break;
+        case I_TYPE:
+        case JALR:
+            out.reg(inst.rd, 'R'); out.put(", ");
+            out.reg(inst.rs1, 'R'); out.put(", ");
+            out.immediate(is_shift_immediate(inst.instruction) ? get_shift_amount(inst) : inst.imm);
+            break;
+        case LUI:
+        case AUIPC:
+            out.reg(inst.rd, 'R'); out.put(", ");
+            out.immediate(static_cast<int32_t>(static_cast<uint32_t>(inst.imm) >> 12));
+            break;
+        case LOAD:
+            out.reg(inst.rd, 'R'); out.put(", ");
+            out.number(inst.imm); out.put('('); out.reg(inst.rs1, 'R'); out.put(')');
+            break;
+        case STORE:
+            out.reg(inst.rs2, 'R'); out.put(", ");
+            out.number(inst.imm); out.put('('); out.reg(inst.rs1, 'R'); out.put(')');
+            break;
+        case BRANCH:
+            out.reg(inst.rs1, 'R'); out.put(", ");
+            out.reg(inst.rs2, 'R'); out.put(", ");
+            out.immediate(inst.imm);
+            break;
+        case JAL:
+            out.reg(inst.rd, 'R'); out.put(", ");
+            out.immediate(inst.imm);
+            break;
+        default:
+            out.put("UNKNOWN");
+            break;
     }
 
-    return input;
-}
\ No newline at end of file
+    return out.length;
+}
+
+
+
+// STRING WRAPPERS, FOR CALLERS THAT WANT A std::string ANYWAY
+std::string instruction_to_string(Instruction inst, int position, bool isBlank) {
+    char buffer[MAX_FORMATTED_LENGTH];
+    return std::string(buffer, format_instruction(inst, position, isBlank, buffer));
+}
+
+std::string handle_special_case(Instruction inst, EXACT_INSTRUCTION type, int position) {
+    char buffer[MAX_FORMATTED_LENGTH];
+    return std::string(buffer, format_special_case(inst, type, position, buffer));
+}
+
+std::string disassemble_instruction(Instruction inst, int position) {
+    char buffer[MAX_FORMATTED_LENGTH];
+    return std::string(buffer, format_disassembly(inst, position, buffer));
+}
+
+std::string instruction_to_new_style_string(Instruction inst) {
+    char buffer[MAX_FORMATTED_LENGTH];
+    return std::string(buffer, format_new_style(inst, buffer));
+}
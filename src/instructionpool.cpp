@@ -0,0 +1,40 @@
+#include "../include/instructionpool.h"
+#include "../include/log.h"
+
+
+InstructionPool::InstructionPool() {
+
+    // Lowest slots are handed out first
+    for (std::size_t i = 0; i < CAPACITY; i++) {
+        free_slots[i] = static_cast<InstructionSlot>(CAPACITY - 1 - i);
+    }
+    free_count = CAPACITY;
+}
+
+InstructionSlot InstructionPool::acquire(const Instruction& instruction, uint32_t address) {
+
+    if (free_count == 0) {
+        LOG_ERROR("Error: No free instruction slot, " << CAPACITY << " are already in flight.");
+        return NO_SLOT;
+    }
+
+    InstructionSlot slot = free_slots[--free_count];
+    slots[slot] = instruction;
+    addresses[slot] = address;
+
+    return slot;
+}
+
+void InstructionPool::release(InstructionSlot slot) {
+
+    if (slot == NO_SLOT) { return; }
+
+    if (slot >= CAPACITY || free_count == CAPACITY) {
+        LOG_ERROR("Error: Releasing instruction slot " << static_cast<int>(slot) << " that is not in use.");
+        return;
+    }
+
+    free_slots[free_count++] = slot;
+}
+
+std::size_t InstructionPool::inUse() const { return CAPACITY - free_count; }
@@ -0,0 +1,87 @@
+#include "../include/instructionstream.h"
+
+
+// CONSTRUCTORS
+InstructionStream::InstructionStream(std::size_t capacity) {
+
+    // Power of two so wrapping is a mask instead of a modulo
+    std::size_t size = 1;
+    while (size < capacity) { size <<= 1; }
+
+    buffer.resize(size);
+    mask = size - 1;
+}
+
+InstructionStream::~InstructionStream() { drain(); }
+
+
+
+void InstructionStream::start(std::function<void(InstructionStream&)> producer) {
+
+    producer_thread = std::thread([this, producer]() {
+        producer(*this);
+        finished.store(true, std::memory_order_release);
+    });
+
+}
+
+
+
+// PRODUCER
+void InstructionStream::push(StreamedInstruction item) {
+
+    std::size_t current_tail = tail.load(std::memory_order_relaxed);
+
+    // Full, wait for the consumer to catch up
+    while (current_tail - head.load(std::memory_order_acquire) == buffer.size()) {
+        std::this_thread::yield();
+    }
+
+    buffer[current_tail & mask] = std::move(item);
+    tail.store(current_tail + 1, std::memory_order_release);
+
+}
+
+
+
+// CONSUMER
+bool InstructionStream::tryPop(StreamedInstruction& item) {
+
+    std::size_t current_head = head.load(std::memory_order_relaxed);
+
+    if (current_head == tail.load(std::memory_order_acquire)) { return false; }
+
+    item = std::move(buffer[current_head & mask]);
+    head.store(current_head + 1, std::memory_order_release);
+
+    return true;
+}
+
+bool InstructionStream::pop(StreamedInstruction& item) {
+
+    while (!tryPop(item)) {
+
+        // Check finished first, then look again, so an item pushed just before finishing is not lost
+        if (isFinished()) { return tryPop(item); }
+
+        std::this_thread::yield();
+    }
+
+    return true;
+}
+
+bool InstructionStream::isFinished() const { return finished.load(std::memory_order_acquire); }
+
+void InstructionStream::drain() {
+
+    // Never started (or already drained)
+    if (!producer_thread.joinable()) { return; }
+
+    StreamedInstruction discarded;
+    while (pop(discarded)) {}
+
+    producer_thread.join();
+
+}
+
+std::size_t InstructionStream::getCapacity() const { return buffer.size(); }
@@ -1,11 +1,26 @@
 #include "../include/lexer.h"
 
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 
-void Lexer::set_input_file(const char* filename) {
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+
+Lexer::~Lexer() { unmap_input_file(); }
+
+
+void Lexer::set_input_file(const char* filename, InputMode mode) {
     /*
     * Attempts to open useor provided filename
+    * In MAPPED mode the file is mmap'ed, falling back to the stream if that fails (ie empty files)
     */
 
+    if (mode == MAPPED && map_input_file(filename)) { return; }
+
     inputFile.open(filename, std::ios::in);
 
     // Handle file open failed
@@ -20,16 +35,55 @@ void Lexer::set_input_file(const char* filename) {
 
 }
 
-void Lexer::set_output_file(const char* filename) {
+bool Lexer::map_input_file(const char* filename) {
+    /*
+    * Maps the whole input file read-only so consume_instruction can scan it in place
+    */
+
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) { return false; }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return false;
+    }
+
+    void* data = mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // Mapping stays valid after the descriptor is closed
+
+    if (data == MAP_FAILED) { return false; }
+
+    // We only ever walk the file front to back
+    madvise(data, static_cast<std::size_t>(st.st_size), MADV_SEQUENTIAL);
+
+    mappedData = static_cast<const char*>(data);
+    fileSize = static_cast<std::size_t>(st.st_size);
+    inputMode = MAPPED;
+
+    return true;
+}
+
+void Lexer::unmap_input_file() {
+
+    if (mappedData == nullptr) { return; }
+
+    munmap(const_cast<char*>(mappedData), fileSize);
+    mappedData = nullptr;
+
+}
+
+void Lexer::set_output_file(const char* filename, bool background, bool direct) {
     /*
     * Attempts to open filename for writing
+    * Output is buffered, optionally written by a background thread and/or with O_DIRECT
     */
 
-    // Open the file in output mode
-    outputFile.open(filename, std::ios::out | std::ios::trunc);  // std::ios::trunc overwrites if the file exists
+    // Open the file in output mode (overwrites if the file exists)
+    outputFile.open(filename, background, direct);
 
     // Handle file open failed
-    if (!outputFile.is_open()) {
+    if (!outputFile.isOpen()) {
         std::cerr << "Error: Output file [" << filename << "] could not be opened." << std::endl;
         return;
     }
@@ -37,21 +91,40 @@ void Lexer::set_output_file(const char* filename) {
     //std::cout << "Output file [" << filename << "] successfully opened." << std::endl;
 }
 
-void Lexer::write_output(std::string output) {
+void Lexer::write_output(const std::string& output) {
     /*
     * Writes a string to output file, or throws an error
+    * Nothing is flushed per line, see close_output
     */
 
-   if (outputFile.is_open()) {
-        outputFile << output << std::endl;
+   if (outputFile.isOpen()) {
+        outputFile.writeLine(output);
     } else {
         std::cerr << "Could not open output file!" << std::endl;
         exit(1);
     }
 }
 
+void Lexer::write_output_raw(const char* data, std::size_t length) {
+    /*
+    * Writes already formatted output (ie a cached disassembly) as is
+    */
+
+   if (outputFile.isOpen()) {
+        outputFile.write(data, length);
+    } else {
+        std::cerr << "Could not open output file!" << std::endl;
+        exit(1);
+    }
+}
+
+void Lexer::close_output() { outputFile.close(); }
+
 // Self explanatory, tells us if we've reached end
-bool Lexer::isEOF() { return inputFile.eof(); }
+bool Lexer::isEOF() { 
+    if (inputMode == MAPPED) { return mappedEOF; }
+    return inputFile.eof(); 
+}
 
 
 
@@ -63,6 +136,8 @@ Dword Lexer::consume_instruction() {
     // Even if "instruction" is all 0s, we should consume it
     instructions_consumed++;
 
+    if (inputMode == MAPPED) { return consume_mapped_instruction(); }
+
     // Skip newline characters
     char nextChar = inputFile.peek();
     while (nextChar == '\n' || nextChar == ' ' || nextChar == '\t') {
@@ -85,10 +160,78 @@ Dword Lexer::consume_instruction() {
     bitsConsumed += 32;
 
     // Convert string buffer to 32-bit instruction
+    return ascii_bits_to_dword_scalar(buff);
+
+}
+
+Dword Lexer::consume_mapped_instruction() {
+    /*
+    * Same contract as the stream path, but reads straight out of the mapped buffer
+    * A short (or empty) read at the end sets EOF exactly like ifstream would
+    */
+
+    // Skip newline characters
+    while (bitsConsumed < fileSize) {
+        char nextChar = mappedData[bitsConsumed];
+        if (nextChar != '\n' && nextChar != ' ' && nextChar != '\t') { break; }
+        bitsConsumed++;
+    }
+
+    std::size_t remaining = fileSize - bitsConsumed;
+
+    // Handle case that no bytes remain
+    if (remaining < 32) {
+        std::cerr << "No bytes left to read!" << std::endl; 
+
+        char buff[32] = {0};
+        for (std::size_t i = 0; i < remaining; i++) { buff[i] = mappedData[bitsConsumed + i]; }
+
+        bitsConsumed = fileSize;
+        mappedEOF = true;
+
+        return ascii_bits_to_dword_scalar(buff);
+    }
+
+    Dword instruction = ascii_bits_to_dword(mappedData + bitsConsumed);
+    bitsConsumed += 32;
+
+    return instruction;
+
+}
+
+Instruction Lexer::read_next_instruction() { 
+
+    // Get next instruction value and decode it in one step
+    Dword instruction_val = consume_instruction();
+    curr_instruction = decode_instruction(instruction_val);
+
+    // Format the line (handles blanks and special cases RET, NOP, J) and write it out
+    char line[MAX_FORMATTED_LENGTH];
+    std::size_t length = format_disassembly(curr_instruction, start_position + (instructions_consumed * 4) - 4, line);
+    line[length++] = '\n';
+    write_output_raw(line, length);
+
+    return curr_instruction;
+
+}
+
+
+std::size_t Lexer::getFileSize() const { return fileSize; }
+InputMode Lexer::getInputMode() const { return inputMode; }
+
+
+
+// BIT STRING CONVERSION
+Dword ascii_bits_to_dword_scalar(const char* bits) {
+    /*
+    * Reference conversion, one character at a time
+    * Anything that is not '0' or '1' is skipped, as the lexer always has
+    */
+
     Dword instruction = 0;
 
     for (int i = 0; i < 32; i++) {
-        switch (buff[i]) {
+        switch (bits[i]) {
             case '0':
                 instruction = instruction << 1;  // Shift and add 0
                 break;
@@ -96,79 +239,72 @@ Dword Lexer::consume_instruction() {
                 instruction = (instruction << 1) | 0x1;  // Shift and add 1
                 break;
             default:
-                //std::cerr << "Faulty bit found in text: " << buff[i] << std::endl;
+                //std::cerr << "Faulty bit found in text: " << bits[i] << std::endl;
                 break;
         }
     }
 
     return instruction;
-
 }
 
-void Lexer::reset_instruction() {
+Dword ascii_bits_to_dword(const char* bits) {
     /*
-    * Resets currently used instruction to read in a new one
+    * Vectorized conversion: compare all 32 characters against '1' at once and
+    * collect the results with movemask. Character 0 is the MSB, so the bytes are
+    * reversed first (AVX2) or the mask is bit-reversed afterwards (SSE2).
+    * Strings containing anything other than '0'/'1' take the scalar path so
+    * the result always matches ascii_bits_to_dword_scalar.
     */
 
-    // Create new instruction with default values
-    curr_instruction.type = OTHER;
-    curr_instruction.value = 0;
+#if defined(__AVX2__)
 
-}
+    const __m256i reverse = _mm256_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0,
+                                             15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
 
-Instruction Lexer::read_next_instruction() { 
+    __m256i chars = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(bits));
+    __m256i ones = _mm256_cmpeq_epi8(chars, _mm256_set1_epi8('1'));
+    __m256i zeros = _mm256_cmpeq_epi8(chars, _mm256_set1_epi8('0'));
 
-    // Give default value for output
-    std::string output = "";
+    if (static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_or_si256(ones, zeros))) != 0xFFFFFFFF) {
+        return ascii_bits_to_dword_scalar(bits);
+    }
 
-    // Reset
-    reset_instruction();
+    // Reverse bytes within each lane, then swap the lanes
+    ones = _mm256_shuffle_epi8(ones, reverse);
+    ones = _mm256_permute4x64_epi64(ones, 0x4E);
 
-    // Get next instruction value
-    Dword instruction_val = consume_instruction();
-    curr_instruction.value = instruction_val;
+    return static_cast<Dword>(_mm256_movemask_epi8(ones));
 
-    // Get opcode
-    INST_TYPE opcode = read_opcode(instruction_val);
-    curr_instruction.type = opcode;
+#elif defined(__SSE2__)
 
-    // Check if instruction is blank, then print it if it is
-    if (opcode == BLANK) {
-        output = instruction_to_string(curr_instruction, start_position + (instructions_consumed * 4) - 4, true);
-        write_output(output);
-        return curr_instruction;
-    }
+    __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bits));
+    __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bits + 16));
 
-    //std::cout << "Instruction type: " << itype_to_string(opcode) << std::endl;
+    const __m128i one = _mm_set1_epi8('1');
+    const __m128i zero = _mm_set1_epi8('0');
 
-    // Retrieve the exact instruction
-    EXACT_INSTRUCTION exact_instruction = decompose_types(instruction_val, opcode);
-    curr_instruction.instruction = exact_instruction;
+    __m128i high_ones = _mm_cmpeq_epi8(high, one);
+    __m128i low_ones = _mm_cmpeq_epi8(low, one);
 
-    //std::cout << "Exact instruction: " << exact_instruction_to_string(exact_instruction) << std::endl;
+    uint32_t valid = static_cast<uint32_t>(_mm_movemask_epi8(_mm_or_si128(high_ones, _mm_cmpeq_epi8(high, zero))))
+                   | static_cast<uint32_t>(_mm_movemask_epi8(_mm_or_si128(low_ones, _mm_cmpeq_epi8(low, zero)))) << 16;
 
-    // Find fields as necessary
-    Instruction dummy_populated_instruction = get_populated_instruction(instruction_val, opcode);
-    curr_instruction.rs1 = dummy_populated_instruction.rs1;
-    curr_instruction.rs2 = dummy_populated_instruction.rs2;
-    curr_instruction.rd = dummy_populated_instruction.rd;
-    curr_instruction.imm = dummy_populated_instruction.imm;
+    if (valid != 0xFFFFFFFF) { return ascii_bits_to_dword_scalar(bits); }
 
-    // Handle special cases RET, NOP, J
-    if (exact_instruction == RET || exact_instruction == NOP || exact_instruction == J) {
-        output = handle_special_case(curr_instruction, exact_instruction, start_position + (instructions_consumed * 4) - 4);
-        write_output(output);
-        return curr_instruction;
-    }
+    // Character i is in bit i here, so reverse the whole mask
+    uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(high_ones))
+                  | static_cast<uint32_t>(_mm_movemask_epi8(low_ones)) << 16;
 
-    //std::cout << exact_instruction_to_string(exact_instruction) << std::endl; 
-    // Get instruction as string and write it out
-    output = instruction_to_string(curr_instruction, start_position + (instructions_consumed * 4) - 4, false);
-    write_output(output);
+    mask = ((mask >> 1) & 0x55555555) | ((mask & 0x55555555) << 1);
+    mask = ((mask >> 2) & 0x33333333) | ((mask & 0x33333333) << 2);
+    mask = ((mask >> 4) & 0x0F0F0F0F) | ((mask & 0x0F0F0F0F) << 4);
 
-    return curr_instruction;
+    return __builtin_bswap32(mask);
 
-}
+#else
+
+    return ascii_bits_to_dword_scalar(bits);
 
+#endif
 
-std::size_t Lexer::getFileSize() const { return fileSize; }
\ No newline at end of file
+}
\ No newline at end of file
@@ -0,0 +1,178 @@
+#include "../include/loader.h"
+
+#include <fstream>
+#include <iterator>
+
+
+// ELF32 constants we need, see the System V ABI / RISC-V ELF psABI
+namespace {
+
+const uint8_t ELF_CLASS_32 = 1;
+const uint8_t ELF_DATA_LSB = 1;
+const uint16_t ELF_MACHINE_RISCV = 243;
+const uint16_t ELF_TYPE_EXEC = 2;
+const uint32_t PT_LOAD = 1;
+const uint32_t PF_X = 1;
+
+uint16_t read_u16(const std::vector<uint8_t>& bytes, std::size_t offset) {
+    return static_cast<uint16_t>(bytes[offset] | (bytes[offset + 1] << 8));
+}
+
+uint32_t read_u32(const std::vector<uint8_t>& bytes, std::size_t offset) {
+    return static_cast<uint32_t>(bytes[offset])
+         | static_cast<uint32_t>(bytes[offset + 1]) << 8
+         | static_cast<uint32_t>(bytes[offset + 2]) << 16
+         | static_cast<uint32_t>(bytes[offset + 3]) << 24;
+}
+
+bool read_file(const std::string& filename, std::vector<uint8_t>& bytes) {
+
+    std::ifstream file(filename, std::ios::in | std::ios::binary);
+
+    if (!file.is_open()) {
+        std::cerr << "Error: File [" << filename << "] could not be opened." << std::endl;
+        return false;
+    }
+
+    bytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return true;
+}
+
+} // namespace
+
+
+
+ProgramFormat detect_program_format(const std::string& filename) {
+    /*
+    * ELF files are recognized by their magic number, flat images by extension
+    * Anything else is assumed to be the ASCII bit format
+    */
+
+    std::ifstream file(filename, std::ios::in | std::ios::binary);
+    char magic[4] = {0};
+
+    if (file.is_open() && file.read(magic, 4) && 
+        magic[0] == 0x7F && magic[1] == 'E' && magic[2] == 'L' && magic[3] == 'F') {
+        return ELF32;
+    }
+
+    if (filename.size() >= 4 && filename.compare(filename.size() - 4, 4, ".bin") == 0) {
+        return RAW_BINARY;
+    }
+
+    return TEXT_BITS;
+}
+
+
+bool load_raw_binary(const std::string& filename, uint32_t base_address, ProgramImage& image) {
+    /*
+    * A flat image has no headers, so the whole file is code starting at base_address
+    */
+
+    LoadedSegment segment;
+    if (!read_file(filename, segment.bytes)) { return false; }
+
+    if (segment.bytes.size() % 4 != 0) {
+        std::cerr << "Error: [" << filename << "] is not a whole number of 32-bit words." << std::endl;
+        return false;
+    }
+
+    segment.address = base_address;
+    segment.executable = true;
+
+    image.entry_point = base_address;
+    image.segments.push_back(std::move(segment));
+
+    return true;
+}
+
+
+bool load_elf32(const std::string& filename, ProgramImage& image) {
+    /*
+    * Loads every PT_LOAD program header
+    * Executable segments become instructions, the rest (.data, .bss) becomes data memory
+    */
+
+    std::vector<uint8_t> bytes;
+    if (!read_file(filename, bytes)) { return false; }
+
+    // ELF header is 52 bytes for ELF32
+    if (bytes.size() < 52) {
+        std::cerr << "Error: [" << filename << "] is too small to be an ELF file." << std::endl;
+        return false;
+    }
+
+    if (bytes[4] != ELF_CLASS_32 || bytes[5] != ELF_DATA_LSB) {
+        std::cerr << "Error: [" << filename << "] is not a little-endian ELF32 file." << std::endl;
+        return false;
+    }
+
+    if (read_u16(bytes, 18) != ELF_MACHINE_RISCV) {
+        std::cerr << "Error: [" << filename << "] is not a RISC-V executable." << std::endl;
+        return false;
+    }
+
+    if (read_u16(bytes, 16) != ELF_TYPE_EXEC) {
+        std::cerr << "Error: [" << filename << "] is not a statically linked executable." << std::endl;
+        return false;
+    }
+
+    uint32_t entry = read_u32(bytes, 24);
+    uint32_t phoff = read_u32(bytes, 28);
+    uint16_t phentsize = read_u16(bytes, 42);
+    uint16_t phnum = read_u16(bytes, 44);
+
+    if (phentsize < 32 || static_cast<std::size_t>(phoff) + static_cast<std::size_t>(phnum) * phentsize > bytes.size()) {
+        std::cerr << "Error: [" << filename << "] has a malformed program header table." << std::endl;
+        return false;
+    }
+
+    for (uint16_t i = 0; i < phnum; i++) {
+
+        std::size_t header = phoff + static_cast<std::size_t>(i) * phentsize;
+
+        if (read_u32(bytes, header) != PT_LOAD) { continue; }
+
+        uint32_t offset = read_u32(bytes, header + 4);
+        uint32_t vaddr = read_u32(bytes, header + 8);
+        uint32_t filesz = read_u32(bytes, header + 16);
+        uint32_t memsz = read_u32(bytes, header + 20);
+        uint32_t flags = read_u32(bytes, header + 24);
+
+        if (static_cast<std::size_t>(offset) + filesz > bytes.size() || filesz > memsz) {
+            std::cerr << "Error: [" << filename << "] segment " << i << " lies outside the file." << std::endl;
+            return false;
+        }
+
+        LoadedSegment segment;
+        segment.address = vaddr;
+        segment.executable = (flags & PF_X) != 0;
+        segment.bytes.assign(bytes.begin() + offset, bytes.begin() + offset + filesz);
+        segment.bytes.resize(memsz, 0); // .bss is zero-filled
+
+        image.segments.push_back(std::move(segment));
+    }
+
+    image.entry_point = entry;
+
+    return true;
+}
+
+
+std::vector<Dword> segment_words(const LoadedSegment& segment) {
+    /*
+    * Splits a segment into little-endian 32-bit words (a trailing partial word is dropped)
+    */
+
+    std::vector<Dword> words;
+    words.reserve(segment.bytes.size() / 4);
+
+    for (std::size_t i = 0; i + 4 <= segment.bytes.size(); i += 4) {
+        words.push_back(static_cast<Dword>(segment.bytes[i])
+                      | static_cast<Dword>(segment.bytes[i + 1]) << 8
+                      | static_cast<Dword>(segment.bytes[i + 2]) << 16
+                      | static_cast<Dword>(segment.bytes[i + 3]) << 24);
+    }
+
+    return words;
+}
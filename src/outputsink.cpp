@@ -0,0 +1,299 @@
+#include "../include/outputsink.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace {
+
+// O_DIRECT wants buffers, sizes and file offsets aligned to the logical block size
+const std::size_t DIRECT_ALIGNMENT = 4096;
+
+}
+
+
+
+// CONSTRUCTORS
+OutputSink::OutputSink(std::size_t block_size)
+    : block_size(((block_size + DIRECT_ALIGNMENT - 1) / DIRECT_ALIGNMENT) * DIRECT_ALIGNMENT) {}
+
+OutputSink::~OutputSink() {
+
+    close();
+
+    for (char* block : free_blocks) { std::free(block); }
+    std::free(current.data);
+
+}
+
+
+
+bool OutputSink::open(const char* filename, bool background, bool direct) {
+    /*
+    * Opens (truncating) filename for writing
+    * Falls back to a normal open if the filesystem refuses O_DIRECT
+    */
+
+    close();
+
+    int flags = O_WRONLY | O_CREAT | O_TRUNC;
+
+#ifdef O_DIRECT
+    if (direct) {
+        fd = ::open(filename, flags | O_DIRECT, 0644);
+        this->direct = (fd >= 0);
+    }
+#endif
+
+    if (fd < 0) {
+        fd = ::open(filename, flags, 0644);
+        this->direct = false;
+    }
+
+    if (fd < 0) { return false; }
+
+    if (current.data == nullptr) { current.data = acquireBlock(); }
+    current.used = 0;
+
+    this->background = background;
+    stopping = false;
+    if (background) { writer = std::thread(&OutputSink::writerLoop, this); }
+
+    return true;
+}
+
+bool OutputSink::isOpen() const { return fd >= 0; }
+
+
+
+// WRITING
+void OutputSink::write(const char* data, std::size_t length) {
+
+    while (length > 0) {
+
+        std::size_t space = block_size - current.used;
+        std::size_t chunk = (length < space) ? length : space;
+
+        std::memcpy(current.data + current.used, data, chunk);
+        current.used += chunk;
+        data += chunk;
+        length -= chunk;
+
+        if (current.used == block_size) { submitCurrent(); }
+    }
+
+}
+
+void OutputSink::writeLine(const std::string& line) {
+
+    // Fast path, the whole line (and newline) fits in the current block
+    if (block_size - current.used > line.size()) {
+        std::memcpy(current.data + current.used, line.data(), line.size());
+        current.used += line.size();
+        current.data[current.used++] = '\n';
+        return;
+    }
+
+    write(line.data(), line.size());
+    write("\n", 1);
+
+}
+
+void OutputSink::flush() {
+
+    if (fd < 0) { return; }
+
+    if (current.used > 0) { submitCurrent(); }
+
+    if (!background) { return; }
+
+    // Wait for the writer to empty the queue
+    std::unique_lock<std::mutex> lock(mutex);
+    work_done.wait(lock, [this]() { return queued.empty() && !writer_busy; });
+
+}
+
+void OutputSink::close() {
+
+    if (fd < 0) { return; }
+
+    flush();
+
+    if (writer.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        work_ready.notify_one();
+        writer.join();
+    }
+
+    ::close(fd);
+    fd = -1;
+
+}
+
+
+
+// BLOCK MANAGEMENT
+char* OutputSink::acquireBlock() {
+
+    if (background) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!free_blocks.empty()) {
+            char* block = free_blocks.back();
+            free_blocks.pop_back();
+            return block;
+        }
+    } else if (!free_blocks.empty()) {
+        char* block = free_blocks.back();
+        free_blocks.pop_back();
+        return block;
+    }
+
+    // Aligned so the same blocks work with O_DIRECT
+    void* block = nullptr;
+    if (posix_memalign(&block, DIRECT_ALIGNMENT, block_size) != 0) {
+        std::cerr << "Could not allocate output buffer!" << std::endl;
+        exit(1);
+    }
+
+    return static_cast<char*>(block);
+}
+
+void OutputSink::submitCurrent() {
+
+    Block full = current;
+
+    if (background) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queued.push_back(full);
+        }
+        work_ready.notify_one();
+    } else {
+        std::vector<Block> blocks = {full};
+        writeBlocks(blocks);
+        free_blocks.push_back(full.data);
+    }
+
+    current.data = acquireBlock();
+    current.used = 0;
+
+}
+
+void OutputSink::writeBlocks(std::vector<Block>& blocks) {
+    /*
+    * Writes whole blocks with one writev per IOV_MAX blocks
+    * A partial block under O_DIRECT would leave the file offset unaligned, so O_DIRECT is dropped for it
+    */
+
+    std::size_t index = 0;
+
+    while (index < blocks.size()) {
+
+        // Partial blocks are always last, write them on their own
+        if (blocks[index].used != block_size) {
+
+#ifdef O_DIRECT
+            if (direct) {
+                fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_DIRECT);
+                direct = false;
+            }
+#endif
+
+            writeAll(blocks[index].data, blocks[index].used);
+            index++;
+            continue;
+        }
+
+        std::vector<iovec> iov;
+        while (index < blocks.size() && blocks[index].used == block_size && iov.size() < IOV_MAX) {
+            iov.push_back({blocks[index].data, block_size});
+            index++;
+        }
+
+        // Retry until every byte is written, advancing over partial writes
+        std::size_t first = 0;
+        while (first < iov.size()) {
+
+            ssize_t written = writev(fd, iov.data() + first, static_cast<int>(iov.size() - first));
+
+            if (written < 0) {
+                if (errno == EINTR) { continue; }
+                std::cerr << "Could not write output file!" << std::endl;
+                exit(1);
+            }
+
+            std::size_t remaining = static_cast<std::size_t>(written);
+            while (first < iov.size() && remaining >= iov[first].iov_len) {
+                remaining -= iov[first].iov_len;
+                first++;
+            }
+
+            if (first < iov.size()) {
+                iov[first].iov_base = static_cast<char*>(iov[first].iov_base) + remaining;
+                iov[first].iov_len -= remaining;
+            }
+        }
+    }
+
+}
+
+bool OutputSink::writeAll(const char* data, std::size_t length) {
+
+    while (length > 0) {
+
+        ssize_t written = ::write(fd, data, length);
+
+        if (written < 0) {
+            if (errno == EINTR) { continue; }
+            std::cerr << "Could not write output file!" << std::endl;
+            exit(1);
+        }
+
+        data += written;
+        length -= static_cast<std::size_t>(written);
+    }
+
+    return true;
+}
+
+void OutputSink::writerLoop() {
+    /*
+    * Background thread: takes every queued block at once and writes them in one go
+    */
+
+    std::vector<Block> batch;
+
+    while (true) {
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            work_ready.wait(lock, [this]() { return !queued.empty() || stopping; });
+
+            if (queued.empty() && stopping) { return; }
+
+            batch.swap(queued);
+            writer_busy = true;
+        }
+
+        writeBlocks(batch);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (const Block& block : batch) { free_blocks.push_back(block.data); }
+            writer_busy = false;
+        }
+        batch.clear();
+
+        work_done.notify_all();
+    }
+
+}
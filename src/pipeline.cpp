@@ -1,26 +1,36 @@
 #include "../include/pipeline.h"
 
+// Results that go through WB, JAL and JALR write their link register in EX
+static bool writes_register(INST_TYPE type) {
+    return type == I_TYPE || type == IRR || type == LOAD || type == LUI || type == AUIPC;
+}
+
+// Where a taken branch at address goes. Branches resolve in EX and the offset was always added to the pc
+// fetch had reached by then, four instructions on, so a prediction at fetch lands in the same place
+static uint32_t branch_target(uint32_t address, int32_t offset) { return address + 16 + static_cast<uint32_t>(offset); }
+
+// What JAL/JALR at address link, the npc fetch had reached by the time it was in EX
+static uint32_t link_address(uint32_t address) { return address + 20; }
+
+// Register the instruction in stage writes through WB, 0 for none
+static uint32_t written_register(PipelineStage& stage) {
+    return writes_register(stage.getInstructionType()) ? stage.getDestination() : 0;
+}
+
 // Constructors
 Pipeline::Pipeline() {
     // Initialize the 8 pipeline stages
-    stages[StageType::IF] = PipelineStage(StageType::IF);
-    stages[StageType::IS] = PipelineStage(StageType::IS);
-    stages[StageType::ID] = PipelineStage(StageType::ID);
-    stages[StageType::RF] = PipelineStage(StageType::RF);
-    stages[StageType::EX] = PipelineStage(StageType::EX);
-    stages[StageType::DF] = PipelineStage(StageType::DF);
-    stages[StageType::DS] = PipelineStage(StageType::DS);
-    stages[StageType::WB] = PipelineStage(StageType::WB);
-
-    // Initialize the 32 integer registers
-    for (int i = 0; i < 32; ++i) {
-        setIntegerRegister(i, 0);
-    }
-
-    // Initialize data memory
-    for (int i = 0; i <= 36; i+=4) {
-        data_memory[600 + i] = 0;
-    }
+    stages[StageType::IF] = PipelineStage(StageType::IF, &instruction_pool);
+    stages[StageType::IS] = PipelineStage(StageType::IS, &instruction_pool);
+    stages[StageType::ID] = PipelineStage(StageType::ID, &instruction_pool);
+    stages[StageType::RF] = PipelineStage(StageType::RF, &instruction_pool);
+    stages[StageType::EX] = PipelineStage(StageType::EX, &instruction_pool);
+    stages[StageType::DF] = PipelineStage(StageType::DF, &instruction_pool);
+    stages[StageType::DS] = PipelineStage(StageType::DS, &instruction_pool);
+    stages[StageType::WB] = PipelineStage(StageType::WB, &instruction_pool);
+
+    // Initialize data memory (600..1000 in words), reads as 0 until written
+    data_memory.addRegion("data", data_memory_low, 404);
 
 }
 
@@ -32,24 +42,46 @@ Pipeline::Pipeline() {
  */
 bool Pipeline::sendNextInstruction() {
     /**
-     * Takes an instruction from "instructions" vector
+     * Fetches the instruction at pc from the decoded program
      * Sends it to IF pipeline stage
      */
 
     
 
-    auto it = instruction_map.find(pc); // Check if the key exists in the map
-    if (it != instruction_map.end()) { // Key exists
+    if (flags.halted) { return false; } // ECALL/EBREAK, let the pipeline drain
+
+    const Instruction* fetched = program.fetch(pc);
+
+    // In streaming mode the instruction may simply not be decoded yet
+    if (fetched == nullptr && instruction_stream != nullptr && fetchFromStream(pc)) {
+        fetched = program.fetch(pc);
+    }
+
+    if (fetched != nullptr) {
         if (stages[StageType::IF].isEmpty()) {
-            stages[StageType::IF].setInstruction(std::make_unique<Instruction>(it->second));
-            std::cout << "Sent out instruction: " << stages[StageType::IF].getNewStyleIstring() << std::endl << "Cycle: " << std::to_string(curr_cycle) << std::endl;
+            InstructionSlot slot = instruction_pool.acquire(*fetched, static_cast<uint32_t>(pc));
+            if (slot == NO_SLOT) { return true; }
+            stages[StageType::IF].setInstruction(slot, program.getDisplayString(pc));
+
+            // On an instruction cache miss it stays in IF until the line arrives
+            flags.fetchReadyCycle = curr_cycle + 1 + memory_hierarchy.fetch(static_cast<uint32_t>(pc));
+
+            // Predicted to redirect, the next cycle's pc += 4 fetches the target
+            FetchPrediction& prediction = fetch_predictions[slot];
+            predictFetch(*fetched, static_cast<uint32_t>(pc), prediction);
+            if (prediction.redirected) {
+                pc = static_cast<int>(prediction.next) - 4;
+                pipeline_registers.npc = pc + 4;
+            }
+
+            LOG_DEBUG("Sent out instruction: " << stages[StageType::IF].getNewStyleIstring() << "\nCycle: " << curr_cycle);
             return true; 
         } else {
-            std::cerr << "Error: IF stage is full.\n";
+            LOG_DEBUG("Error: IF stage is full.");
             return true;
         }
     } else {
-        std::cerr << "Error: Instruction for pc not found.\n";
+        LOG_DEBUG("Error: Instruction for pc not found.");
         return false; // returns false if program is at end
     }
 }
@@ -69,9 +101,26 @@ void Pipeline::comprehensiveAdvance() {
      * Then, write its result to memory
      */
 
+    if (status != RUNNING) { return; }
+
     bool endFlag = false; // flag to end program
 
-    if (!flags.isRAWStalled) {
+    // RF needs a result that isn't ready (load, multiply, divide) or can't be forwarded yet, or a unit that is still busy
+    bool unreachable = false;
+    uint32_t waiting_on = waitingOnResult(unreachable);
+    bool unit_busy = waiting_on == 0 && functionalUnitBusy();
+    bool rf_held = waiting_on != 0 || unit_busy;
+
+    // A cache miss holds DF or IF until its line arrives, DF holds everything behind it as well
+    bool data_held = !stages[StageType::DF].isEmpty() && curr_cycle < flags.dataReadyCycle;
+    bool fetch_held = !stages[StageType::IF].isEmpty() && curr_cycle < flags.fetchReadyCycle;
+
+    if (data_held) { flags.heldStage = DF; }
+    else if (rf_held) { flags.heldStage = RF; }
+    else if (fetch_held) { flags.heldStage = IF; }
+    else { flags.heldStage = NONE; }
+
+    if (flags.heldStage == NONE) {
         pc += 4;
         pipeline_registers.npc = pc + 4;
     }
@@ -81,74 +130,168 @@ void Pipeline::comprehensiveAdvance() {
 
     advanceInstruction(WB, WB, true);
     advanceInstruction(DS, WB);
-    advanceInstruction(DF, DS);
-    advanceInstruction(EX, DF);
-    if (!flags.isRAWStalled || flags.stopStage == ID) { advanceInstruction(RF, EX); }
-    if (!flags.isRAWStalled || flags.stopStage == RF) { advanceInstruction(ID, RF); }
-    advanceInstruction(IS, ID);
-    advanceInstruction(IF, IS);
 
-    if (sendNextInstruction() == false && allPipelineStagesEmpty()) { // sendNextInstruction is false iff next pc has no instruction to send (not just if IF is full)
-        endFlag = true;
+    if (flags.heldStage == DF) {
+        stats.data_cache++;
+        holdFrontEnd(DF); // DS gets a bubble
+    } else if (flags.heldStage == RF) {
+        StageType producer = waiting_on ? scoreboard.producerAfter(waiting_on, RF) : NONE; // Before it moves on
+        if (unit_busy) { stats.structural++; }
+        else if (unreachable) { stats.bypass++; }
+        else if (producer != NONE && stages[producer].getInstructionType() == LOAD) { stats.total_loads++; }
+        else { stats.raw_multi_cycle++; }
+
+        advanceInstruction(DF, DS);
+        advanceInstruction(EX, DF);
+        holdFrontEnd(RF); // EX gets a bubble
+    } else {
+        advanceInstruction(DF, DS);
+        advanceInstruction(EX, DF);
+        advanceInstruction(RF, EX);
+        advanceInstruction(ID, RF);
+        advanceInstruction(IS, ID);
+
+        if (flags.heldStage == IF) {
+            stats.instruction_cache++; // IS gets a bubble
+        } else {
+            advanceInstruction(IF, IS);
+
+            if (sendNextInstruction() == false && allPipelineStagesEmpty()) { // sendNextInstruction is false iff next pc has no instruction to send (not just if IF is full)
+                endFlag = true;
+            }
+        }
     }
 
-    // Perform pipeline actions
+    // Perform pipeline actions, held stages already did theirs (except RF)
 
 
     writeBack();
     dataStore();
-    dataFetch();
-    executeInstruction();
-    registerFetch();
-    instructionDecode();
-    ISAction();
+    if (flags.heldStage != DF) {
+        dataFetch();
+        executeInstruction();
+    }
+    registerFetch(); // Held in RF, it reads again so results written back meanwhile are seen
+    if (flags.heldStage == NONE || flags.heldStage == IF) {
+        instructionDecode();
+        ISAction();
+    }
 
     curr_cycle++;
+    if (flags.heldStage != DF) { scoreboard.cycle++; } // Results and units ahead of RF waited with DF
 
-    if (endFlag || curr_cycle == 127) { 
-        std::cout << getCycleOutput();
-        std::cout << "Program ended in comprehensiveAdvance()" << std::endl;
-        exit(0); 
+    if (endFlag && status == RUNNING) { 
+        LOG_INFO("Program ended in comprehensiveAdvance()");
+        if (instruction_stream != nullptr) { instruction_stream->drain(); } // Let the lexer finish its output
+        status = FINISHED;
+        return;
     }
 
-    std::cout << "Instruction in IF: " << stages[StageType::IF].getNewStyleIstring() << std::endl;
-    std::cout << "Instruction in IS: " << stages[StageType::IS].getNewStyleIstring() << std::endl;
-    std::cout << "Instruction in ID: " << stages[StageType::ID].getNewStyleIstring() << std::endl;
+    LOG_DEBUG("Instruction in IF: " << stages[StageType::IF].getNewStyleIstring());
+    LOG_DEBUG("Instruction in IS: " << stages[StageType::IS].getNewStyleIstring());
+    LOG_DEBUG("Instruction in ID: " << stages[StageType::ID].getNewStyleIstring());
     
 }
 
+RunStatus Pipeline::step() {
+    comprehensiveAdvance();
+    return status;
+}
+
+RunStatus Pipeline::step(uint64_t cycles) {
+    for (uint64_t i = 0; i < cycles && status == RUNNING; i++) { comprehensiveAdvance(); }
+    return status;
+}
+
+RunResult Pipeline::run(uint64_t maxCycles) {
+
+    uint64_t limit = curr_cycle + maxCycles;
+
+    while (status == RUNNING && (maxCycles == 0 || curr_cycle < limit)) { comprehensiveAdvance(); }
+
+    RunResult result = getResult();
+    if (result.status == RUNNING) { result.status = CYCLE_LIMIT; }
+
+    return result;
+}
+
+RunStatus Pipeline::getStatus() const { return status; }
+
+RunResult Pipeline::getResult() const {
+
+    RunResult result;
+    result.status = status;
+    result.cycles = curr_cycle;
+    result.instructions_retired = stats.instructions_retired;
+    result.stats = stats;
+    result.message = fault_message;
+
+    for (int level = 0; level < NUM_CACHE_LEVELS; level++) {
+        result.stats.caches[level] = memory_hierarchy.getCache(CacheLevel(level)).getStats();
+    }
+
+    return result;
+}
+
+uint64_t Pipeline::getCycle() const { return curr_cycle; }
+
+void Pipeline::fault(RunStatus reason, const std::string& message) {
+
+    if (status != RUNNING) { return; }
+
+    status = reason;
+    fault_message = message;
+}
+
+std::string run_status_to_string(RunStatus status) {
+    switch (status) {
+        case RUNNING: return "running";
+        case FINISHED: return "finished";
+        case CYCLE_LIMIT: return "cycle limit";
+        case MEMORY_FAULT: return "memory fault";
+        case REGISTER_FAULT: return "register fault";
+        default: return "unknown";
+    }
+}
+
 void Pipeline::advanceInstruction(StageType from, StageType to, bool deallocate){
     /**
-     * Moves an instruction unique ptr from "stages[from]" to "stages[to]"
-     * If deallocate flag is set, simply deallocates the pointer
+     * Moves an instruction slot from "stages[from]" to "stages[to]"
+     * If deallocate flag is set, simply returns the slot to the pool
      */
 
     // Deallocate if deallocate flag is set
     // Here, to is irrelevant
     if (deallocate) { 
+        scoreboard.leave(from);
         stages[from].deallocateInstruction(); 
         stages[from].resetState();
-        if (flags.isRAWStalled || flags.isBranchStalled) { stages[from].setState("**STALL**"); }
+        if (flags.heldStage != NONE || flags.isBranchStalled) { stages[from].setStalled(); }
         return;
     }
 
     if (stages[from].isEmpty()) {
-        if (flags.isBranchStalled) { stages[to].setState("**STALL**"); }
-        std::cerr << "Cannot send from " << stages[from].getStageName() << " because " << stages[from].getStageName() << " is empty." << std::endl;
+        if (flags.isBranchStalled) { stages[to].setStalled(); }
+        LOG_DEBUG("Cannot send from " << stages[from].getStageName() << " because " << stages[from].getStageName() << " is empty.");
         return;
     }
 
     if (!stages[to].isEmpty()) {
-        std::cerr << "Cannot send to " << stages[to].getStageName() << " because " << stages[to].getStageName() << " is already full." << std::endl;
+        LOG_DEBUG("Cannot send to " << stages[to].getStageName() << " because " << stages[to].getStageName() << " is already full.");
         return;
     }
 
     
 
-    if (flags.isRAWStalled && from != IF && from != IS) { stages[from].setState("**STALL**"); }
+    if (flags.heldStage != NONE) { stages[from].setStalled(); } // Only stages after the held ones move
     else { stages[from].resetState(); }
 
-    stages[to].setInstruction(std::move(stages[from].getInstruction()));
+    std::string_view display = stages[from].getNewStyleIstring();
+    stages[to].setInstruction(stages[from].clearInstruction(), display);
+
+    // Writers are tracked from RF on, once ID has checked them against the ones ahead
+    if (to == RF) { scoreboard.enter(RF, written_register(stages[RF])); }
+    else { scoreboard.move(from, to); }
 
 }
 
@@ -180,25 +323,8 @@ void Pipeline::ISAction() {
 
     uint32_t value = stages[IS].getValue();
 
-    std::ostringstream oss;
-
-    
-    // Extract each byte (big-endian order)
-    uint8_t byte1 = (value >> 24) & 0xFF; // Most significant byte
-    uint8_t byte2 = (value >> 16) & 0xFF;
-    uint8_t byte3 = (value >> 8) & 0xFF;
-    uint8_t byte4 = value & 0xFF;         // Least significant byte
-
-    // Rearrange bytes into [Byte 3][Byte 2][Byte 4][Byte 1]
-    oss << "<Fetched "
-        << std::bitset<8>(byte3) << " "  // Byte 3
-        << std::bitset<8>(byte2) << " "  // Byte 2
-        << std::bitset<8>(byte4) << " "  // Byte 4
-        << std::bitset<8>(byte1)         // Byte 1
-        << ">";
-
-    // Set the state of IS
-    stages[IS].setState(oss.str());
+    // Shown as "<Fetched ...>", formatted only if the state is printed
+    stages[IS].setFetched(value);
 
     // Set pipeline register
     pipeline_registers.instruction_register = value;
@@ -210,100 +336,35 @@ void Pipeline::ISAction() {
 
 void Pipeline::instructionDecode() {
     /**
-     * IN THIS STAGE WE ALSO NEED TO DO HAZARD CHECKS
-     * I WILL SKIP THIS FOR NOW
+     * Simulates the Instruction Decode (ID) stage, where RAW hazards are detected
+     * Whether the instruction then has to wait in RF is decided each cycle by waitingOnResult
      */
 
     //Check type of instruction in ID state
 
 
     if (stages[StageType::ID].isEmpty()) {
-        std::cerr << "Cannot decode empty instruction." << std::endl;
+        LOG_DEBUG("Cannot decode empty instruction.");
         return;
     }
 
-    if (flags.isRAWStalled && curr_cycle != 16 && ((curr_cycle - 1) % 15 != 0)) { return; } // No need to check again
-    // This is sketch
-
-    EXACT_INSTRUCTION instruction = stages[StageType::ID].getExactInstruction();
-
-    // Flags for if they can have a dependency in rs1, rs2, or both
-    bool flag_dep1 = false;
-    bool flag_dep2 = false;
-    StageType dep1;
-    StageType dep2;
-
-    std::unordered_map<DEPENDENCY_TYPE, uint32_t> dependencies = stages[StageType::ID].getDependencies();
-
-    // Number of cycles to stall if we hit a RAW hazard
-    std::unordered_map<StageType, int> cycles_to_stall_raw = {
-        {DS, 2},
-        {DF, 3},
-        {EX, 4},
-        {RF, 5}
-    };
-
-    switch(instruction) {
-        case LW: //Can only have a RAW hazard in rs1
-        case ADDI:
-        case SLTI:
-        case JALR_E:
-            flag_dep1 = true;
-            dep1 = checkRAWHazard(RS1, dependencies[RS1]);
-            break;
-        case ADD: // Can have RAW hazards in rs1 and rs2
-        case SUB:
-        case SLT:
-        case SLL:
-        case SRL:
-        case OR:
-        case XOR:
-        case BEQ:
-        case BGE:
-        case BNE:
-        case BLT:
-        case SW:
-            flag_dep1 = true;
-            flag_dep2 = true;
-            dep1 = checkRAWHazard(RS1, dependencies[RS1]);
-            dep2 = checkRAWHazard(RS2, dependencies[RS2]);
-            break;
-        default: //stuff like NOP which has neither
-            return;
-       
-            
-        
-
-    }
-
-    if (flag_dep1 && dep1 != NONE) { addDetectedForward(ID, dep1, RS1); }
-    if (flag_dep2 && dep2 != NONE) { addDetectedForward(ID, dep2, RS2); }
+    INST_TYPE instruction_type = stages[StageType::ID].getInstructionType();
 
+    // JAL reads no register (its immediate overlaps the rs1/rs2 fields)
+    if (instruction_type == JAL || instruction_type == BLANK || instruction_type == OTHER) { return; }
 
-    
-    return; // temporarily rid of RAW stalls
-
-    bool flag_load_dep = false; //flag to check for load dependency (only 1 cycle)
-    int num_cycle_stall_1 = 0;
-    int num_cycle_stall_2 = 0;
-    int num_cycle_stall = 0;
+    Dependencies dependencies = stages[StageType::ID].getDependencies(); // x0 for an operand it doesn't read
 
-    if (flag_dep1 && dep1 != NONE) { num_cycle_stall_1 = cycles_to_stall_raw[dep1]; }
-
-    if (flag_dep2 && dep2 != NONE) { num_cycle_stall_2 = cycles_to_stall_raw[dep2]; }
-
-    num_cycle_stall = std::max(num_cycle_stall_1, num_cycle_stall_2);
-    
-    if (num_cycle_stall > 0) { 
+    // RAW hazards: the nearest writer of each source still in RF..DS forwards to it
+    // (one in WB writes the register this cycle, before RF reads it)
+    for (DEPENDENCY_TYPE dep : {RS1, RS2}) {
 
-        std::cout << "Will stall for " << num_cycle_stall << " cycles." << std::endl; 
+        uint32_t reg = dependencies[dep];
+        if (((scoreboard.pending >> reg) & 1) == 0) { continue; } // Never set for x0
 
-        // Turn on stalled mode
-        flags.isRAWStalled = true;
-        flags.RAWstallsRemaining = num_cycle_stall;
-        
+        StageType producer = scoreboard.producerAfter(reg, ID);
+        if (producer != NONE && producer != WB) { addDetectedForward(ID, producer, dep); }
     }
-    
 
     return;
 }
@@ -317,108 +378,128 @@ StageType Pipeline::checkDataHazard(DEPENDENCY_TYPE reg, uint32_t register_depen
 
 }
 
-StageType Pipeline::checkRAWHazard(DEPENDENCY_TYPE reg, uint32_t register_dependency) {
+void Pipeline::addDetectedForward(StageType to, StageType from, DEPENDENCY_TYPE dep) {
 
-    uint32_t result_register;
+    stages[to].setNeedsForward(true);
+    //stages[from].setNeedsToForward(true);
 
-    // So we can iterate front to back to get soonest data hazard
-    std::vector<StageType> stageOrder = {
-        StageType::RF,
-        StageType::EX,
-        StageType::DF,
-        StageType::DS
-    };
+    // How far ahead is it? FIX FIX edit with stalls LD
+    int num_cycles_ahead = static_cast<int>(from) - static_cast<int>(to);
+    stages[to].setNumCyclesAhead(dep, num_cycles_ahead);
 
+    forwarding.addForward(from, to);
 
-    // Iterate in the specified order
-    for (StageType stageType : stageOrder) {
 
-        // Find next stage in map
-        auto it = stages.find(stageType);
-        const PipelineStage& pipelineStage = it->second;
+}
 
-        if (pipelineStage.isEmpty()) { continue; }
 
-        // Depends on instruction
-        EXACT_INSTRUCTION stageInstruction = pipelineStage.getExactInstruction();
 
 
-        switch (stageInstruction) {
-            
-            // 1. R-Type instructions, IRR Type, LW, 
-            case SLT:
-            case SLL:
-            case SRL:
-            case SUB:
-            case ADD:
-            case NOP:
-            case AND:
-            case OR:
-            case XOR:
-            case ADDI:
-            case SLTI:
-                result_register = pipelineStage.getDestination();
-                if (register_dependency == result_register) { return stageType; } // A dependency exists
-                break;
-            case LW: //Need a stall to manage this
-                result_register = pipelineStage.getDestination();  /// aaa
-                if (stageType == EX) { 
-                    setRAWStall(2, RF);
-                    break;
-                     }
-                if (stageType == RF) { setRAWStall(2, ID);
-                break; }
-                if (register_dependency != result_register) {break;}
-                return stageType;
-                break;
-            
-            // 2. Since JAL and JALR write in EX, they can only cause a hazard in EX
-            default: // BRANCH type, RET, NOP, SW
-                break;
+void Pipeline::cancelInstruction(StageType stage) {
+    /**
+     * Cancels an instruction, for a JAL or BRANCH stall for example
+     */
+    if (flags.isBranchStalled) { stages[stage].setStalled(); }
+    scoreboard.leave(stage);
+    stages[stage].deallocateInstruction();
+    stages[stage].setNeedsForward(false);
+    stages[stage].setNumCyclesAhead(RS1, -1);
+    stages[stage].setNumCyclesAhead(RS2, -1);
+}
 
 
-        }
 
-       
-    }
+void Pipeline::predictFetch(const Instruction& instruction, uint32_t address, FetchPrediction& prediction) {
+    /**
+     * Branches take their direction from the predictor and their target from the BTB (or predecode
+     * when there is none). Jumps go where the BTB says, RET to the top of the RAS first
+     */
 
-    return NONE;
+    prediction.history = predictor.getHistory();
+    prediction.ras = ras.checkpoint();
+    prediction.taken = false;
+    prediction.redirected = false;
 
-}
+    INST_TYPE type = instruction.getInstType();
 
+    if (type == BRANCH) {
+        prediction.next = branch_target(address, instruction.getImmediate());
+        prediction.taken = predictor.predict(address, prediction.next);
+        prediction.redirected = prediction.taken && (!btb.enabled() || btb.lookup(address, prediction.next));
+        return;
+    }
 
+    if (type != JAL && type != JALR) { return; }
 
-void Pipeline::addDetectedForward(StageType to, StageType from, DEPENDENCY_TYPE dep) {
+    EXACT_INSTRUCTION exact = instruction.getExactInstruction();
+    if (exact == RET && ras.pop(prediction.next)) {
+        prediction.redirected = true;
+        return;
+    }
+    if (exact != RET && instruction.getDestination() == 1) { ras.push(link_address(address)); } // A call
 
-    forwarding.setDetected(true);
+    prediction.redirected = btb.lookup(address, prediction.next);
+}
 
-    Instruction from_instruction = stages[from].getInstructionCopy();
-    Instruction to_instruction = stages[to].getInstructionCopy();
+bool Pipeline::resolveRedirect(bool taken, uint32_t target) {
+    /**
+     * Every branch and jump in EX, with where it really goes. Nothing to undo if fetch already went
+     * there, otherwise fetch restarts on the right path and what is behind it is flushed
+     */
 
-    stages[to].setNeedsForward(true);
-    //stages[from].setNeedsToForward(true);
+    uint32_t address = stages[StageType::EX].getAddress();
+    const FetchPrediction& prediction = fetch_predictions[stages[StageType::EX].getSlot()];
 
-    // How far ahead is it? FIX FIX edit with stalls LD
-    int num_cycles_ahead = static_cast<int>(from) - static_cast<int>(to);
-    stages[to].setNumCyclesAhead(dep, num_cycles_ahead);
+    if (taken) { btb.update(address, target); }
+    if (taken ? (prediction.redirected && prediction.next == target) : !prediction.redirected) { return true; }
 
-    forwarding.addForward(from_instruction, to_instruction, num_cycles_ahead); // FIX FIX !!
+    pc = static_cast<int>(taken ? target : address + 4);
+    pc -= 4; // to account for advancing at beginning of each cycle
 
+    EXACT_INSTRUCTION inst = stages[StageType::EX].getExactInstruction();
+    flags.branchStallsRemaining = instruction_timing[inst].redirect_stalls;
+    flags.isBranchStalled = true;
 
-}
+    // Cancel all instructions prior to jump, then redo what it did to the history or RAS itself
+    squashYounger();
 
+    if (stages[StageType::EX].getInstructionType() == BRANCH) {
+        predictor.setHistory((prediction.history << 1) | static_cast<uint64_t>(taken));
+    } else if (inst == RET) {
+        uint32_t popped;
+        ras.pop(popped);
+    } else if (stages[StageType::EX].getDestination() == 1) {
+        ras.push(link_address(address));
+    }
 
+    return false;
+}
 
+void Pipeline::squashYounger() {
+    /**
+     * Flushes IF..RF behind the instruction in EX, and what their fetch did to the history and RAS
+     */
+    cancelInstruction(IF);
+    cancelInstruction(IS);
+    cancelInstruction(ID);
+    cancelInstruction(RF);
 
-void Pipeline::cancelInstruction(StageType stage) {
+    const FetchPrediction& prediction = fetch_predictions[stages[StageType::EX].getSlot()];
+    predictor.setHistory(prediction.history);
+    ras.restore(prediction.ras);
+}
+
+void Pipeline::dropOlderWrite(uint32_t reg) {
     /**
-     * Cancels an instruction, for a JAL or BRANCH stall for example
+     * A link register is written in EX, so an older write of the same register still in DF or DS
+     * would land after it. What is between has already had it forwarded, and what follows the jump
+     * reads the link in RF, so it is dropped from the scoreboard altogether
      */
-    if (flags.isBranchStalled) { stages[stage].setState("**STALL**"); }
-    stages[stage].deallocateInstruction();
-    stages[stage].setNeedsForward(false);
-    stages[stage].setNumCyclesAhead(RS1, -1);
-    stages[stage].setNumCyclesAhead(RS2, -1);
+    if (reg == 0) { return; }
+
+    for (StageType stage : {DF, DS}) {
+        if (scoreboard.writes[stage] == reg) { scoreboard.leave(stage); }
+    }
 }
 
 
@@ -429,7 +510,7 @@ void Pipeline::registerFetch() {
      */
 
     if (stages[StageType::RF].isEmpty()) {
-        std::cerr << "Cannot fetch register when no instruction in RF." << std::endl;
+        LOG_DEBUG("Cannot fetch register when no instruction in RF.");
         return;
     }
 
@@ -437,8 +518,6 @@ void Pipeline::registerFetch() {
 
     INST_TYPE instruction_type = stages[StageType::RF].getInstructionType();
 
-    if (flags.isRAWStalled) { stages[StageType::RF].setAlreadyCompleted(true); }
-
     switch (instruction_type) {
         case JAL:
         case JALR:
@@ -471,7 +550,7 @@ void Pipeline::registerFetchJType() {
     EXACT_INSTRUCTION instruction = stages[StageType::RF].getExactInstruction();
 
     // Fetch dependencies
-    std::unordered_map<DEPENDENCY_TYPE, uint32_t> dependencies = stages[StageType::RF].getDependencies();
+    Dependencies dependencies = stages[StageType::RF].getDependencies();
     int32_t mem_address_value;
 
 
@@ -493,7 +572,7 @@ void Pipeline::registerFetchJType() {
             stages[StageType::RF].setRegisterValue(RS1, mem_address_value);
             return;
         default:
-            std::cerr << "Could not find specific J type instruction." << std::endl;
+            LOG_ERROR("Could not find specific J type instruction.");
             return;
     }
 
@@ -505,7 +584,7 @@ void Pipeline::registerFetchLoadStore() {
 
     // Get exact instruction and dependencies
     EXACT_INSTRUCTION instruction = stages[StageType::RF].getExactInstruction();
-    std::unordered_map<DEPENDENCY_TYPE, uint32_t> dependencies = stages[StageType::RF].getDependencies();
+    Dependencies dependencies = stages[StageType::RF].getDependencies();
 
     //dependencies[RS1] = getForwardedValue(RF, RS1);
     //dependencies[RS2] = getForwardedValue(RF, RS2);
@@ -515,14 +594,20 @@ void Pipeline::registerFetchLoadStore() {
 
     switch(instruction) {
 
+        case LB:
+        case LH:
         case LW:
+        case LBU:
+        case LHU:
             // Gets just RS1 (address to load from)
             mem_address_value = getIntegerRegister(dependencies[RS1]);
-            std::cout << "LW RS1: " << std::to_string(dependencies[RS1]) << std::endl;
+            LOG_DEBUG("LW RS1: " << dependencies[RS1]);
             stages[StageType::RF].setRegisterValue(RS1, mem_address_value);
-            std::cout << "Fetched: " << std::to_string(mem_address_value) << std::endl;
+            LOG_DEBUG("Fetched: " << mem_address_value);
             return;
 
+        case SB:
+        case SH:
         case SW:
             // Gets RS1 (address to store to) and RS2 (value to store)
             mem_address_value = getIntegerRegister(dependencies[RS1]);
@@ -534,7 +619,7 @@ void Pipeline::registerFetchLoadStore() {
         
 
         default:
-            std::cerr << "Unhandled type not of LW or SW in RF stage" << std::endl;
+            LOG_ERROR("Unhandled type not a load or store in RF stage");
             return;
 
     }
@@ -549,16 +634,21 @@ void Pipeline::registerFetchRType() {
     if (instruction != ADD &&
         instruction != SUB &&
         instruction != SLT &&
+        instruction != SLTU &&
         instruction != SLL &&
+        instruction != SRL &&
+        instruction != SRA &&
         instruction != AND &&
         instruction != OR &&
-        instruction != XOR) {
-            std::cerr << "Incorrect type of instruction passed to registerFetchRType()" << std::endl;
+        instruction != XOR &&
+        instruction_timing[instruction].unit != MULTIPLIER &&
+        instruction_timing[instruction].unit != DIVIDER) {
+            LOG_ERROR("Incorrect type of instruction passed to registerFetchRType()");
             return;
         }
     
     
-    std::unordered_map<DEPENDENCY_TYPE, uint32_t> dependencies = stages[StageType::RF].getDependencies();
+    Dependencies dependencies = stages[StageType::RF].getDependencies();
 
     // Fetch sources from integer register
     int32_t source_1 = getIntegerRegister(dependencies[RS1]);
@@ -577,17 +667,19 @@ void Pipeline::registerFetchIRR() {
      * IMMEDIATE SHOULD ALREADY BE FETCHED IN ID
      */
 
-    // ADDI, SLTI, NOP
+    // ADDI, SLTI, SLTIU, XORI, ORI, ANDI, SLLI, SRLI, SRAI, NOP
 
     // Get exact instruction and dependencies
     EXACT_INSTRUCTION instruction = stages[StageType::RF].getExactInstruction();
 
-    if (instruction != ADDI && instruction != SLTI && instruction != NOP) { 
-        std::cerr << "Improper instruction type passed to registerFetchIRR" << std::endl;
+    if (instruction != ADDI && instruction != SLTI && instruction != SLTIU &&
+        instruction != XORI && instruction != ORI && instruction != ANDI &&
+        instruction != SLLI && instruction != SRLI && instruction != SRAI && instruction != NOP) { 
+        LOG_ERROR("Improper instruction type passed to registerFetchIRR");
         return; }
     if (instruction == NOP) { return; } //just in case i need to handle this later so i dont forget
 
-    std::unordered_map<DEPENDENCY_TYPE, uint32_t> dependencies = stages[StageType::RF].getDependencies();
+    Dependencies dependencies = stages[StageType::RF].getDependencies();
 
     // RS1 is fetched as the source for the operation
     int32_t source_1 = getIntegerRegister(dependencies[RS1]);
@@ -599,7 +691,7 @@ void Pipeline::registerFetchIRR() {
 }
 
 void Pipeline::registerFetchBranch() {
-    // BEQ, BNE, BGE, BLT
+    // BEQ, BNE, BGE, BLT, BGEU, BLTU
     /**
      * Offset should be decoded in ID
      */
@@ -609,12 +701,14 @@ void Pipeline::registerFetchBranch() {
     if (instruction != BEQ &&
         instruction != BNE &&
         instruction != BGE &&
-        instruction != BLT) {
-            std::cerr << "Improper instruction type passed to registerFetchBranch()" << std::endl;
+        instruction != BLT &&
+        instruction != BGEU &&
+        instruction != BLTU) {
+            LOG_ERROR("Improper instruction type passed to registerFetchBranch()");
             return;
         }
 
-    std::unordered_map<DEPENDENCY_TYPE, uint32_t> dependencies = stages[StageType::RF].getDependencies();
+    Dependencies dependencies = stages[StageType::RF].getDependencies();
 
     // Fetch sources from integer register
     int32_t source_1 = getIntegerRegister(dependencies[RS1]);
@@ -645,7 +739,7 @@ void Pipeline::executeInstruction() {
     //
 
     if (stages[StageType::EX].isEmpty()) {
-        std::cerr << "Cannot perform computation when no instruction in EX" << std::endl;
+        LOG_DEBUG("Cannot perform computation when no instruction in EX");
         return;
     }
 
@@ -672,12 +766,28 @@ void Pipeline::executeInstruction() {
         case BRANCH:
             executeBranch();
             break;
+        case LUI:
+        case AUIPC:
+            executeUType();
+            break;
+        case MISC_MEM:
+        case SYSTEM:
+            executeSystem();
+            break;
         default: // unhandled -> BLANK, OTHER
-            std::cerr << "Trying to execute unhandled type" << std::endl;
+            LOG_ERROR("Trying to execute unhandled type");
             return;
         
     }
 
+    // Its unit takes the next instruction "interval" cycles from now, and its result can be used in EX "latency" cycles from now
+    const InstructionTiming& timing = instruction_timing[stages[StageType::EX].getExactInstruction()];
+    scoreboard.unit_free_cycle[timing.unit] = scoreboard.cycle + timing.interval;
+
+    if (writes_register(instruction_type)) {
+        uint32_t destination = stages[StageType::EX].getDestination();
+        if (destination != 0) { scoreboard.ready_cycle[destination] = scoreboard.cycle + timing.latency; }
+    }
 
     return;
 
@@ -686,15 +796,15 @@ void Pipeline::executeInstruction() {
 void Pipeline::dataFetch() {
 
     if (stages[StageType::DF].isEmpty()) {
-        std::cerr << "Cannot store data when no instruction in DF." << std::endl;
+        LOG_DEBUG("Cannot store data when no instruction in DF.");
         return;
     }
 
-    EXACT_INSTRUCTION instruction_type = stages[StageType::DF].getExactInstruction();
+    INST_TYPE instruction_type = stages[StageType::DF].getInstructionType();
 
-    if (instruction_type != SW && instruction_type != LW) { return; } // Only LW and SW
+    if (instruction_type != STORE && instruction_type != LOAD) { return; } // Only loads and stores
 
-    if (instruction_type == SW) {
+    if (instruction_type == STORE) {
 
     
         int32_t newResult = getForwardedValue(DF, RS2); // sees if there is a new result available from forwarding
@@ -703,7 +813,10 @@ void Pipeline::dataFetch() {
         
 
         uint32_t newMemAddress = getForwardedValue(DF, RS1);
-        stages[StageType::DF].setMemAddress(newMemAddress + stages[StageType::EX].getImmediate());
+        stages[StageType::DF].setMemAddress(newMemAddress + stages[StageType::DF].getImmediate());
+
+        // On a data cache miss it stays in DF until the line arrives
+        flags.dataReadyCycle = curr_cycle + 1 + memory_hierarchy.store(stages[StageType::DF].getMemAddress());
 
         //std::cout << "Mem Address (DF): " << std::to_string(stages[StageType::DF].getMemAddress()) << std::endl;
         //std::cout << "Result (DF): " << std::to_string(stages[StageType::DF].getRegisterValues()[RS2]) << std::endl;
@@ -712,8 +825,9 @@ void Pipeline::dataFetch() {
         return;
     }
 
-    if (instruction_type == LW) {
-        return; // FIX FIX FIX
+    if (instruction_type == LOAD) {
+        flags.dataReadyCycle = curr_cycle + 1 + memory_hierarchy.load(stages[StageType::DF].getMemAddress());
+        return;
     }
 
 }
@@ -721,16 +835,17 @@ void Pipeline::dataFetch() {
 void Pipeline::dataStore() {
 
     if (stages[StageType::DS].isEmpty()) {
-        std::cerr << "Cannot store data when no instruction in DS." << std::endl;
+        LOG_DEBUG("Cannot store data when no instruction in DS.");
         return;
     }
 
-    EXACT_INSTRUCTION instruction_type = stages[StageType::DS].getExactInstruction();
+    INST_TYPE instruction_type = stages[StageType::DS].getInstructionType();
+    EXACT_INSTRUCTION instruction = stages[StageType::DS].getExactInstruction();
 
-    // Assumption: Only SW instructions use the DS stage
-    if (instruction_type != SW && instruction_type != LW) { return; }
+    // Assumption: Only loads and stores use the DS stage
+    if (instruction_type != STORE && instruction_type != LOAD) { return; }
 
-    if (instruction_type == SW) {
+    if (instruction_type == STORE) {
 
         //stages[StageType::DS].setResult(getForwardedValue(DS, RS2));
 
@@ -738,14 +853,14 @@ void Pipeline::dataStore() {
         //std::cout << "Result (DS): " << std::to_string(stages[StageType::DS].getResult()) << std::endl;
 
 
-        setDataMemory(stages[StageType::DS].getMemAddress()
+        storeDataMemory(instruction, stages[StageType::DS].getMemAddress()
                     ,stages[StageType::DS].getRegisterValues()[RS2]);
         return;
     }
 
     //LOAD -> set result as retrieved data
-    int32_t retrieved_data = getDataMemory(stages[StageType::DS].getMemAddress());
-    std::cout << "LD MEM ADDRESS: " <<std::to_string(stages[StageType::DS].getMemAddress()) << std::endl;
+    int32_t retrieved_data = loadDataMemory(instruction, stages[StageType::DS].getMemAddress());
+    LOG_DEBUG("LD MEM ADDRESS: " << stages[StageType::DS].getMemAddress());
     stages[StageType::DS].setResult(retrieved_data);
 
     return; 
@@ -757,10 +872,12 @@ void Pipeline::dataStore() {
 void Pipeline::writeBack() {
 
     if (stages[StageType::WB].isEmpty()) {
-        std::cerr << "Cannot write back when no instruction in WB." << std::endl;
+        LOG_DEBUG("Cannot write back when no instruction in WB.");
         return;
     }
 
+    stats.instructions_retired++;
+
     INST_TYPE instruction_type = stages[StageType::WB].getInstructionType();
 
     uint32_t destination;
@@ -768,10 +885,13 @@ void Pipeline::writeBack() {
 
 
     switch(instruction_type) {
-        case I_TYPE: // ADDI, SLTI
+        case I_TYPE: // ADDI, SLTI, ...
         case IRR:
         case LOAD:
+        case LUI:
+        case AUIPC:
             destination = stages[StageType::WB].getDestination();
+            if (scoreboard.writes[WB] != destination) { return; } // A younger JAL/JALR already wrote it
             setIntegerRegister(destination, stages[StageType::WB].getResult());
         default:
             return;
@@ -784,7 +904,7 @@ void Pipeline::handleStalledState() {
     
 
     // Just return out if not stalled
-    if (!flags.isRAWStalled && !flags.isBranchStalled) { return; }
+    if (!flags.isBranchStalled) { return; }
 
     /** 
     std::cout << std::endl << "Handling stall at cycle: " << std::to_string(curr_cycle) << std::endl;
@@ -794,28 +914,6 @@ void Pipeline::handleStalledState() {
     std::cout << "\n\n";
     */
 
-    // Cancel stall if no stall remaining
-    if (flags.RAWstallsRemaining == 0 && flags.isRAWStalled) {
-        flags.isRAWStalled = false;
-        flags.stopStage = NONE;
-        stages[StageType::RF].setAlreadyCompleted(false);
-    } else if (flags.isRAWStalled) {
-        flags.RAWstallsRemaining -= 1;
-        stats.total_loads++;
-
-        if (stages[flags.stopStage].getNeedsForward()) { // Make sure to preserve the distance with ID's other dependencies
-
-            if (stages[flags.stopStage].getNumCyclesAhead(RS1) != -1) {
-                stages[flags.stopStage].setNumCyclesAhead(RS1, stages[StageType::ID].getNumCyclesAhead(RS1) + 1);
-            }
-
-            if (stages[flags.stopStage].getNumCyclesAhead(RS2) != -1) {
-                stages[flags.stopStage].setNumCyclesAhead(RS2, stages[StageType::ID].getNumCyclesAhead(RS2) + 1);
-            }
-
-        }
-    }
-
     if (flags.branchStallsRemaining == 0 && flags.isBranchStalled) {
         flags.isBranchStalled = false;
         stages[StageType::ID].setAlreadyCompleted(false);
@@ -834,32 +932,14 @@ void Pipeline::handleStalledState() {
     return;
 }
 
-void Pipeline::setRAWStall(int numCycles, StageType stopStage) {
-    /**
-     * The stage "stopStage" will not move forward
-     */
-    flags.RAWstallsRemaining = numCycles;
-    flags.isRAWStalled = true;
-    flags.stopStage = stopStage;
-    pc += 4;
-
-    /*
-    std::cout << std::endl << "Executed a raw stall at cycle: " << std::to_string(curr_cycle) << std::endl;
-    std::cout << "Instruction in IF: " << stages[StageType::IF].getNewStyleIstring() << std::endl;
-    std::cout << "Instruction in IS: " << stages[StageType::IS].getNewStyleIstring() << std::endl;
-    std::cout << "Instruction in ID: " << stages[StageType::ID].getNewStyleIstring() << std::endl;
-    std::cout << "\n\n";
-    */
-}
-
 
 
 void Pipeline::executeIRR() {
 
-    // ADDI, SLTI, NOP
+    // ADDI, SLTI, SLTIU, XORI, ORI, ANDI, SLLI, SRLI, SRAI, NOP
 
     // Gets dependencies, destination, and immediate of instruction in EX stage
-    std::unordered_map<DEPENDENCY_TYPE, int32_t> register_values = stages[StageType::EX].getRegisterValues();
+    RegisterValues register_values = stages[StageType::EX].getRegisterValues();
 
     register_values[RS1] = getForwardedValue(EX, RS1);
 
@@ -874,27 +954,49 @@ void Pipeline::executeIRR() {
     // Perform necessary computation
     switch(inst) {
         case ADDI:
-            stages[EX].setResult(source_value + immediate);
+        case NOP: // Wraps around like the hardware
+            stages[EX].setResult(static_cast<int32_t>(static_cast<uint32_t>(source_value) + static_cast<uint32_t>(immediate)));
             return;
         case SLTI:
             stages[EX].setResult((static_cast<int32_t>(source_value) < immediate) ? 1 : 0);
             return;
+        case SLTIU: // The immediate is sign extended, then compared unsigned
+            stages[EX].setResult((static_cast<uint32_t>(source_value) < static_cast<uint32_t>(immediate)) ? 1 : 0);
+            return;
+        case XORI:
+            stages[EX].setResult(source_value ^ immediate);
+            return;
+        case ORI:
+            stages[EX].setResult(source_value | immediate);
+            return;
+        case ANDI:
+            stages[EX].setResult(source_value & immediate);
+            return;
+        case SLLI:
+            stages[EX].setResult(static_cast<int32_t>(static_cast<uint32_t>(source_value) << (immediate & 0x1F)));
+            return;
+        case SRLI:
+            stages[EX].setResult(static_cast<int32_t>(static_cast<uint32_t>(source_value) >> (immediate & 0x1F)));
+            return;
+        case SRAI:
+            stages[EX].setResult(source_value >> (immediate & 0x1F));
+            return;
         default:
-            std::cerr << "Could not execute IRR Type Instruction" << std::endl;
+            LOG_ERROR("Could not execute IRR Type Instruction");
             return;
     }
 
 }
 
 void Pipeline::executeRType() {
-    // ADD, SUB, SLL, SRL, SLT, AND, OR, XOR
+    // ADD, SUB, SLL, SRL, SRA, SLT, SLTU, AND, OR, XOR, and the M extension
 
     // Get dependencies and destination
-    std::unordered_map<DEPENDENCY_TYPE, int32_t> register_values = stages[StageType::EX].getRegisterValues();
-    std::cout << "RS1: " << std::to_string(register_values[RS1]) << std::endl << "RS2: " << std::to_string(register_values[RS2]) << std::endl;
+    RegisterValues register_values = stages[StageType::EX].getRegisterValues();
+    LOG_DEBUG("RS1: " << register_values[RS1] << "\nRS2: " << register_values[RS2]);
     register_values[RS1] = getForwardedValue(EX, RS1);
     register_values[RS2] = getForwardedValue(EX, RS2);
-    std::cout << "RS1: " << std::to_string(register_values[RS1]) << std::endl << "RS2: " << std::to_string(register_values[RS2]) << std::endl;
+    LOG_DEBUG("RS1: " << register_values[RS1] << "\nRS2: " << register_values[RS2]);
     // Gets the exact instruction we need to compute
     EXACT_INSTRUCTION inst = stages[StageType::EX].getExactInstruction();
 
@@ -903,21 +1005,27 @@ void Pipeline::executeRType() {
 
     //Perform necessary computation
     switch(inst) {
-        case ADD:
-            stages[EX].setResult(source_register_1 + source_register_2);
+        case ADD: // ADD, SUB and SLL wrap around like the hardware
+            stages[EX].setResult(static_cast<int32_t>(static_cast<uint32_t>(source_register_1) + static_cast<uint32_t>(source_register_2)));
             return;
         case SUB:
-            stages[EX].setResult(source_register_1 - source_register_2);
+            stages[EX].setResult(static_cast<int32_t>(static_cast<uint32_t>(source_register_1) - static_cast<uint32_t>(source_register_2)));
             return;
         case SLL:
-            stages[EX].setResult((source_register_1 << (source_register_2 & 0x1F)));
+            stages[EX].setResult(static_cast<int32_t>(static_cast<uint32_t>(source_register_1) << (source_register_2 & 0x1F)));
             return;
         case SRL:
             stages[EX].setResult((static_cast<uint32_t>(source_register_1) >> (source_register_2 & 0x1F)));
             return;
+        case SRA:
+            stages[EX].setResult(source_register_1 >> (source_register_2 & 0x1F));
+            return;
         case SLT:
             stages[EX].setResult((static_cast<int32_t>(source_register_1) < static_cast<int32_t>(source_register_2)) ? 1 : 0);
             return;
+        case SLTU:
+            stages[EX].setResult((static_cast<uint32_t>(source_register_1) < static_cast<uint32_t>(source_register_2)) ? 1 : 0);
+            return;
         case AND:
             stages[EX].setResult(source_register_1 & source_register_2);
             return;
@@ -927,12 +1035,44 @@ void Pipeline::executeRType() {
         case XOR:
             stages[EX].setResult(source_register_1 ^ source_register_2);
             return;
+
+        // M extension, the result is computed now and dependents wait out the unit's latency
+        case MUL:
+            stages[EX].setResult(static_cast<int32_t>(static_cast<uint32_t>(source_register_1) * static_cast<uint32_t>(source_register_2)));
+            break;
+        case MULH:
+            stages[EX].setResult(static_cast<int32_t>((int64_t(source_register_1) * int64_t(source_register_2)) >> 32));
+            break;
+        case MULHSU:
+            stages[EX].setResult(static_cast<int32_t>((int64_t(source_register_1) * int64_t(static_cast<uint32_t>(source_register_2))) >> 32));
+            break;
+        case MULHU:
+            stages[EX].setResult(static_cast<int32_t>((uint64_t(static_cast<uint32_t>(source_register_1)) * static_cast<uint32_t>(source_register_2)) >> 32));
+            break;
+        case DIV: // Division by zero gives -1 and INT32_MIN / -1 overflows to INT32_MIN, as the spec says (no trap)
+            if (source_register_2 == 0) { stages[EX].setResult(-1); }
+            else if (source_register_1 == INT32_MIN && source_register_2 == -1) { stages[EX].setResult(INT32_MIN); }
+            else { stages[EX].setResult(source_register_1 / source_register_2); }
+            break;
+        case DIVU:
+            if (source_register_2 == 0) { stages[EX].setResult(-1); }
+            else { stages[EX].setResult(static_cast<int32_t>(static_cast<uint32_t>(source_register_1) / static_cast<uint32_t>(source_register_2))); }
+            break;
+        case REM:
+            if (source_register_2 == 0) { stages[EX].setResult(source_register_1); }
+            else if (source_register_1 == INT32_MIN && source_register_2 == -1) { stages[EX].setResult(0); }
+            else { stages[EX].setResult(source_register_1 % source_register_2); }
+            break;
+        case REMU:
+            if (source_register_2 == 0) { stages[EX].setResult(source_register_1); }
+            else { stages[EX].setResult(static_cast<int32_t>(static_cast<uint32_t>(source_register_1) % static_cast<uint32_t>(source_register_2))); }
+            break;
+
         default:
-            std::cerr << "Could not execute R Type Instruction" << std::endl;
+            LOG_ERROR("Could not execute R Type Instruction");
             return;
             
     }
-    
 
 }
 
@@ -941,10 +1081,10 @@ void Pipeline::executeLoad() {
     // Get offset, register, destination
     int32_t offset = stages[StageType::EX].getImmediate();
     uint32_t destination = stages[StageType::EX].getDestination();
-    std::unordered_map<DEPENDENCY_TYPE, int32_t> register_values = stages[StageType::EX].getRegisterValues();
+    RegisterValues register_values = stages[StageType::EX].getRegisterValues();
     register_values[RS1] = getForwardedValue(EX, RS1);
 
-    std::cout << "Forwarded value: " << std::to_string(register_values[RS1]) << std::endl;
+    LOG_DEBUG("Forwarded value: " << register_values[RS1]);
     
     // Does string manip to get everything into useable form
     std::string destination_register = "R" + std::to_string(destination);
@@ -955,9 +1095,9 @@ void Pipeline::executeLoad() {
     // Calculate effective memory address
     uint32_t memory_address = base_address + offset;
 
-    // Validate memory address (optional, based on your memory bounds)
-    if (memory_address < 600 || memory_address > 1000) {
-        std::cerr << "Memory access violation at address: " << memory_address << std::endl;
+    // Validate memory address against the memory map
+    if (!data_memory.isMapped(memory_address, memory_access_bytes(stages[StageType::EX].getExactInstruction()))) {
+        LOG_ERROR("Memory access violation at address: " << memory_address);
         return; // Early return or handle error
     }
 
@@ -975,7 +1115,7 @@ void Pipeline::executeStore() {
 
     // Get offset, destination (base register), and dependencies (source register rs2)
     int32_t offset = stages[StageType::EX].getImmediate();
-    std::unordered_map<DEPENDENCY_TYPE, int32_t> register_values = stages[StageType::EX].getRegisterValues();
+    RegisterValues register_values = stages[StageType::EX].getRegisterValues();
     
     uint32_t base_address = register_values[RS1];
     base_address = getForwardedValue(EX, RS1);
@@ -992,7 +1132,7 @@ void Pipeline::executeStore() {
 }
 
 void Pipeline::executeJType() {
-    // JAL, JALR
+    // JAL, J, JALR, RET
 
     int32_t offset = stages[StageType::EX].getImmediate();
     uint32_t pc_place_addr = stages[StageType::EX].getDestination(); // Address to place current PC
@@ -1000,58 +1140,47 @@ void Pipeline::executeJType() {
     uint32_t base_address;
 
 
-    std::unordered_map<DEPENDENCY_TYPE, int32_t> register_values = stages[StageType::EX].getRegisterValues();
+    RegisterValues register_values = stages[StageType::EX].getRegisterValues();
     register_values[RS1] = getForwardedValue(EX, RS1);
 
     // Gets the exact instruction we need to compute
     EXACT_INSTRUCTION inst = stages[StageType::EX].getExactInstruction();
 
+    uint32_t address = stages[StageType::EX].getAddress();
+
     switch(inst) {
         case J:
-            pc = 520;
-            flags.branchStallsRemaining = 8;
-            flags.isBranchStalled = true;
-
-            // Cancel all instructions prior to jump
-            cancelInstruction(IF);
-            cancelInstruction(IS);
-            cancelInstruction(ID);
-            cancelInstruction(RF);
-            sendNextInstruction();
+            // Always to 520, and fetch starts there this same cycle
+            stats.jumps++;
+            if (!resolveRedirect(true, 520)) {
+                stats.target_mispredictions++;
+                pc += 4;
+                sendNextInstruction();
+            }
 
             return;
 
 
         case JAL_E:
-            setIntegerRegister(pc_place_addr, pipeline_registers.npc);
-            pc += offset;
-            pc -= 4; // to account for advancing at beginning of each cycle
-
-            flags.branchStallsRemaining = 8;
-            flags.isBranchStalled = true;
-
-            // Cancel all instructions prior to jump
-            cancelInstruction(IF);
-            cancelInstruction(IS);
-            cancelInstruction(ID);
-            cancelInstruction(RF);
-            
+            stats.jumps++;
+            dropOlderWrite(pc_place_addr);
+            setIntegerRegister(pc_place_addr, static_cast<int32_t>(link_address(address)));
+
+            if (!resolveRedirect(true, branch_target(address, offset))) { stats.target_mispredictions++; }
 
             return;
         case JALR_E: //check this
+            stats.jumps++;
             base_address = register_values[RS1];
-            setIntegerRegister(pc_place_addr, pipeline_registers.npc);
-            pc = (base_address + offset) & ~1;
-            pc -= 4; // to account for advancing at beginning of each cycle
+            dropOlderWrite(pc_place_addr);
+            setIntegerRegister(pc_place_addr, static_cast<int32_t>(link_address(address)));
 
-            flags.branchStallsRemaining = 8;
-            flags.isBranchStalled = true;
+            if (!resolveRedirect(true, (base_address + offset) & ~1u)) { stats.target_mispredictions++; }
 
-            // Cancel all instructions prior to jump
-            cancelInstruction(IF);
-            cancelInstruction(IS);
-            cancelInstruction(ID);
-            cancelInstruction(RF);
+            return;
+        case RET: // JALR x0, x1, 0
+            stats.jumps++;
+            if (!resolveRedirect(true, register_values[RS1] & ~1u)) { stats.target_mispredictions++; }
 
             return;
 
@@ -1065,14 +1194,14 @@ void Pipeline::executeJType() {
 
 void Pipeline::executeBranch() {
     
-    std::unordered_map<DEPENDENCY_TYPE, int32_t> register_values = stages[StageType::EX].getRegisterValues();
+    RegisterValues register_values = stages[StageType::EX].getRegisterValues();
     register_values[RS1] = getForwardedValue(EX, RS1);
     register_values[RS2] = getForwardedValue(EX, RS2);
 
     int32_t offset = stages[StageType::EX].getImmediate();
 
-    uint32_t term1 = register_values[RS1];
-    uint32_t term2 = register_values[RS2];
+    int32_t term1 = register_values[RS1];
+    int32_t term2 = register_values[RS2];
 
     // Gets the exact instruction we need to compute
     EXACT_INSTRUCTION inst = stages[StageType::EX].getExactInstruction();
@@ -1091,35 +1220,300 @@ void Pipeline::executeBranch() {
             if (term1 >= term2) { takeBranch = true; }
             break; 
         case BLT:
-            if (term1 <= term2) { takeBranch = true; }
+            if (term1 < term2) { takeBranch = true; }
+            break;
+        case BGEU:
+            if (static_cast<uint32_t>(term1) >= static_cast<uint32_t>(term2)) { takeBranch = true; }
+            break;
+        case BLTU:
+            if (static_cast<uint32_t>(term1) < static_cast<uint32_t>(term2)) { takeBranch = true; }
             break;
         default:
-            std::cerr << "Could not determine branch instruction" << std::endl;
+            LOG_ERROR("Could not determine branch instruction");
             return;
     }
 
-    // If condition is not met, don't take the branch
-    if (!takeBranch) { return; }
-    
-    stats.total_branches++;
-    pc += offset;
-    pc -= 4; //to account for auto advancing
+    // Train on the history it was predicted with
+    uint32_t address = stages[StageType::EX].getAddress();
+    const FetchPrediction& prediction = fetch_predictions[stages[StageType::EX].getSlot()];
 
+    predictor.update(address, prediction.history, takeBranch);
+    stats.branches++;
+    if (takeBranch != prediction.taken) { stats.mispredictions++; }
 
-    flags.branchStallsRemaining = 8;
-    flags.isBranchStalled = true;
+    if (resolveRedirect(takeBranch, branch_target(address, offset))) { return; }
 
-    // Cancel all instructions prior to jump
-    cancelInstruction(IF);
-    cancelInstruction(IS);
-    cancelInstruction(ID);
-    cancelInstruction(RF);
+    stats.total_branches++; // Branch stalls, only what fetch got wrong flushes
+    if (takeBranch == prediction.taken) { stats.target_mispredictions++; }
 
-    return;
+}
 
-    
+void Pipeline::executeUType() {
+    // LUI, AUIPC
+
+    // Immediate is already shifted into the upper 20 bits
+    int32_t immediate = stages[StageType::EX].getImmediate();
+
+    EXACT_INSTRUCTION inst = stages[StageType::EX].getExactInstruction();
+
+    switch(inst) {
+        case LUI_E:
+            stages[EX].setResult(immediate);
+            return;
+        case AUIPC_E: // Relative to the address the AUIPC itself was fetched from
+            stages[EX].setResult(static_cast<int32_t>(stages[StageType::EX].getAddress() + static_cast<uint32_t>(immediate)));
+            return;
+        default:
+            LOG_ERROR("Could not execute U Type Instruction");
+            return;
+    }
+
+}
+
+void Pipeline::executeSystem() {
+    // FENCE, ECALL, EBREAK
+
+    EXACT_INSTRUCTION inst = stages[StageType::EX].getExactInstruction();
+
+    switch(inst) {
+        case FENCE: // One in-order core and one memory, there is nothing to order
+            return;
+        case ECALL: // No environment to trap to, so both end the program
+        case EBREAK:
+            flags.halted = true;
+
+            // Nothing after it runs, what is ahead of it drains
+            squashYounger();
+            return;
+        default:
+            LOG_ERROR("Could not execute system instruction");
+            return;
+    }
+
+}
 
 
+
+
+const InstructionTimingTable& default_instruction_timing() {
+    /**
+     * Built at compile time from timing.def, which must give every exact instruction a line
+     */
+
+    struct Built {
+        InstructionTimingTable table;
+        bool complete;
+    };
+
+    static constexpr Built built = [] {
+        Built result{};
+        std::array<bool, NUM_EXACT_INSTRUCTIONS> seen = {};
+        result.table[ERROR_EXACT_INSTRUCTION] = InstructionTiming(); // Not executed, but indexed like the rest
+        seen[ERROR_EXACT_INSTRUCTION] = true;
+#define TIMING(name, unit, result_stage, latency, interval, data_stage, redirect_stalls) \
+        result.table[name] = {unit, result_stage, latency, interval, data_stage, redirect_stalls}; \
+        seen[name] = true;
+#include "../include/timing.def"
+#undef TIMING
+        result.complete = true;
+        for (bool line : seen) { result.complete = result.complete && line; }
+        return result;
+    }();
+
+    static_assert(built.complete, "Every instruction in isa.def needs a line in timing.def");
+
+    return built.table;
+
+}
+
+bool Pipeline::setInstructionTiming(EXACT_INSTRUCTION instruction, InstructionTiming timing) {
+    /**
+     * A unit can't accept work faster than every cycle or slower than it finishes it, and a result
+     * can't be forwarded before the stage that produces it has it
+     */
+
+    if (instruction >= ERROR_EXACT_INSTRUCTION || timing.unit >= NUM_FUNCTIONAL_UNITS) {
+        std::cerr << "Error: Unknown instruction or functional unit." << std::endl;
+        return false;
+    }
+
+    if (timing.interval < 1 || timing.interval > timing.latency) {
+        std::cerr << "Error: Issue interval " << int(timing.interval) << " of " << exact_instruction_name(instruction)
+                  << " must be between 1 and its latency " << int(timing.latency) << "." << std::endl;
+        return false;
+    }
+
+    if (timing.result_stage != NONE && (timing.result_stage < EX || timing.latency < timing.result_stage - EX + 1)) {
+        std::cerr << "Error: " << exact_instruction_name(instruction) << " needs a latency of at least "
+                  << int(timing.result_stage) - EX + 1 << " for its result to exist." << std::endl;
+        return false;
+    }
+
+    instruction_timing[instruction] = timing;
+    return true;
+
+}
+
+const InstructionTiming& Pipeline::getInstructionTiming(EXACT_INSTRUCTION instruction) const { return instruction_timing[instruction]; }
+
+bool Pipeline::setFunctionalUnitTiming(FunctionalUnit unit, FunctionalUnitTiming timing) {
+
+    if (unit >= NUM_FUNCTIONAL_UNITS) {
+        std::cerr << "Error: Unknown functional unit." << std::endl;
+        return false;
+    }
+
+    if (timing.latency > 255 || timing.interval < 1 || timing.interval > timing.latency) {
+        std::cerr << "Error: Functional unit issue interval " << timing.interval
+                  << " must be between 1 and its latency " << timing.latency << " (at most 255)." << std::endl;
+        return false;
+    }
+
+    // A rejected timing leaves every instruction as it was
+    InstructionTimingTable previous = instruction_timing;
+
+    for (std::size_t instruction = 0; instruction < ERROR_EXACT_INSTRUCTION; instruction++) {
+
+        if (previous[instruction].unit != unit) { continue; }
+
+        InstructionTiming retimed = previous[instruction];
+        retimed.latency = static_cast<uint8_t>(timing.latency);
+        retimed.interval = static_cast<uint8_t>(timing.interval);
+
+        if (!setInstructionTiming(static_cast<EXACT_INSTRUCTION>(instruction), retimed)) {
+            instruction_timing = previous;
+            return false;
+        }
+    }
+
+    return true;
+
+}
+
+FunctionalUnitTiming Pipeline::getFunctionalUnitTiming(FunctionalUnit unit) const {
+
+    for (std::size_t instruction = 0; instruction < ERROR_EXACT_INSTRUCTION; instruction++) {
+        if (instruction_timing[instruction].unit == unit) {
+            return FunctionalUnitTiming(instruction_timing[instruction].latency, instruction_timing[instruction].interval);
+        }
+    }
+
+    return FunctionalUnitTiming();
+
+}
+
+bool Pipeline::setBranchPredictor(BranchPredictorConfig config) {
+    /**
+     * Tables start cold, so it is meant to be set before the program runs
+     */
+
+    if (!predictor.configure(config)) { return false; }
+
+    for (FetchPrediction& prediction : fetch_predictions) { prediction = FetchPrediction(); }
+    return true;
+
+}
+
+const BranchPredictor& Pipeline::getBranchPredictor() const { return predictor; }
+
+bool Pipeline::setBranchTargetBuffer(BranchTargetBufferConfig config) { return btb.configure(config); }
+
+const BranchTargetBuffer& Pipeline::getBranchTargetBuffer() const { return btb; }
+
+bool Pipeline::setReturnAddressStack(unsigned depth) { return ras.configure(depth); }
+
+const ReturnAddressStack& Pipeline::getReturnAddressStack() const { return ras; }
+
+bool Pipeline::setMemoryHierarchy(const MemoryHierarchyConfig& config) { return memory_hierarchy.configure(config); }
+
+const MemoryHierarchy& Pipeline::getMemoryHierarchy() const { return memory_hierarchy; }
+
+uint32_t Pipeline::waitingOnResult(bool& unreachable) {
+    /**
+     * The register the instruction in RF reads but can't have if it moves to EX now, 0 if none
+     * Its producers are all in EX or later and have executed, so their ready cycles are known.
+     * rs2 is needed once it reaches its data_stage (DF for a store's data)
+     */
+
+    if (stages[StageType::RF].isEmpty()) { return 0; }
+
+    INST_TYPE instruction_type = stages[StageType::RF].getInstructionType();
+    if (instruction_type == JAL || instruction_type == BLANK || instruction_type == OTHER) { return 0; }
+
+    Dependencies dependencies = stages[StageType::RF].getDependencies();
+    const InstructionTiming& timing = instruction_timing[stages[StageType::RF].getExactInstruction()];
+
+    if (!operandReady(dependencies[RS1], EX, unreachable)) { return dependencies[RS1]; }
+    if (!operandReady(dependencies[RS2], timing.data_stage, unreachable)) { return dependencies[RS2]; }
+
+    return 0;
+
+}
+
+bool Pipeline::operandReady(uint32_t reg, StageType needed, bool& unreachable) {
+    /**
+     * Moving to EX now, the instruction reaches "needed" needed - EX cycles later. By then the result
+     * must exist (its latency), and the producer must be where an enabled path reaches from, or
+     * have written back (RF reads the register file again every cycle it is held).
+     * Before "needed", a value is only taken from WB, the last stage it can be forwarded from
+     */
+
+    if (scoreboard.ready_cycle[reg] > scoreboard.cycle + (needed - EX)) { return false; }
+
+    StageType producer = scoreboard.producerAfter(reg, RF);
+    if (producer == NONE) { return true; }
+
+    // Where the producer is once everything has moved on a stage
+    int from = producer + 1;
+    for (int stage = EX; stage <= needed; stage++, from++) {
+        if (from > WB) { return true; }
+        if ((stage == needed || from == WB) && bypass.allows(StageType(from), StageType(stage))) { return true; }
+        if (from == WB) { break; }
+    }
+
+    unreachable = true;
+    return false;
+
+}
+
+bool Pipeline::functionalUnitBusy() {
+
+    if (stages[StageType::RF].isEmpty()) { return false; }
+
+    EXACT_INSTRUCTION instruction = stages[StageType::RF].getExactInstruction();
+    return scoreboard.unit_free_cycle[instruction_timing[instruction].unit] > scoreboard.cycle;
+
+}
+
+void Pipeline::holdFrontEnd(StageType last_held) {
+    /**
+     * Everything up to and including last_held stays put this cycle while the stages after it move,
+     * so ID..EX are one more cycle behind any producer that has already left last_held. EX (held
+     * behind DF) has executed and won't read registers again, so store data it still waits on is
+     * taken as its producer reaches WB, or from the register file once it has left
+     */
+
+    for (StageType stage : {StageType::ID, StageType::RF, StageType::EX}) {
+
+        if (stage > last_held || stages[stage].isEmpty() || !stages[stage].getNeedsForward()) { continue; }
+
+        for (DEPENDENCY_TYPE dep : {RS1, RS2}) {
+            int num_cycles_ahead = stages[stage].getNumCyclesAhead(dep);
+            if (num_cycles_ahead == -1 || static_cast<int>(stage) + num_cycles_ahead <= static_cast<int>(last_held)) { continue; }
+
+            int now_in = static_cast<int>(stage) + num_cycles_ahead + 1;
+            if (stage == EX && now_in >= static_cast<int>(WB)) {
+                uint32_t reg = stages[stage].getDependencies()[dep];
+                if (now_in > static_cast<int>(WB)) { stages[stage].setRegisterValue(dep, getIntegerRegister(reg)); }
+                else if (scoreboard.writes[WB] == reg) { stages[stage].setRegisterValue(dep, stages[WB].getResult()); }
+                stages[stage].setNumCyclesAhead(dep, -1);
+                continue;
+            }
+
+            stages[stage].setNumCyclesAhead(dep, num_cycles_ahead + 1);
+        }
+    }
+
 }
 
 
@@ -1146,36 +1540,59 @@ uint32_t Pipeline::getForwardedValue(StageType stage, DEPENDENCY_TYPE dep) {
         else { return stages[stage].getRegisterValues()[dep]; }
     } // if this dependency is fine just return proper value
 
+    // Can land past WB, so check before indexing
     StageType from = static_cast<StageType>(static_cast<int>(stage) + num_cycles_ahead);
-    uint32_t value = stages[from].getResult();
-
 
     if (!isValidForward(from, stage)) {
         if (false) { return stages[stage].getDependencies()[dep]; }
         else { return stages[stage].getRegisterValues()[dep]; }
     }
 
+    // Its write was dropped for a younger JAL/JALR's link, which RF read
+    if (scoreboard.writes[from] != stages[stage].getDependencies()[dep]) { return stages[stage].getRegisterValues()[dep]; }
 
-    std::cout << "Forwarded " << value << " from " << stages[from].getStageName() << " to " << stages[stage].getStageName() << std::endl;
+    uint32_t value = stages[from].getResult();
+
+
+    LOG_DEBUG("Forwarded " << value << " from " << stages[from].getStageName() << " to " << stages[stage].getStageName());
     
 
     
-    forwarding.completeForward(from, stage, stages[from].getInstructionCopy(), stages[stage].getInstructionCopy(), &stats);
+    forwarding.completeForward(from, stage, &stats);
     stages[stage].setNumCyclesAhead(dep, -1); //make it so you cant forward again
 
     return value;
 
 }
 
-bool Pipeline::isValidForward(StageType from, StageType to) {
-    if ((from == StageType::DF && to == StageType::EX) || 
-        (from == StageType::DS && to == StageType::DF) || 
-        (from == StageType::DS && to == StageType::EX) || 
-        (from == StageType::WB && to == StageType::DF) || 
-        (from == StageType::WB && to == StageType::EX)) {
-        return true;
+bool Pipeline::isValidForward(StageType from, StageType to) { return bypass.allows(from, to); }
+
+bool Pipeline::setForwardingPath(StageType from, StageType to, bool enabled) {
+
+    if (!forward_path_exists(from, to)) {
+        std::cerr << "Error: There is no forwarding path from " << stage_type_name(from) << " to " << stage_type_name(to) << "." << std::endl;
+        return false;
     }
-    return false;
+
+    bypass.set(from, to, enabled);
+    return true;
+
+}
+
+const BypassNetwork& Pipeline::getBypassNetwork() const { return bypass; }
+
+std::string forward_path_name(StageType from, StageType to) {
+    /**
+     * Named by the pipeline registers the value travels between, the one in front of each stage
+     */
+
+    std::string name;
+    name.reserve(14);
+    name.append(stage_type_name(StageType(from - 1))).append("/").append(stage_type_name(from));
+    name.append(" -> ");
+    name.append(stage_type_name(StageType(to - 1))).append("/").append(stage_type_name(to));
+
+    return name;
 }
 
 
@@ -1186,29 +1603,101 @@ bool Pipeline::isValidForward(StageType from, StageType to) {
 
 bool Pipeline::setDataMemory(uint32_t address, int32_t data) {
     /**
-     * Attempts to place data into address, if this exceeds bounds returns false
+     * Attempts to place data into address, if it is unaligned or not writable returns false
+     */
+
+    return storeDataMemory(SW, address, data);
+
+}
+
+GuestMemory& Pipeline::getMemory() { return data_memory; }
+
+uint32_t memory_access_bytes(EXACT_INSTRUCTION instruction) {
+    switch (instruction) {
+        case LB:
+        case LBU:
+        case SB:
+            return 1;
+        case LH:
+        case LHU:
+        case SH:
+            return 2;
+        default:
+            return 4;
+    }
+}
+
+bool Pipeline::storeDataMemory(EXACT_INSTRUCTION store, uint32_t address, int32_t data) {
+    /**
+     * SB/SH/SW, the low byte/halfword/word of data. Unaligned or unwritable addresses return false
      */
 
-    if (address < 600 || address > 1000 || address % 4 != 0) {
-        std::cerr << "Memory access violation at address: " << address << std::endl;
+    uint32_t bytes = memory_access_bytes(store);
+    bool stored = false;
+
+    if (address % bytes == 0) {
+        switch (bytes) {
+            case 1: stored = data_memory.write8(address, static_cast<uint8_t>(data)); break;
+            case 2: stored = data_memory.write16(address, static_cast<uint16_t>(data)); break;
+            default: stored = data_memory.write32(address, static_cast<uint32_t>(data)); break;
+        }
+    }
+
+    if (!stored) {
+        LOG_ERROR("Memory access violation at address: " << address);
         return false;
-    }   
+    }
 
-    data_memory[address] = data;
     return true;
 
 }
 
-int32_t Pipeline::getDataMemory(uint32_t address) {
+int32_t Pipeline::loadDataMemory(EXACT_INSTRUCTION load, uint32_t address) {
+    /**
+     * LB/LH/LW/LBU/LHU, sign or zero extended to 32 bits
+     */
 
-    // Check if the address exists in the data_memory map
-    if (data_memory.find(address) != data_memory.end()) {
-        // Address exists, return the value
-        return data_memory[address];
-    } else {
-        // Address does not exist, throw an error
-        throw std::runtime_error(("Memory access violation (Cycle) " + std::to_string((curr_cycle - 1)) + ": Address " + std::to_string(address) + " is not valid in data memory."));
+    uint8_t byte = 0;
+    uint16_t half = 0;
+    uint32_t word = 0;
+    bool loaded = false;
+    int32_t value = 0;
+
+    switch (load) {
+        case LB:
+            loaded = data_memory.read8(address, byte);
+            value = static_cast<int8_t>(byte);
+            break;
+        case LBU:
+            loaded = data_memory.read8(address, byte);
+            value = byte;
+            break;
+        case LH:
+            loaded = data_memory.read16(address, half);
+            value = static_cast<int16_t>(half);
+            break;
+        case LHU:
+            loaded = data_memory.read16(address, half);
+            value = half;
+            break;
+        default:
+            loaded = data_memory.read32(address, word);
+            value = static_cast<int32_t>(word);
+            break;
     }
+
+    if (!loaded) {
+        // Address does not exist, the run stops at the end of this cycle
+        fault(MEMORY_FAULT, "Memory access violation (Cycle) " + std::to_string((curr_cycle - 1)) + ": Address " + std::to_string(address) + " is not valid in data memory.");
+        return 0;
+    }
+
+    return value;
+}
+
+int32_t Pipeline::getDataMemory(uint32_t address) {
+    // Faults (the run stops at the end of this cycle) if address is not mapped
+    return loadDataMemory(LW, address);
 }
 
 
@@ -1218,7 +1707,7 @@ int32_t Pipeline::getDataMemory(uint32_t address) {
  * TO STRING FUNCTIONS
  */
 
-std::string Pipeline::getCycleOutput() {
+std::string Pipeline::getCycleOutput(bool changed_registers_only) {
 
     std::ostringstream output;
 
@@ -1236,13 +1725,14 @@ std::string Pipeline::getCycleOutput() {
     // Stall Instruction
     output << "\n" << getStalledInstruction();
 
-    output << "\n" << forwarding.toString() << "\n";
+    output << "\n" << getForwardingOutput() << "\n";
 
     // Pipeline Registers
     output << "\n" << getPipelineRegistersOutput() << "\n";
 
     // Integer Registers
-    output << getIntegerRegistersOutput() << "\n";
+    output << getIntegerRegistersOutput(changed_registers_only) << "\n";
+    if (changed_registers_only) { clearDirtyRegisters(); }
 
     output << getDataMemoryOutput() << "\n";
 
@@ -1253,6 +1743,48 @@ std::string Pipeline::getCycleOutput() {
     return output.str();
 }
 
+std::string Pipeline::getForwardingOutput() {
+    /**
+     * Every path that exists is listed, nearest producer first, with what it forwarded this cycle
+     */
+
+    std::ostringstream output;
+    char from_text[MAX_FORMATTED_LENGTH];
+    char to_text[MAX_FORMATTED_LENGTH];
+
+    output << "Forwarding:\n";
+
+    if (forwarding.num_detected == 0) {
+        output << " Detected: (none)\n";
+    } else {
+        output << " Detected:\n";
+        for (std::size_t i = 0; i < forwarding.num_detected; ++i) {
+            const auto& [from, to] = forwarding.detected[i];
+            output << "  [" << i << "] "
+                << "(" << std::string_view(from_text, format_new_style(stages[from].getInstructionCopy(), from_text)) << ") to ("
+                << std::string_view(to_text, format_new_style(stages[to].getInstructionCopy(), to_text)) << ")\n";
+        }
+    }
+
+    output << " Forwarded:\n";
+    for (int from = DF; from <= WB; from++) {
+        for (int to = from - 1; to >= EX; to--) {
+
+            if (!forward_path_exists(StageType(from), StageType(to))) { continue; }
+
+            output << " * " << forward_path_name(StageType(from), StageType(to)) << " : ";
+            if (!((forwarding.completed >> forward_path(StageType(from), StageType(to))) & 1)) { output << "(none)"; }
+            else {
+                output << "(" << std::string_view(from_text, format_new_style(stages[from].getInstructionCopy(), from_text)) << ") to ( "
+                       << std::string_view(to_text, format_new_style(stages[to].getInstructionCopy(), to_text)) << ")";
+            }
+            output << "\n";
+        }
+    }
+
+    return output.str();
+}
+
 std::string Pipeline::getPipelineStatusOutput() {
     std::string output;
     output += "Pipeline Status: \n";
@@ -1270,23 +1802,34 @@ std::string Pipeline::getPipelineStatusOutput() {
     return output;
 }
 
-std::string Pipeline::getIntegerRegistersOutput() {
+std::string Pipeline::getIntegerRegistersOutput(bool changed_only) {
     /**
      * Returns string of integer register results
+     * changed_only keeps the same layout but skips every register not in the dirty mask
      */
 
     std::string output = "Integer registers:\n";
 
+    uint32_t shown = changed_only ? integer_registers.dirty : 0xFFFFFFFFu;
+
+    if (shown == 0) { return output + "(none)\n"; }
+
+    int count = 0;
+
     // Iterate over register indices from 0 to 31
     for (int i = 0; i < 32; ++i) {
-        output += "R" + std::to_string(i) + "\t" + std::to_string(getIntegerRegister(i)) + "\t";
+        if (!(shown & (1u << i))) { continue; }
+
+        output += "R" + std::to_string(i) + "\t" + std::to_string(integer_registers.read(i)) + "\t";
 
         // Add a newline after every 4 registers
-        if ((i + 1) % 4 == 0) {
+        if (++count % 4 == 0) {
             output += "\n";
         }
     }
 
+    if (count % 4 != 0) { output += "\n"; }
+
     return output;
 }
 
@@ -1328,12 +1871,8 @@ std::string Pipeline::getDataMemoryOutput() const {
     std::ostringstream output;
 
     output << "Data memory:\n";
-    for (int addr = 600; addr <= 636; addr += 4) { // Iterate through addresses
-        int value = 0;
-        if (data_memory.find(addr) != data_memory.end()) {
-            value = data_memory.at(addr); // Get value if present
-        }
-        output << addr << ": " << value << "\n";
+    for (uint32_t addr = data_memory_low; addr <= data_memory_low + 36; addr += 4) { // Iterate through addresses
+        output << addr << ": " << static_cast<int32_t>(data_memory.peek32(addr)) << "\n"; // 0 if never written
     }
 
     return output.str();
@@ -1350,19 +1889,13 @@ std::string Pipeline::getStalledInstruction() {
 
     std::string output = "Stall Instruction: ";
 
-    // No stalled
-    if (!flags.isRAWStalled) { 
+    // No stalled, the instruction held in RF waits on a result or for EX to free up, in IF or DF on a cache miss
+    if (flags.heldStage == NONE || stages[flags.heldStage].isEmpty()) { 
         output += "(none)\n";
         return output;
     }
 
-    // Handle a potential error
-    if (stages[StageType::ID].isEmpty()) {
-        std::cerr << "Stall not possible as ID slot is empty" << std::endl;
-        exit(1);
-    }
-
-    output += stages[StageType::ID].getNewStyleIstring();
+    output += stages[flags.heldStage].getNewStyleIstring();
     
     return output;
 }
@@ -1371,6 +1904,48 @@ std::string Pipeline::getPCOutput() {
     return "Current PC = " + std::to_string(pc) + "\n";
 }
 
+std::string Pipeline::getSummaryOutput(double seconds) const {
+
+    std::ostringstream output;
+
+    output << "Simulation Summary:\n";
+    output << "* Cycles\t\t: " << curr_cycle << "\n";
+    output << "* Instructions\t: " << stats.instructions_retired << "\n";
+    output << "* CPI\t\t: " << (stats.instructions_retired > 0 ? static_cast<double>(curr_cycle) / stats.instructions_retired : 0.0) << "\n";
+    output << "* Cycles/s\t: " << (seconds > 0 ? curr_cycle / seconds : 0.0) << "\n";
+    output << "* Data pages\t: " << data_memory.getPagesAllocated() << " x " << (GuestMemory::PAGE_SIZE / 1024) << " KiB\n";
+
+    output << "\nBranch Prediction:\n";
+    output << "* Predictor\t: " << predictor.getName() << "\n";
+    output << "* Branches\t: " << stats.branches << "\n";
+    output << "* Mispredicted\t: " << stats.mispredictions << "\n";
+    output << "* Accuracy\t: " << 100.0 * stats.predictionAccuracy() << "%\n";
+    output << "* MPKI\t\t: " << stats.mispredictionsPerKilo() << "\n";
+    output << "* BTB\t\t: " << btb.getName() << "\n";
+    output << "* RAS\t\t: " << (ras.getDepth() ? std::to_string(ras.getDepth()) + " entries" : "none") << "\n";
+    output << "* Jumps\t\t: " << stats.jumps << "\n";
+    output << "* Wrong target\t: " << stats.target_mispredictions << "\n";
+
+    output << "\nMemory Hierarchy:\n";
+    for (int level = 0; level < NUM_CACHE_LEVELS; level++) {
+        const Cache& cache = memory_hierarchy.getCache(CacheLevel(level));
+        output << "* " << cache_level_to_string(CacheLevel(level)) << "\t\t: " << cache.getName() << "\n";
+        if (!cache.enabled()) { continue; }
+
+        const CacheStats& counts = cache.getStats();
+        output << "  \t\t  " << counts.hits << " hits, " << counts.misses << " misses (" << 100.0 * counts.hitRate() << "% hits), "
+               << counts.evictions << " evictions, " << counts.writebacks << " written back\n";
+    }
+    if (memory_hierarchy.enabled()) {
+        output << "* L2 latency\t: " << memory_hierarchy.getConfig().l2_latency << " cycles\n";
+        output << "* Memory\t: " << memory_hierarchy.getConfig().memory_latency << " cycles\n";
+    }
+
+    output << "\n" << stats.toString();
+
+    return output.str();
+}
+
 
 
 
@@ -1379,20 +1954,121 @@ void Pipeline::addInstruction(Instruction instruction) {
     * Takes in an instruction from Lexer and adds it to pipeline
     */
 
-    instructions.push_back(instruction);
-    instruction_map[492 + (instructions.size() * 4)] = instruction;
+    addInstruction(instruction, text_base + (program.size() * 4));
+}
+
+void Pipeline::addInstruction(Instruction instruction, uint32_t address) {
+    /*
+    * Places an instruction at a specific address (used by the binary/ELF loaders)
+    */
+
+    program.add(instruction, address);
+}
+
+void Pipeline::setEntryPoint(uint32_t address) {
+    /*
+    * PC advances by 4 at the start of every cycle, so it sits one word before the entry point
+    */
+
+    pc = address - 4;
+    pipeline_registers.npc = address;
+    text_base = address;
+}
+
+void Pipeline::attachProgram(const DecodedEntry* entries, std::size_t num_slots, uint32_t base, std::size_t num_instructions) {
+    program.attach(entries, num_slots, base, num_instructions);
+}
+
+const DecodedProgram& Pipeline::getProgram() const { return program; }
+
+void Pipeline::attachInstructionStream(InstructionStream* stream, std::size_t window) {
+    /*
+    * Instructions are pulled from the stream as the PC reaches them instead of being added up front
+    */
+
+    instruction_stream = stream;
+    stream_next_address = text_base;
+    program.reset(text_base, window);
+}
+
+bool Pipeline::fetchFromStream(uint32_t address) {
+    /*
+    * Blocks only while address is ahead of what the lexer has decoded
+    * Returns true if address is now in the program window
+    */
+
+    // Already streamed past it (evicted from the window, or never part of the program)
+    if (address < stream_next_address) {
+        LOG_ERROR("Error: Instruction at " << address << " is no longer in the stream window.");
+        return false;
+    }
+
+    StreamedInstruction item;
+
+    while (stream_next_address <= address) {
+
+        if (!instruction_stream->pop(item)) { return false; } // Lexer finished, nothing at address
+
+        // The window overwrites the oldest slot, so memory stays bounded no matter how long the program is
+        program.add(item.instruction, item.address);
+        stream_next_address = item.address + 4;
+    }
+
+    return program.fetch(address) != nullptr;
+}
+
+void Pipeline::loadProgram(const ProgramImage& image) {
+    /*
+    * Decodes executable segments into the instruction store and copies the rest into data memory
+    * The data region is replaced by one spanning every data segment (including .bss)
+    */
+
+    bool has_data = false;
+    uint32_t low = 0;
+    uint32_t high = 0;
+
+    for (const LoadedSegment& segment : image.segments) {
+
+        if (segment.executable) {
+            std::vector<Dword> words = segment_words(segment);
+            DecodedBatch decoded;
+            decode_batch(words.data(), words.size(), decoded);
+            for (std::size_t i = 0; i < decoded.size(); i++) {
+                addInstruction(decoded.getInstruction(i), segment.address + (i * 4));
+            }
+            continue;
+        }
+
+        if (segment.bytes.empty()) { continue; }
+
+        data_memory.copyIn(segment.address, segment.bytes.data(), segment.bytes.size());
+
+        // Loads and stores are whole words, so widen to whole words
+        uint32_t first_word = segment.address & ~3u;
+        uint32_t last_word = (segment.address + segment.bytes.size() - 1) & ~3u;
+
+        low = has_data ? std::min(low, first_word) : first_word;
+        high = has_data ? std::max(high, last_word) : last_word;
+        has_data = true;
+    }
+
+    if (has_data) {
+        data_memory_low = low;
+        data_memory.clearRegions();
+        data_memory.addRegion("data", low, uint64_t(high) - low + 4);
+    }
+
+    setEntryPoint(image.entry_point);
 }
 
 void Pipeline::setIntegerRegister(uint32_t register_num, int32_t val) {
 
     if (register_num > 31) { // Register number too large
-        std::cerr << "Cannot write to invalid register " << register_num << ".";
+        LOG_ERROR("Cannot write to invalid register " << register_num << ".");
         return;
     }
 
-    //std::cerr << "Writing to integer_registers[" << ("R" + std::to_string(register_num)) << "]" << std::endl;
-
-    integer_registers["R" + std::to_string(register_num)] = val;
+    integer_registers.write(register_num, val);
 
     return;
 }
@@ -1400,12 +2076,14 @@ void Pipeline::setIntegerRegister(uint32_t register_num, int32_t val) {
 int32_t Pipeline::getIntegerRegister(uint32_t register_num) {
 
     if (register_num > 31) { // Register number too large
-        std::cerr << "Cannot read from invalid register " << register_num << ".";
-        exit(-1);
+        fault(REGISTER_FAULT, "Cannot read from invalid register " + std::to_string(register_num) + ".");
+        return 0;
     }
 
-    //std::cerr << "Reading from integer_registers[" << ("R" + std::to_string(register_num)) << "]" << std::endl;
+    return integer_registers.read(register_num);
+
+}
 
-    return integer_registers.at(("R" + std::to_string(register_num)));
+uint32_t Pipeline::getDirtyRegisters() const { return integer_registers.dirty; }
 
-}
\ No newline at end of file
+void Pipeline::clearDirtyRegisters() { integer_registers.clearDirty(); }
@@ -4,52 +4,45 @@
 // CONSTRUCTORS
 PipelineStage::PipelineStage() : type(StageType::IF) {}
 
-PipelineStage::PipelineStage(StageType type) : type(type) {
-    if (type == IF) { state = "* IF : <unknown>\n"; }
+PipelineStage::PipelineStage(StageType type, InstructionPool* pool) : type(type), pool(pool) {
+    if (type == IF) { state = STATE_UNKNOWN; }
 };
 
 
 
 
-// INSTRUCTION UNIQUE POINTER MANAGEMENT
-void PipelineStage::setInstruction(std::unique_ptr<Instruction> instr) { 
+// INSTRUCTION SLOT MANAGEMENT
+void PipelineStage::setInstruction(InstructionSlot new_slot) { 
 
-    // Move new instruction
-    curr_instruction = std::move(instr);
+    owned_display = (new_slot != NO_SLOT) ? instruction_to_new_style_string(pool->get(new_slot)) : "NOP";
+    owns_display = true;
 
+    slot = new_slot;
+    updateStatus();
 
-    // Result of the function fixes the istring
-
-    std::string input = getInstructionString();
-
-    // Remove trailing newline, if it exists
-    if (!input.empty() && input.back() == '\n') {
-        input.pop_back();
-    }
-
-    input = std::regex_replace(input, std::regex(R"(x(\d+))"), "R$1");
+}
 
-    // Replace immediate values with "#" prefix
-    if (getExactInstruction() != LW && getExactInstruction() != SW) {
-        input = std::regex_replace(input, std::regex(R"(\b(\d+)\b)"), "#$1");
-    }
+void PipelineStage::setInstruction(InstructionSlot new_slot, std::string_view new_display) { 
 
-    // Remove everything before the last tab
-    size_t lastTab = input.find_last_of('\t');
-    if (lastTab != std::string::npos) {
-        input = input.substr(lastTab + 1);
-    }
+    // Take over the slot
+    slot = new_slot;
 
-    new_style_istring = input;
+    // Only the view is copied, the text stays where it is
+    display = new_display;
+    owns_display = false;
     
     // Update status to reflect changes
     updateStatus();
 
 }
 
-std::unique_ptr<Instruction> PipelineStage::clearInstruction() { return std::move(curr_instruction); }
+InstructionSlot PipelineStage::clearInstruction() {
+    InstructionSlot cleared = slot;
+    slot = NO_SLOT;
+    return cleared;
+}
 
-bool PipelineStage::isEmpty() const { return curr_instruction == nullptr; }
+bool PipelineStage::isEmpty() const { return slot == NO_SLOT; }
 
 
 
@@ -58,27 +51,28 @@ bool PipelineStage::isEmpty() const { return curr_instruction == nullptr; }
 // GETTERS
 
 StageType PipelineStage::getStageType() const { return type; }
-std::unordered_map<DEPENDENCY_TYPE, uint32_t> PipelineStage::getDependencies() const { return curr_instruction->getDependencies(); } // Protect these from segfaults
-uint32_t PipelineStage::PipelineStage::getDestination() const { return curr_instruction->getDestination(); }
-int32_t PipelineStage::getImmediate() const { return curr_instruction->getImmediate(); }
-EXACT_INSTRUCTION PipelineStage::getExactInstruction() const { return curr_instruction->getExactInstruction(); }
-uint32_t PipelineStage::getValue() const { return curr_instruction->getValue(); }
+Dependencies PipelineStage::getDependencies() const { return current().getDependencies(); } // Protect these from segfaults
+uint32_t PipelineStage::PipelineStage::getDestination() const { return current().getDestination(); }
+int32_t PipelineStage::getImmediate() const { return current().getImmediate(); }
+EXACT_INSTRUCTION PipelineStage::getExactInstruction() const { return current().getExactInstruction(); }
+uint32_t PipelineStage::getValue() const { return current().getValue(); }
+uint32_t PipelineStage::getAddress() const { return pool->getAddress(slot); }
 void PipelineStage::deallocateInstruction() { 
-    if (type != WB) { setState("**STALL**"); }
-    curr_instruction.reset(); 
+    if (type != WB) { setStalled(); }
+    if (pool != nullptr) { pool->release(clearInstruction()); }
 }
-std::unique_ptr<Instruction>& PipelineStage::getInstruction() { return curr_instruction; }
+InstructionSlot PipelineStage::getSlot() const { return slot; }
 
 Instruction PipelineStage::getInstructionCopy() const {
 
     Instruction dummy;
 
-    if (!curr_instruction) {
-        std::cerr << "Cannot return copy of non-existant instruction." << std::endl;
+    if (isEmpty()) {
+        LOG_DEBUG("Cannot return copy of non-existant instruction.");
         return dummy;
     }
 
-    return *curr_instruction;
+    return current();
 
 }
 
@@ -86,70 +80,68 @@ void PipelineStage::setResult(int32_t newResult) {
 
 
     if (isEmpty()) {
-        std::cerr << "Cannot set result of empty instruction." << std::endl;
+        LOG_DEBUG("Cannot set result of empty instruction.");
         return;
     }
 
-    curr_instruction->setResult(newResult);
+    current().setResult(newResult);
 }
 
 int32_t PipelineStage::getResult() const {
 
     if (isEmpty()) {
-        std::cerr << "Cannot get result of empty instruction." << std::endl;
+        LOG_DEBUG("Cannot get result of empty instruction.");
         return -1;
     }
 
-    return curr_instruction->getResult();
+    return current().getResult();
 }
 
-std::unordered_map<DEPENDENCY_TYPE, int32_t> PipelineStage::getRegisterValues() const { 
-
-    std::unordered_map<DEPENDENCY_TYPE, int32_t> nonelol;
+RegisterValues PipelineStage::getRegisterValues() const { 
 
     if (isEmpty()) {
-        std::cerr << "Cannot get register value of empty instruction." << std::endl;
-        return nonelol;
+        LOG_DEBUG("Cannot get register value of empty instruction.");
+        return {};
     }
 
-    return curr_instruction->getRegisterValues();
+    return current().getRegisterValues();
 }
 
 void PipelineStage::setRegisterValue(DEPENDENCY_TYPE reg, int32_t newValue) { 
 
     if (isEmpty()) {
-        std::cerr << "Cannot set register value of empty instruction." << std::endl;
+        LOG_DEBUG("Cannot set register value of empty instruction.");
         return;
     }
 
-    curr_instruction->setRegisterValue(reg, newValue);
+    current().setRegisterValue(reg, newValue);
 }
     
 
 void PipelineStage::setMemAddress(uint32_t newAddress) {
 
     if (type != EX) {
-        std::cerr << "Should not be setting a memory address outside of EX stage." << std::endl;
+        LOG_DEBUG("Should not be setting a memory address outside of EX stage.");
         return;
     }
 
     if (isEmpty()) { 
-        std::cerr << "Cannot set memory address of empty instruction." << std::endl;
+        LOG_DEBUG("Cannot set memory address of empty instruction.");
         return;
     }
 
-    curr_instruction->setMemAddress(newAddress);
+    current().setMemAddress(newAddress);
 
 }
 
 uint32_t PipelineStage::getMemAddress() const {
 
     if (isEmpty()) { 
-        std::cerr << "Cannot get memory address of empty instruction." << std::endl;
+        LOG_DEBUG("Cannot get memory address of empty instruction.");
         return -1;
     }
 
-    return curr_instruction->getMemAddress();
+    return current().getMemAddress();
 
 }
 
@@ -157,21 +149,21 @@ uint32_t PipelineStage::getMemAddress() const {
 void PipelineStage::setNeedsForward(bool newFlag) {
 
     if (isEmpty()) {
-        std::cerr << "Cannot set flag of empty instruction." << std::endl;
+        LOG_DEBUG("Cannot set flag of empty instruction.");
         return;
     }
 
-    curr_instruction->setForwardFlag(newFlag);
+    current().setForwardFlag(newFlag);
 }
 
 bool PipelineStage::getNeedsForward() const {
 
     if (isEmpty()) {
-        std::cerr << "Cannot get flag of empty instruction." << std::endl;
+        LOG_DEBUG("Cannot get flag of empty instruction.");
         return false;
     }
 
-    return curr_instruction->getForwardFlag();
+    return current().getForwardFlag();
 }
 
 
@@ -179,56 +171,87 @@ bool PipelineStage::getNeedsForward() const {
 void PipelineStage::setNumCyclesAhead(DEPENDENCY_TYPE dep, int newNumCyclesAhead) {
 
     if (isEmpty()) {
-        std::cerr << "Cannot set num cycles ahead of empty instruction." << std::endl;
+        LOG_DEBUG("Cannot set num cycles ahead of empty instruction.");
         return;
     }
 
-    curr_instruction->setNumCyclesAhead(dep, newNumCyclesAhead);
+    current().setNumCyclesAhead(dep, newNumCyclesAhead);
 
 }
 
 int PipelineStage::getNumCyclesAhead(DEPENDENCY_TYPE dep) const {
 
     if (isEmpty()) {
-        std::cerr << "Cannot get num cycles ahead of empty instruction." << std::endl;
+        LOG_DEBUG("Cannot get num cycles ahead of empty instruction.");
         return -1;
     }
 
-    return curr_instruction->getNumCyclesAhead(dep);
+    return current().getNumCyclesAhead(dep);
 
 }
 
 
 
 INST_TYPE PipelineStage::getInstructionType() {
-    if (!isEmpty()) { return curr_instruction->getInstType(); }
-    std::cerr << "Trying to get type of empty instruction" << std::endl;
+    if (!isEmpty()) { return current().getInstType(); }
+    LOG_DEBUG("Trying to get type of empty instruction");
     return BLANK;
 }
 
 
 // Get and set current state
-void PipelineStage::setState(std::string updatedState) { state = "* " + getStageName() + " : " + updatedState + "\n"; }
-std::string PipelineStage::getState() const { return state; }
-void PipelineStage::resetState() { setState("NOP"); }
+void PipelineStage::setState(std::string updatedState) {
+    state = STATE_TEXT;
+    state_text = std::move(updatedState);
+}
+void PipelineStage::setStalled() { state = STATE_STALL; }
+void PipelineStage::setFetched(Dword value) {
+    state = STATE_FETCHED;
+    fetched_value = value;
+}
+void PipelineStage::resetState() { state = STATE_NOP; }
+
+std::string PipelineStage::getState() const {
+    /*
+    * Built on demand, only the trace output ever asks
+    */
+
+    std::string output = "* " + getStageName() + " : ";
+
+    switch (state) {
+        case STATE_NOP: output += "NOP"; break;
+        case STATE_UNKNOWN: output += "<unknown>"; break;
+        case STATE_STALL: output += "**STALL**"; break;
+        case STATE_DISPLAY: output += getDisplay(); break;
+        case STATE_TEXT: output += state_text; break;
+        case STATE_FETCHED:
+            // Bytes in the order [Byte 3][Byte 2][Byte 4][Byte 1]
+            output += "<Fetched ";
+            output += std::bitset<8>((fetched_value >> 8) & 0xFF).to_string() + " ";
+            output += std::bitset<8>((fetched_value >> 16) & 0xFF).to_string() + " ";
+            output += std::bitset<8>(fetched_value & 0xFF).to_string() + " ";
+            output += std::bitset<8>((fetched_value >> 24) & 0xFF).to_string();
+            output += ">";
+            break;
+    }
+
+    output += "\n";
+    return output;
+}
 
 void PipelineStage::updateStatus() {
 
     // Handle IF
-    if (type == IF && !isEmpty()) {
-        setState("<unknown>");
-        return;
-    }
-    if (type == IF && isEmpty()) {
-        setState("NOP");
+    if (type == IF) {
+        state = isEmpty() ? STATE_NOP : STATE_UNKNOWN;
         return;
     }
 
     // Handle IS
-    if (type == IF || type == IS) { return; }
+    if (type == IS) { return; }
 
-    if (isEmpty()) { setState("NOP"); }
-    setState(new_style_istring);
+    // Empty stages still show the last instruction they held
+    state = STATE_DISPLAY;
 
     return;
 }
@@ -239,7 +262,7 @@ void PipelineStage::updateStatus() {
 // UTILITY
 
 
-std::string PipelineStage::getStageName() const {
+const char* stage_type_name(StageType type) {
     switch (type) {
         case IF: return "IF";
         case IS: return "IS";
@@ -253,11 +276,13 @@ std::string PipelineStage::getStageName() const {
     }
 }
 
+std::string PipelineStage::getStageName() const { return stage_type_name(type); }
+
 // Get instruction string
 std::string PipelineStage::getInstructionString() {
 
-    if (curr_instruction) {
-        return instruction_to_string(*curr_instruction, 0, false) + "\n";
+    if (!isEmpty()) {
+        return instruction_to_string(current(), 0, false) + "\n";
     } 
 
     return "NOP\n";
@@ -265,20 +290,22 @@ std::string PipelineStage::getInstructionString() {
 }
 
 
-std::string PipelineStage::getNewStyleIstring() const {
+std::string_view PipelineStage::getNewStyleIstring() const {
 
-    if (curr_instruction) {
-        return new_style_istring;
+    if (!isEmpty()) {
+        return getDisplay();
     } 
 
     return "NOP\n";
 
 }
 
+std::string_view PipelineStage::getDisplay() const { return owns_display ? std::string_view(owned_display) : display; }
+
 bool PipelineStage::getAlreadyCompleted() const {
 
     if (isEmpty()) {
-        std::cerr << "Empty instruction cannot be already completed" << std::endl;
+        LOG_DEBUG("Empty instruction cannot be already completed");
         return false;
     }
 
@@ -289,7 +316,7 @@ bool PipelineStage::getAlreadyCompleted() const {
 void PipelineStage::setAlreadyCompleted(bool newCompleted) {
 
     if (isEmpty()) {
-        std::cerr << "Empty instruction cannot be set already completed" << std::endl;
+        LOG_DEBUG("Empty instruction cannot be set already completed");
         return;
     }
 
@@ -0,0 +1,51 @@
+#include "../include/threadpool.h"
+
+
+// CONSTRUCTORS
+ThreadPool::ThreadPool(unsigned num_threads) {
+
+    if (num_threads == 0) { num_threads = std::thread::hardware_concurrency(); }
+    if (num_threads == 0) { num_threads = 1; } // hardware_concurrency may not know
+
+    for (unsigned i = 0; i < num_threads; i++) {
+        workers.emplace_back(&ThreadPool::workerLoop, this);
+    }
+
+}
+
+ThreadPool::~ThreadPool() {
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    task_ready.notify_all();
+
+    for (std::thread& worker : workers) { worker.join(); }
+
+}
+
+
+
+void ThreadPool::workerLoop() {
+
+    while (true) {
+
+        std::function<void()> task;
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            task_ready.wait(lock, [this]() { return stopping || !tasks.empty(); });
+
+            if (tasks.empty()) { return; } // Only reached when stopping
+
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+
+        task();
+    }
+
+}
+
+unsigned ThreadPool::getNumThreads() const { return static_cast<unsigned>(workers.size()); }